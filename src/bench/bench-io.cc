@@ -0,0 +1,155 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "helpers.hh"
+
+#include "qc-packed.hh"
+
+
+static void
+BM_ReadParser(benchmark::State &state)
+{
+    SyntheticData &data = SyntheticData::get();
+    SyntheticKey key = synthetic_key(state);
+    const std::string &infile = data.fastq(key);
+    size_t n_reads = 0;
+
+    for (auto _: state) {
+        qcpp::ReadParser parser;
+        qcpp::ReadPair rp;
+
+        parser.open(infile);
+        while (parser.parse_read_pair(rp)) {
+            benchmark::DoNotOptimize(rp.first.sequence.data());
+        }
+        n_reads = parser.get_num_reads();
+    }
+    state.SetItemsProcessed(state.iterations() * n_reads);
+    state.SetBytesProcessed(state.iterations() * data.bytes(key));
+}
+BENCHMARK(BM_ReadParser)->Apply(synthetic_args);
+
+static void
+BM_ReadParserAsync(benchmark::State &state)
+{
+    SyntheticData &data = SyntheticData::get();
+    SyntheticKey key = synthetic_key(state);
+    const std::string &infile = data.fastq(key);
+    size_t n_reads = 0;
+
+    for (auto _: state) {
+        qcpp::ReadParser parser;
+        qcpp::ReadPair rp;
+
+        parser.open(infile, qcpp::AsyncIOOptions());
+        while (parser.parse_read_pair(rp)) {
+            benchmark::DoNotOptimize(rp.first.sequence.data());
+        }
+        n_reads = parser.get_num_reads();
+    }
+    state.SetItemsProcessed(state.iterations() * n_reads);
+    state.SetBytesProcessed(state.iterations() * data.bytes(key));
+}
+BENCHMARK(BM_ReadParserAsync)->Apply(synthetic_args);
+
+static void
+BM_ReadWriter(benchmark::State &state)
+{
+    SyntheticData &data = SyntheticData::get();
+    SyntheticKey key = synthetic_key(state);
+    std::vector<qcpp::ReadPair> pairs = data.pairs(key);
+    std::string outfile = data.fastq(key) + ".out.fastq";
+
+    for (auto _: state) {
+        qcpp::ReadWriter writer;
+
+        writer.open(outfile);
+        for (qcpp::ReadPair &rp: pairs) {
+            writer.write_read_pair(rp);
+        }
+        writer.close();
+    }
+    std::remove(outfile.c_str());
+    state.SetItemsProcessed(state.iterations() * pairs.size() * 2);
+    state.SetBytesProcessed(state.iterations() * data.bytes(key));
+}
+BENCHMARK(BM_ReadWriter)->Apply(synthetic_args);
+
+static void
+BM_BufferedReadWriter(benchmark::State &state)
+{
+    SyntheticData &data = SyntheticData::get();
+    SyntheticKey key = synthetic_key(state);
+    std::vector<qcpp::ReadPair> pairs = data.pairs(key);
+    std::string outfile = data.fastq(key) + ".out.fastq";
+
+    for (auto _: state) {
+        qcpp::BufferedReadWriter writer;
+
+        writer.open(outfile);
+        for (qcpp::ReadPair &rp: pairs) {
+            writer.write_read_pair(rp);
+        }
+        writer.close();
+    }
+    std::remove(outfile.c_str());
+    state.SetItemsProcessed(state.iterations() * pairs.size() * 2);
+    state.SetBytesProcessed(state.iterations() * data.bytes(key));
+}
+BENCHMARK(BM_BufferedReadWriter)->Apply(synthetic_args);
+
+static void
+BM_PackSequence(benchmark::State &state)
+{
+    SyntheticData &data = SyntheticData::get();
+    SyntheticKey key = synthetic_key(state);
+    std::vector<qcpp::ReadPair> pairs = data.pairs(key);
+    qcpp::PackedSequence packed;
+    size_t n_bases = 0;
+
+    for (qcpp::ReadPair &rp: pairs) {
+        n_bases += rp.first.size() + rp.second.size();
+    }
+    for (auto _: state) {
+        for (qcpp::ReadPair &rp: pairs) {
+            packed.pack(rp.first.sequence);
+            benchmark::DoNotOptimize(packed.words().data());
+            packed.pack(rp.second.sequence);
+            benchmark::DoNotOptimize(packed.words().data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * pairs.size() * 2);
+    state.SetBytesProcessed(state.iterations() * n_bases);
+}
+BENCHMARK(BM_PackSequence)->Apply(synthetic_args);
+
+static void
+BM_UnpackSequence(benchmark::State &state)
+{
+    SyntheticData &data = SyntheticData::get();
+    SyntheticKey key = synthetic_key(state);
+    std::vector<qcpp::PackedSequence> packed;
+    std::string sequence;
+    size_t n_bases = 0;
+
+    for (const qcpp::ReadPair &rp: data.pairs(key)) {
+        packed.emplace_back(rp.first.sequence);
+        packed.emplace_back(rp.second.sequence);
+        n_bases += rp.first.size() + rp.second.size();
+    }
+    for (auto _: state) {
+        for (qcpp::PackedSequence &seq: packed) {
+            seq.unpack(sequence);
+            benchmark::DoNotOptimize(sequence.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * packed.size());
+    state.SetBytesProcessed(state.iterations() * n_bases);
+}
+BENCHMARK(BM_UnpackSequence)->Apply(synthetic_args);
@@ -0,0 +1,224 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "helpers.hh"
+
+#include "qc-adaptor.hh"
+#include "qc-complexity.hh"
+#include "qc-contaminant.hh"
+#include "qc-duplicate.hh"
+#include "qc-kmer.hh"
+#include "qc-length.hh"
+#include "qc-measure.hh"
+#include "qc-overrep.hh"
+#include "qc-polyx.hh"
+#include "qc-qualbin.hh"
+#include "qc-qualtrim.hh"
+
+#include <random>
+
+
+// Runs proc over a fresh copy of the synthetic dataset each iteration. The
+// copy is not timed, as processors modify reads in place.
+template<typename ReadProcType>
+static void
+run_processor(benchmark::State &state, ReadProcType &proc)
+{
+    SyntheticData &data = SyntheticData::get();
+    SyntheticKey key = synthetic_key(state);
+    const std::vector<qcpp::ReadPair> &pairs = data.pairs(key);
+    size_t bytes = data.bytes(key);
+    std::vector<qcpp::ReadPair> chunk;
+
+    for (auto _: state) {
+        state.PauseTiming();
+        chunk = pairs;
+        state.ResumeTiming();
+
+        for (qcpp::ReadPair &rp: chunk) {
+            proc.process_read_pair(rp);
+        }
+        benchmark::DoNotOptimize(chunk.data());
+    }
+    state.SetItemsProcessed(state.iterations() * pairs.size() * 2);
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+// As run_processor(), but with the dataset's reads packed, one at a time
+template<typename ReadProcType>
+static void
+run_packed_processor(benchmark::State &state, ReadProcType &proc)
+{
+    SyntheticData &data = SyntheticData::get();
+    SyntheticKey key = synthetic_key(state);
+    std::vector<qcpp::PackedRead> reads, chunk;
+
+    for (const qcpp::ReadPair &rp: data.pairs(key)) {
+        reads.emplace_back(rp.first);
+        reads.emplace_back(rp.second);
+    }
+    for (auto _: state) {
+        state.PauseTiming();
+        chunk = reads;
+        state.ResumeTiming();
+
+        for (qcpp::PackedRead &read: chunk) {
+            proc.process_read(read);
+        }
+        benchmark::DoNotOptimize(chunk.data());
+    }
+    state.SetItemsProcessed(state.iterations() * reads.size());
+    state.SetBytesProcessed(state.iterations() * data.bytes(key));
+}
+
+static void
+BM_AdaptorTrimPE(benchmark::State &state)
+{
+    qcpp::AdaptorTrimPE proc("bench", 10);
+    run_processor(state, proc);
+}
+BENCHMARK(BM_AdaptorTrimPE)->Apply(synthetic_args);
+
+static void
+BM_WindowedQualTrim(benchmark::State &state)
+{
+    qcpp::WindowedQualTrim proc("bench", 25);
+    run_processor(state, proc);
+}
+BENCHMARK(BM_WindowedQualTrim)->Apply(synthetic_args);
+
+static void
+BM_PolyXTrim(benchmark::State &state)
+{
+    qcpp::PolyXTrim proc("bench");
+    run_processor(state, proc);
+}
+BENCHMARK(BM_PolyXTrim)->Apply(synthetic_args);
+
+static void
+BM_QualityBinner(benchmark::State &state)
+{
+    qcpp::QualityBinner proc("bench");
+    run_processor(state, proc);
+}
+BENCHMARK(BM_QualityBinner)->Apply(synthetic_args);
+
+// After the first iteration every pair is a duplicate, so this mostly times
+// hashing and lookups
+static void
+BM_DuplicateFilter(benchmark::State &state)
+{
+    qcpp::DuplicateFilter proc("bench");
+    run_processor(state, proc);
+}
+BENCHMARK(BM_DuplicateFilter)->Apply(synthetic_args);
+
+static void
+BM_ComplexityEstimator(benchmark::State &state)
+{
+    qcpp::ComplexityEstimator proc("bench");
+    run_processor(state, proc);
+}
+BENCHMARK(BM_ComplexityEstimator)->Apply(synthetic_args);
+
+static void
+BM_OverrepresentedSequences(benchmark::State &state)
+{
+    qcpp::OverrepresentedSequences proc("bench");
+    run_processor(state, proc);
+}
+BENCHMARK(BM_OverrepresentedSequences)->Apply(synthetic_args);
+
+// An index of a random 1Mbp reference, which few synthetic reads hit, as
+// with most real contaminant screens
+static std::shared_ptr<qcpp::MinimizerIndex>
+contaminant_index()
+{
+    auto index = std::make_shared<qcpp::MinimizerIndex>();
+    std::mt19937_64 rng(1);
+    std::string reference;
+
+    for (size_t i = 0; i < 1000000; i++) {
+        reference += "ACGT"[rng() % 4];
+    }
+    index->add_sequence("reference", reference);
+    return index;
+}
+
+static void
+BM_ContaminantFilter(benchmark::State &state)
+{
+    qcpp::ContaminantFilter proc("bench", contaminant_index());
+    run_processor(state, proc);
+}
+BENCHMARK(BM_ContaminantFilter)->Apply(synthetic_args);
+
+static void
+BM_ContaminantFilterPacked(benchmark::State &state)
+{
+    qcpp::ContaminantFilter proc("bench", contaminant_index());
+    run_packed_processor(state, proc);
+}
+BENCHMARK(BM_ContaminantFilterPacked)->Apply(synthetic_args);
+
+static void
+BM_KmerSpectrum(benchmark::State &state)
+{
+    qcpp::KmerSpectrum proc("bench");
+    run_processor(state, proc);
+}
+BENCHMARK(BM_KmerSpectrum)->Apply(synthetic_args);
+
+static void
+BM_KmerSpectrumPacked(benchmark::State &state)
+{
+    qcpp::KmerSpectrum proc("bench");
+    run_packed_processor(state, proc);
+}
+BENCHMARK(BM_KmerSpectrumPacked)->Apply(synthetic_args);
+
+static void
+BM_PerBaseQuality(benchmark::State &state)
+{
+    qcpp::PerBaseQuality proc("bench");
+    run_processor(state, proc);
+}
+BENCHMARK(BM_PerBaseQuality)->Apply(synthetic_args);
+
+static void
+BM_BaseComposition(benchmark::State &state)
+{
+    qcpp::BaseComposition proc("bench");
+    run_processor(state, proc);
+}
+BENCHMARK(BM_BaseComposition)->Apply(synthetic_args);
+
+static void
+BM_ReadLenCounter(benchmark::State &state)
+{
+    qcpp::ReadLenCounter proc("bench");
+    run_processor(state, proc);
+}
+BENCHMARK(BM_ReadLenCounter)->Apply(synthetic_args);
+
+static void
+BM_ReadLenFilter(benchmark::State &state)
+{
+    qcpp::ReadLenFilter proc("bench", 50);
+    run_processor(state, proc);
+}
+BENCHMARK(BM_ReadLenFilter)->Apply(synthetic_args);
+
+static void
+BM_ReadTruncator(benchmark::State &state)
+{
+    qcpp::ReadTruncator proc("bench", 64);
+    run_processor(state, proc);
+}
+BENCHMARK(BM_ReadTruncator)->Apply(synthetic_args);
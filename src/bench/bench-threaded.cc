@@ -0,0 +1,153 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include <thread>
+
+#include "helpers.hh"
+
+#include "qc-batch.hh"
+#include "qc-processor.hh"
+#include "qc-adaptor.hh"
+#include "qc-length.hh"
+#include "qc-measure.hh"
+#include "qc-qualtrim.hh"
+
+
+static void
+threaded_args(benchmark::internal::Benchmark *bench)
+{
+    size_t max_threads = std::thread::hardware_concurrency();
+    std::vector<int64_t> threads {1};
+
+    for (size_t n = 2; n <= max_threads; n *= 2) {
+        threads.push_back(n);
+    }
+    bench->ArgNames({"len", "err_pm", "ovl_pct", "threads"});
+    bench->ArgsProduct({{100, 150}, {0, 10}, {0, 50}, threads});
+}
+
+// The full trimit pipeline, reading a FASTQ file and writing to /dev/null.
+static void
+BM_ThreadedQCProcessor(benchmark::State &state)
+{
+    SyntheticData &data = SyntheticData::get();
+    SyntheticKey key = synthetic_key(state);
+    std::string infile = data.fastq(key);
+    size_t n_threads = state.range(3);
+    std::ofstream devnull("/dev/null");
+    size_t n_pairs = 0;
+
+    for (auto _: state) {
+        qcpp::ThreadedQCProcessor proc(infile, &devnull, n_threads);
+
+        proc.append_processor<qcpp::PerBaseQuality>("before qc");
+        proc.append_processor<qcpp::AdaptorTrimPE>("trim or merge reads", 10);
+        proc.append_processor<qcpp::WindowedQualTrim>("QC", 25);
+        proc.append_processor<qcpp::ReadLenFilter>("Length Filter", 50);
+        proc.append_processor<qcpp::PerBaseQuality>("after qc");
+        n_pairs = proc.run();
+    }
+    state.SetItemsProcessed(state.iterations() * n_pairs * 2);
+    state.SetBytesProcessed(state.iterations() * data.bytes(key));
+}
+BENCHMARK(BM_ThreadedQCProcessor)
+    ->Apply(threaded_args)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void
+batch_args(benchmark::internal::Benchmark *bench)
+{
+    size_t max_threads = std::thread::hardware_concurrency();
+    std::vector<int64_t> threads {1};
+
+    for (size_t n = 2; n <= max_threads; n *= 2) {
+        threads.push_back(n);
+    }
+    bench->ArgNames({"len", "err_pm", "ovl_pct", "files", "threads"});
+    bench->ArgsProduct({{150}, {10}, {50}, {1, 8, 64}, threads});
+}
+
+// Split datasets, removed at exit
+struct SplitFiles
+{
+    std::map<std::pair<SyntheticKey, size_t>, std::vector<std::string>> files;
+
+    ~SplitFiles()
+    {
+        for (auto &split: files) {
+            for (auto &file: split.second) {
+                std::remove(file.c_str());
+            }
+        }
+    }
+};
+
+// Splits a dataset into n_files FASTQ files, returning their paths
+static std::vector<std::string>
+split_fastq(const SyntheticKey &key, size_t n_files)
+{
+    static SplitFiles cache;
+    auto it = cache.files.find(std::make_pair(key, n_files));
+    if (it != cache.files.end()) {
+        return it->second;
+    }
+
+    const std::vector<qcpp::ReadPair> &pairs = SyntheticData::get().pairs(key);
+    const char *tmpdir = std::getenv("TMPDIR");
+    std::vector<std::string> files;
+    for (size_t i = 0; i < n_files; i++) {
+        std::ostringstream fname;
+        fname << (tmpdir != NULL ? tmpdir : "/tmp") << "/bench_qcpp_batch_"
+              << n_files << "_" << i << ".fastq";
+        std::ofstream out(fname.str());
+        for (size_t j = i * pairs.size() / n_files;
+                j < (i + 1) * pairs.size() / n_files; j++) {
+            out << pairs[j].str();
+        }
+        files.push_back(fname.str());
+    }
+    cache.files.emplace(std::make_pair(key, n_files), files);
+    return files;
+}
+
+// The full trimit pipeline over the same dataset split into several files,
+// which should run at the same rate however many files there are.
+static void
+BM_BatchQCProcessor(benchmark::State &state)
+{
+    SyntheticData &data = SyntheticData::get();
+    SyntheticKey key = synthetic_key(state);
+    std::vector<std::string> infiles = split_fastq(key, state.range(3));
+    size_t n_threads = state.range(4);
+    size_t n_pairs = 0;
+
+    for (auto _: state) {
+        qcpp::BatchQCProcessor batch(n_threads);
+
+        for (const std::string &infile: infiles) {
+            qcpp::BatchJob job;
+            job.input = infile;
+            job.output = "/dev/null";
+            batch.add_job(job);
+        }
+        batch.append_processor<qcpp::PerBaseQuality>("before qc");
+        batch.append_processor<qcpp::AdaptorTrimPE>("trim or merge reads", 10);
+        batch.append_processor<qcpp::WindowedQualTrim>("QC", 25);
+        batch.append_processor<qcpp::ReadLenFilter>("Length Filter", 50);
+        batch.append_processor<qcpp::PerBaseQuality>("after qc");
+        n_pairs = batch.run();
+    }
+    state.SetItemsProcessed(state.iterations() * n_pairs * 2);
+    state.SetBytesProcessed(state.iterations() * data.bytes(key));
+}
+BENCHMARK(BM_BatchQCProcessor)
+    ->Apply(batch_args)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
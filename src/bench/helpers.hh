@@ -0,0 +1,152 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef BENCH_HELPERS_HH
+#define BENCH_HELPERS_HH
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "qc-io.hh"
+#include "qc-simulate.hh"
+
+
+// Each benchmark is parameterised by read length, error rate (per mille) and
+// overlap rate (percent of pairs whose insert is shorter than 2x read length).
+// All datasets are generated from a fixed seed, so numbers are comparable
+// between runs and between branches.
+typedef std::tuple<size_t, size_t, size_t> SyntheticKey;
+
+static inline void
+synthetic_args(benchmark::internal::Benchmark *bench)
+{
+    bench->ArgNames({"len", "err_pm", "ovl_pct"});
+    bench->ArgsProduct({{100, 150}, {0, 10}, {0, 50}});
+}
+
+static inline SyntheticKey
+synthetic_key(const benchmark::State &state)
+{
+    return SyntheticKey(state.range(0), state.range(1), state.range(2));
+}
+
+// Number of read pairs in each synthetic dataset. May be overridden with
+// QCPP_BENCH_PAIRS in the environment.
+static inline size_t
+synthetic_num_pairs()
+{
+    const char *env = std::getenv("QCPP_BENCH_PAIRS");
+    if (env != NULL && std::atol(env) > 0) {
+        return std::atol(env);
+    }
+    return 20000;
+}
+
+class SyntheticData
+{
+public:
+    ~SyntheticData()
+    {
+        for (auto &file: _files) {
+            std::remove(file.second.c_str());
+        }
+    }
+
+    static SyntheticData &
+    get()
+    {
+        static SyntheticData instance;
+        return instance;
+    }
+
+    const std::vector<qcpp::ReadPair> &
+    pairs(const SyntheticKey &key)
+    {
+        auto it = _pairs.find(key);
+        if (it == _pairs.end()) {
+            it = _pairs.emplace(key, _generate(key)).first;
+        }
+        return it->second;
+    }
+
+    // Total size of the dataset as FASTQ text
+    size_t
+    bytes(const SyntheticKey &key)
+    {
+        size_t total = 0;
+        for (const auto &rp: pairs(key)) {
+            total += rp.str().size();
+        }
+        return total;
+    }
+
+    // Path to an interleaved FASTQ file holding the dataset
+    const std::string &
+    fastq(const SyntheticKey &key)
+    {
+        auto it = _files.find(key);
+        if (it != _files.end()) {
+            return it->second;
+        }
+
+        std::ostringstream fname;
+        const char *tmpdir = std::getenv("TMPDIR");
+        fname << (tmpdir != NULL ? tmpdir : "/tmp") << "/bench_qcpp_"
+              << std::get<0>(key) << "_" << std::get<1>(key) << "_"
+              << std::get<2>(key) << ".fastq";
+
+        std::ofstream out(fname.str());
+        for (const auto &rp: pairs(key)) {
+            out << rp.str();
+        }
+        return _files.emplace(key, fname.str()).first->second;
+    }
+
+protected:
+    std::map<SyntheticKey, std::vector<qcpp::ReadPair>> _pairs;
+    std::map<SyntheticKey, std::string> _files;
+
+    std::vector<qcpp::ReadPair>
+    _generate(const SyntheticKey &key)
+    {
+        const size_t read_len = std::get<0>(key);
+        const size_t overlap_pct = std::get<2>(key);
+        qcpp::SimulatorParams params;
+        std::vector<qcpp::ReadPair> result;
+        qcpp::ReadPair rp;
+
+        params.seed = read_len * 1000003 + std::get<1>(key) * 1009 + overlap_pct;
+        params.num_pairs = synthetic_num_pairs();
+        params.read_len = read_len;
+        params.error_rate = std::get<1>(key) / 1000.0;
+        // With this insert size distribution, roughly overlap_pct percent of
+        // pairs have an insert shorter than twice the read length.
+        params.insert_sd = read_len / 4.0;
+        params.insert_mean = read_len * (3.0 - overlap_pct / 50.0);
+
+        qcpp::ReadSimulator sim(params);
+        result.reserve(params.num_pairs);
+        while (sim.parse_read_pair(rp)) {
+            result.push_back(rp);
+        }
+        return result;
+    }
+};
+
+
+#endif /* BENCH_HELPERS_HH */
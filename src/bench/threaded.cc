@@ -0,0 +1,52 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+// Runs the trimit pipeline through ThreadedQCProcessor, for measurement by
+// throughput.py. Prints the number of read pairs processed.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "qcpp.hh"
+#include "qc-adaptor.hh"
+#include "qc-length.hh"
+#include "qc-measure.hh"
+#include "qc-qualtrim.hh"
+
+
+int
+main (int argc, char *argv[])
+{
+    using namespace qcpp;
+
+    if (argc != 4) {
+        std::cerr << "USAGE: bench_threaded <input> <output> <threads>"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string     infile = argv[1];
+    std::ofstream   output(argv[2]);
+    size_t          n_threads = atol(argv[3]);
+
+    try {
+        ThreadedQCProcessor proc(infile, &output, n_threads);
+
+        proc.append_processor<PerBaseQuality>("before qc");
+        proc.append_processor<AdaptorTrimPE>("trim or merge reads", 10);
+        proc.append_processor<WindowedQualTrim>("QC", 25);
+        proc.append_processor<PerBaseQuality>("after qc");
+        std::cout << proc.run() << std::endl;
+    } catch (qcpp::IOError &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+# Copyright (c) 2015-2016 Kevin Murray
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+"""End-to-end throughput harness for trimit and ThreadedQCProcessor.
+
+Generates synthetic datasets with simreads, then runs trimit and
+bench_threaded over them at a range of thread counts, with plain and
+gzip-compressed input. Wall time, CPU time, peak RSS and reads/s of each run
+are written as JSON. Given a baseline JSON file from an earlier run, results
+are compared against it and the exit status is non-zero if any configuration
+is slower (or larger) than the baseline by more than the tolerance.
+
+Requires Python 3.9 or later.
+"""
+
+import argparse
+import json
+import multiprocessing
+import os
+import platform
+import subprocess
+import sys
+import time
+
+
+def thread_counts(max_threads):
+    counts = [1]
+    while counts[-1] * 2 <= max_threads:
+        counts.append(counts[-1] * 2)
+    if counts[-1] != max_threads:
+        counts.append(max_threads)
+    return counts
+
+
+def run_measured(cmd, stdout=None):
+    """Run cmd, returning (wall seconds, CPU seconds, peak RSS in KiB)"""
+    devnull = open(os.devnull, 'w')
+    start = time.monotonic()
+    proc = subprocess.Popen(cmd, stdout=stdout or devnull, stderr=devnull)
+    # wait4 gives resource usage of this child alone, unlike getrusage()
+    _, status, usage = os.wait4(proc.pid, 0)
+    wall = time.monotonic() - start
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    devnull.close()
+    if proc.returncode != 0:
+        raise RuntimeError("Command failed ({}): {}".format(proc.returncode,
+                                                           " ".join(cmd)))
+    return wall, usage.ru_utime + usage.ru_stime, usage.ru_maxrss
+
+
+def make_datasets(args):
+    datasets = {}
+    os.makedirs(args.workdir, exist_ok=True)
+    for compression, ext in [("plain", "fastq"), ("gz", "fastq.gz")]:
+        fname = os.path.join(args.workdir, "sim_{}_{}_{}.{}".format(
+            args.pairs, args.read_len, args.insert, ext))
+        if not os.path.exists(fname):
+            print("Generating", fname, file=sys.stderr)
+            subprocess.check_call([
+                os.path.join(args.bindir, "simreads"),
+                "-n", str(args.pairs),
+                "-l", str(args.read_len),
+                "-i", str(args.insert),
+                "-s", "1",
+                "-o", fname,
+            ])
+        datasets[compression] = fname
+    return datasets
+
+
+def tool_command(args, tool, infile, outfile, threads):
+    if tool == "trimit":
+        return [os.path.join(args.bindir, "trimit"), "-Q",
+                "-t", str(threads), "-o", outfile, infile]
+    return [os.path.join(args.bindir, "bench_threaded"),
+            infile, outfile, str(threads)]
+
+
+def run_all(args, datasets):
+    results = []
+    outfile = os.path.join(args.workdir, "out.fastq")
+    for tool in ["trimit", "threaded"]:
+        for compression, infile in sorted(datasets.items()):
+            for threads in thread_counts(args.max_threads):
+                cmd = tool_command(args, tool, infile, outfile, threads)
+                runs = [run_measured(cmd) for _ in range(args.repeats)]
+                # Report the fastest of the repeats, which is least affected
+                # by noise from other processes.
+                wall, cpu, rss = min(runs)
+                res = {
+                    "tool": tool,
+                    "compression": compression,
+                    "threads": threads,
+                    "wall_s": round(wall, 4),
+                    "cpu_s": round(cpu, 4),
+                    "max_rss_kb": rss,
+                    "reads_per_s": round(args.pairs * 2 / wall, 1),
+                }
+                print("{tool:>9} {compression:>5} {threads:>3} threads: "
+                      "{reads_per_s:>12.1f} reads/s  {wall_s:>8.3f}s wall  "
+                      "{cpu_s:>8.3f}s CPU  {max_rss_kb:>8d} KiB".format(**res),
+                      file=sys.stderr)
+                results.append(res)
+    os.remove(outfile)
+
+    # Scaling curve: speedup of each run over the single-threaded run
+    single = {(r["tool"], r["compression"]): r["reads_per_s"]
+              for r in results if r["threads"] == 1}
+    for res in results:
+        res["speedup"] = round(
+            res["reads_per_s"] / single[(res["tool"], res["compression"])], 3)
+    return results
+
+
+def result_key(res):
+    return (res["tool"], res["compression"], res["threads"])
+
+
+def compare(results, baseline, tolerance):
+    """Returns a list of human-readable regressions against the baseline"""
+    base = {result_key(r): r for r in baseline["results"]}
+    regressions = []
+    for res in results:
+        old = base.get(result_key(res))
+        if old is None:
+            continue
+        name = "{} {} {} threads".format(*result_key(res))
+        if res["reads_per_s"] < old["reads_per_s"] * (1 - tolerance):
+            regressions.append("{}: {:.1f} reads/s vs baseline {:.1f}".format(
+                name, res["reads_per_s"], old["reads_per_s"]))
+        if res["max_rss_kb"] > old["max_rss_kb"] * (1 + tolerance):
+            regressions.append("{}: {} KiB peak RSS vs baseline {}".format(
+                name, res["max_rss_kb"], old["max_rss_kb"]))
+    return regressions
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--bindir", required=True,
+                    help="Directory containing trimit, simreads and bench_threaded")
+    ap.add_argument("--workdir", default="throughput",
+                    help="Directory for generated datasets")
+    ap.add_argument("--output", help="Write results as JSON to this file")
+    ap.add_argument("--baseline", help="Compare against this results file")
+    ap.add_argument("--tolerance", type=float, default=0.1,
+                    help="Allowed fractional regression vs baseline [0.1]")
+    ap.add_argument("--pairs", type=int, default=200000,
+                    help="Read pairs per dataset [200000]")
+    ap.add_argument("--read-len", type=int, default=150,
+                    help="Read length [150]")
+    ap.add_argument("--insert", type=int, default=300,
+                    help="Mean insert size [300]")
+    ap.add_argument("--max-threads", type=int,
+                    default=multiprocessing.cpu_count(),
+                    help="Largest thread count to test [ncpus]")
+    ap.add_argument("--repeats", type=int, default=3,
+                    help="Runs of each configuration [3]")
+    args = ap.parse_args()
+
+    datasets = make_datasets(args)
+    results = run_all(args, datasets)
+
+    report = {
+        "host": {
+            "node": platform.node(),
+            "machine": platform.machine(),
+            "cpus": multiprocessing.cpu_count(),
+        },
+        "parameters": {
+            "pairs": args.pairs,
+            "read_len": args.read_len,
+            "insert": args.insert,
+            "repeats": args.repeats,
+        },
+        "results": results,
+    }
+    if args.output:
+        with open(args.output, "w") as fh:
+            json.dump(report, fh, indent=2)
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+
+    if args.baseline:
+        with open(args.baseline) as fh:
+            baseline = json.load(fh)
+        if baseline.get("parameters") != report["parameters"]:
+            print("WARNING: baseline was run with different parameters",
+                  file=sys.stderr)
+        regressions = compare(results, baseline, args.tolerance)
+        for reg in regressions:
+            print("REGRESSION:", reg, file=sys.stderr)
+        if regressions:
+            sys.exit(1)
+        print("No regressions against baseline (tolerance {:.0%})".format(
+            args.tolerance), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,95 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+#include "qcpp.hh"
+#include "qc-contaminant.hh"
+
+
+int
+usage_err()
+{
+    using std::cerr;
+    using std::endl;
+    cerr << "USAGE: indexrefs [options] -o INDEX <reference_file> ..." << endl
+         << endl;
+    cerr << "Builds a minimizer index of reference FASTA or FASTQ files, for" << endl
+         << "trimit -I. Each file is a reference, named for the file." << endl
+         << endl;
+    cerr << "OPTIONS:" << endl;
+    cerr << " -o INDEX    Output index file. [required]" << endl;
+    cerr << " -k K        k-mer length (at most 31). [default: 21]" << endl;
+    cerr << " -w W        Window of k-mers per minimizer (at most 64). [default: 11]" << endl;
+    cerr << " -h          Show this help message." << endl;
+    return EXIT_FAILURE;
+}
+
+const char *cli_opts = "o:k:w:h";
+
+int
+main (int argc, char *argv[])
+{
+    using namespace qcpp;
+
+    std::string             outfile;
+    size_t                  k = 21;
+    size_t                  w = 11;
+
+    int c = 0;
+    while ((c = getopt(argc, argv, cli_opts)) > 0) {
+        switch (c) {
+            case 'o':
+                outfile = optarg;
+                break;
+            case 'k':
+                k = atoi(optarg);
+                break;
+            case 'w':
+                w = atoi(optarg);
+                break;
+            case 'h':
+                usage_err();
+                return EXIT_SUCCESS;
+            default:
+                std::cerr << "Bad arg '" << std::string(1, optopt) << "'"
+                          << std::endl << std::endl;
+                return usage_err();
+        }
+    }
+
+    if (outfile.size() == 0 || optind == argc) {
+        std::cerr << "Must give output file and reference files" << std::endl
+                  << std::endl;
+        return usage_err();
+    }
+    if (k < 1 || k > 31 || w < 1 || w > 64) {
+        std::cerr << "k must be from 1 to 31, and w from 1 to 64" << std::endl
+                  << std::endl;
+        return usage_err();
+    }
+
+    std::vector<std::string> references(argv + optind, argv + argc);
+    try {
+        std::shared_ptr<MinimizerIndex> index = MinimizerIndex::from_files(references, k, w);
+        index->save(outfile);
+        std::cerr << "Indexed " << index->size() << " minimizers of "
+                  << index->num_references() << " references in "
+                  << index->memory_size() << " bytes" << std::endl;
+    } catch (qcpp::IOError &e) {
+        std::cerr << "Error indexing references:" << std::endl;
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include <iostream>
+#include <string>
+
+#include <getopt.h>
+
+#include "qcpp.hh"
+#include "qc-simulate.hh"
+
+
+int
+usage_err()
+{
+    using std::cerr;
+    using std::endl;
+    qcpp::SimulatorParams defaults;
+    cerr << "USAGE: simreads [options] -n PAIRS -o OUTPUT [-2 R2_OUTPUT]" << endl
+         << endl;
+    cerr << "OPTIONS:" << endl;
+    cerr << " -n PAIRS    Number of read pairs to simulate. [required]" << endl;
+    cerr << " -o OUTPUT   Output file, interleaved unless -2 is given. Format is" << endl
+         << "             taken from the extension (.fq, .fq.gz, .fa). [required]" << endl;
+    cerr << " -2 OUTPUT   Write R2 to this file, and R1 to -o. [default: none]" << endl;
+    cerr << " -l LENGTH   Read length. [default: " << defaults.read_len << "]" << endl;
+    cerr << " -i INSERT   Mean insert size. [default: " << defaults.insert_mean << "]" << endl;
+    cerr << " -d SD       Insert size standard deviation. [default: " << defaults.insert_sd << "]" << endl;
+    cerr << " -q QUAL     Quality at 5' end of reads. [default: " << defaults.qual_start << "]" << endl;
+    cerr << " -Q QUAL     Quality at 3' end of reads. [default: " << defaults.qual_end << "]" << endl;
+    cerr << " -e RATE     Per-base substitution error rate. [default: " << defaults.error_rate << "]" << endl;
+    cerr << " -N RATE     Per-base N rate. [default: " << defaults.n_rate << "]" << endl;
+    cerr << " -s SEED     Random seed. [default: " << defaults.seed << "]" << endl;
+    cerr << " -h          Show this help message." << endl;
+    return EXIT_FAILURE;
+}
+
+const char *cli_opts = "n:o:2:l:i:d:q:Q:e:N:s:h";
+
+int
+main (int argc, char *argv[])
+{
+    using namespace qcpp;
+
+    SimulatorParams         params;
+    std::string             outfile;
+    std::string             r2_outfile;
+
+    int c = 0;
+    while ((c = getopt(argc, argv, cli_opts)) > 0) {
+        switch (c) {
+            case 'n':
+                params.num_pairs = atol(optarg);
+                break;
+            case 'o':
+                outfile = optarg;
+                break;
+            case '2':
+                r2_outfile = optarg;
+                break;
+            case 'l':
+                params.read_len = atol(optarg);
+                break;
+            case 'i':
+                params.insert_mean = atof(optarg);
+                break;
+            case 'd':
+                params.insert_sd = atof(optarg);
+                break;
+            case 'q':
+                params.qual_start = atoi(optarg);
+                break;
+            case 'Q':
+                params.qual_end = atoi(optarg);
+                break;
+            case 'e':
+                params.error_rate = atof(optarg);
+                break;
+            case 'N':
+                params.n_rate = atof(optarg);
+                break;
+            case 's':
+                params.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'h':
+                usage_err();
+                return EXIT_SUCCESS;
+            default:
+                std::cerr << "Bad arg '" << std::string(1, optopt) << "'"
+                          << std::endl << std::endl;
+                return usage_err();
+        }
+    }
+
+    if (params.num_pairs == 0 || outfile.size() == 0 || params.read_len == 0) {
+        std::cerr << "Must give number of pairs, output file and a non-zero "
+                  << "read length" << std::endl << std::endl;
+        return usage_err();
+    }
+
+    ReadSimulator           sim(params);
+    ReadPair                rp;
+    try {
+        if (r2_outfile.size() > 0) {
+            ReadDeInterleaver writer;
+            writer.open(outfile, r2_outfile);
+            while (sim.parse_read_pair(rp)) {
+                writer.write_read_pair(rp);
+            }
+        } else {
+            ReadWriter writer;
+            writer.open(outfile);
+            while (sim.parse_read_pair(rp)) {
+                writer.write_read_pair(rp);
+            }
+        }
+    } catch (qcpp::IOError &e) {
+        std::cerr << "Error writing simulated reads:" << std::endl;
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -14,13 +14,22 @@
 #include <iomanip>
 
 #include <getopt.h>
+#include <sys/stat.h>
 
 #include "qcpp.hh"
 
 #include "qc-measure.hh"
 #include "qc-length.hh"
+#include "qc-qualbin.hh"
 #include "qc-qualtrim.hh"
 #include "qc-adaptor.hh"
+#include "qc-batch.hh"
+#include "qc-complexity.hh"
+#include "qc-contaminant.hh"
+#include "qc-duplicate.hh"
+#include "qc-kmer.hh"
+#include "qc-overrep.hh"
+#include "qc-polyx.hh"
 
 
 using std::chrono::system_clock;
@@ -37,21 +46,259 @@ progress(size_t n, system_clock::time_point start)
               << "K RP/sec)\r";
 }
 
+struct PipelineOptions
+{
+    bool                    measure_qual;
+    bool                    single_end;
+    int                     qual_threshold;
+    size_t                  truncate_length;
+    size_t                  filter_length;
+    // Bytes for duplicate filtering, or 0 to keep duplicates
+    size_t                  duplicate_memory;
+    // Bases of 3' homopolymer tails to trim, or empty for none
+    std::string             polyx_bases;
+    // Null unless reads are screened for contaminants
+    std::shared_ptr<const qcpp::MinimizerIndex> contaminant_index;
+    // k-mer size for the k-mer spectrum, or 0 for none, and each thread's
+    // share of the memory for counting
+    size_t                  kmer_size;
+    size_t                  kmer_memory;
+    // Empty unless qualities are binned
+    std::vector<qcpp::QualityBin> quality_bins;
+    const qcpp::QualityEncoding *encoding;
+};
+
+// Sets up the trimit processor chain on either a ProcessedReadStream or a
+// ThreadedQCProcessor
+template <typename Stream>
+void
+setup_pipeline(Stream &stream, const PipelineOptions &opts)
+{
+    using namespace qcpp;
+
+    const QualityEncoding &encoding = *opts.encoding;
+
+    if (opts.measure_qual) {
+        stream.template append_processor<PerBaseQuality>("before qc", encoding);
+        stream.template append_processor<BaseComposition>("base composition", encoding);
+        const unsigned precision = 14;
+        const size_t max_sample = 65536;
+        stream.template append_processor<ComplexityEstimator>("library complexity", precision,
+                                                              max_sample, encoding);
+        const size_t prefix_length = 50, num_report = 20;
+        stream.template append_processor<OverrepresentedSequences>("overrepresented sequences",
+                                                                   prefix_length, num_report,
+                                                                   encoding);
+    }
+    if (opts.duplicate_memory > 0) {
+        // One set for every thread's pipeline
+        std::shared_ptr<DuplicateSet> set = std::make_shared<DuplicateSet>(opts.duplicate_memory);
+        stream.template append_processor<DuplicateFilter>("Duplicates", set, encoding);
+    }
+    if (opts.polyx_bases.size() > 0) {
+        // Before trim-merging, so that tails don't spoil read overlaps
+        const size_t min_tail_length = 10;
+        stream.template append_processor<PolyXTrim>("poly-X tails", opts.polyx_bases,
+                                                    min_tail_length, encoding);
+    }
+    if (opts.contaminant_index) {
+        // The index is only read, so is shared by every thread's pipeline
+        const double min_fraction = 0.5;
+        const bool remove = true;
+        stream.template append_processor<ContaminantFilter>("Contaminants",
+                                                            opts.contaminant_index,
+                                                            min_fraction, remove,
+                                                            encoding);
+    }
+    if (!opts.single_end) {
+        const int min_overlap = 10;
+        stream.template append_processor<AdaptorTrimPE>("trim or merge reads", min_overlap,
+                                                        encoding);
+    }
+    const size_t min_length = 1, window_size = 0;
+    stream.template append_processor<WindowedQualTrim>("QC", opts.qual_threshold, min_length,
+                                                       window_size, encoding);
+    if (opts.truncate_length > 0) {
+        stream.template append_processor<ReadTruncator>("Fix Length", opts.truncate_length,
+                                                        encoding);
+    }
+    if (opts.filter_length > 0) {
+        stream.template append_processor<ReadLenFilter>("Length Filter", opts.filter_length,
+                                                        encoding);
+    }
+    if (opts.measure_qual) {
+        stream.template append_processor<PerBaseQuality>("after qc", encoding);
+    }
+    if (opts.measure_qual && opts.kmer_size > 0) {
+        stream.template append_processor<KmerSpectrum>("k-mer spectrum", opts.kmer_size,
+                                                       opts.kmer_memory, encoding);
+    }
+    if (opts.quality_bins.size() > 0) {
+        stream.template append_processor<QualityBinner>("Quality Binning", opts.quality_bins,
+                                                        encoding);
+    }
+}
+
+// The quality encoding to use for each of filenames. "auto" detects it from
+// the files, which must all have the same encoding; pipes and other files that
+// aren't regular can't be sampled without losing their first reads, so are
+// taken to be Sanger.
+const qcpp::QualityEncoding *
+choose_encoding(const std::string &name, const std::vector<std::string> &filenames)
+{
+    using namespace qcpp;
+
+    if (name != "auto") {
+        return &quality_encoding_by_name(name);
+    }
+    const QualityEncoding *encoding = NULL;
+    for (const std::string &filename: filenames) {
+        const QualityEncoding *detected = &SangerEncoding;
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0 || S_ISREG(st.st_mode)) {
+            detected = &detect_quality_encoding(filename);
+        } else {
+            std::cerr << filename << " is not a regular file, so can't be "
+                      << "sampled; assuming Sanger quality encoding (set one "
+                      << "with -E)" << std::endl;
+        }
+        if (encoding != NULL && detected->offset != encoding->offset) {
+            throw IOError("Inputs have different quality encodings (" +
+                          encoding->name + " and " + detected->name +
+                          "), set one with -E");
+        }
+        if (encoding == NULL) {
+            encoding = detected;
+        }
+    }
+    std::cerr << "Using " << encoding->name << " quality encoding" << std::endl;
+    return encoding;
+}
+
+// Opens an output file, optionally writing behind asynchronously
+std::unique_ptr<std::streambuf>
+open_output(const std::string &filename, bool async_io)
+{
+    if (async_io) {
+        return std::unique_ptr<std::streambuf>(new qcpp::AsyncOutputBuf(filename));
+    }
+    std::unique_ptr<std::filebuf> buf(new std::filebuf);
+    if (buf->open(filename, std::ios::out | std::ios::trunc) == NULL) {
+        throw qcpp::IOError("Could not open '" + filename + "' for writing.");
+    }
+    return std::unique_ptr<std::streambuf>(buf.release());
+}
+
+// Closes an output opened by open_output(). Buffered data is written and
+// writes behind may still fail here, so this throws IOError if any write
+// failed.
+void
+close_output(std::streambuf *buf)
+{
+    qcpp::AsyncOutputBuf *async = dynamic_cast<qcpp::AsyncOutputBuf *>(buf);
+    if (async != NULL) {
+        async->close();
+        return;
+    }
+    std::filebuf *file = dynamic_cast<std::filebuf *>(buf);
+    if (file != NULL && file->close() == NULL) {
+        throw qcpp::IOError("Error writing output");
+    }
+}
+
+template <typename Processor>
+int
+run_threaded(Processor &proc, const PipelineOptions &opts,
+             const std::string &yaml_fname, bool quiet)
+{
+    system_clock::time_point start = system_clock::now();
+
+    setup_pipeline(proc, opts);
+    if (!quiet) {
+        proc.set_progress_callback([start](size_t n) {
+            progress(n, start);
+        });
+    }
+    size_t n_pairs = proc.run();
+    progress(n_pairs, start);
+    std::cerr << std::endl;
+    if (yaml_fname.size() > 0) {
+        std::ofstream yml_output(yaml_fname);
+        yml_output << proc.report();
+        yml_output << proc.scheduler_report();
+    }
+    return EXIT_SUCCESS;
+}
+
+template <typename Processor>
+int
+run_batch(Processor &batch, PipelineOptions opts, bool quiet)
+{
+    system_clock::time_point start = system_clock::now();
+
+    // Each thread of each active sample counts k-mers separately
+    opts.kmer_memory /= batch.max_pipelines();
+    setup_pipeline(batch, opts);
+    if (!quiet) {
+        batch.set_progress_callback([start](size_t n) {
+            progress(n, start);
+        });
+    }
+    size_t n_pairs = batch.run();
+    progress(n_pairs, start);
+    std::cerr << std::endl;
+    return EXIT_SUCCESS;
+}
+
 int
 usage_err()
 {
     using std::cerr;
     using std::endl;
     cerr << "USAGE: trimit [options] <read_file>" << endl
+         << "       trimit [options] -M MANIFEST" << endl
          << endl;
     cerr << "OPTIONS:" << endl;
     cerr << " -q QUALITY  Minimum acceptable PHRED score. [default: 25]" << endl;
     cerr << " -l LENGTH   Remove reads less than LEN bases long [default: off]" << endl;
     cerr << " -L LENGTH   Truncate read to length LEN [default: off]" << endl;
+    cerr << " -B SCHEME   Bin quality scores: illumina8, illumina4, binary:THRESHOLD or" << endl
+         << "             custom bins like 0-19:10,20-29:25,30-:35. [default: off]" << endl;
+    cerr << " -E ENCODING Quality encoding: auto, sanger, solexa, illumina13, illumina15" << endl
+         << "             or illumina18. auto detects it from the first reads of the" << endl
+         << "             input (Sanger for stdin and pipes). [default: auto]" << endl;
+    cerr << " -D MEMORY   Remove duplicate reads or read pairs, with a table of at most" << endl
+         << "             MEMORY megabytes, beyond which some unique reads are removed." << endl
+         << "             Not with -M. [default: off]" << endl;
+    cerr << " -X BASES    Trim 3' homopolymer tails of at least 10 of BASES, e.g. G for" << endl
+         << "             the poly-G tails of two-colour chemistry, or ACGT for any." << endl
+         << "             [default: off]" << endl;
+    cerr << " -C FASTA    Remove reads or read pairs with at least half their minimizers" << endl
+         << "             in FASTA, e.g. PhiX or vector sequence. May be given more" << endl
+         << "             than once. [default: off]" << endl;
+    cerr << " -I INDEX    As -C, with an index of contaminants made by indexrefs, which" << endl
+         << "             is memory-mapped rather than built. Not with -C. [default: off]" << endl;
+    cerr << " -k K        Report the spectrum of k-mers of length K (at most 31) in" << endl
+         << "             the reads kept, with -y. [default: off]" << endl;
+    cerr << " -K MEMORY   Count k-mers in at most MEMORY megabytes, beyond which they" << endl
+         << "             are sub-sampled. [default: 1024]" << endl;
     cerr << " -y YAML     YAML report file. [default: none]" << endl;
     cerr << " -o OUTPUT   Output file. [default: stdout]" << endl;
     cerr << " -s          Single ended mode (no trim-merge). [default: false]" << endl;
     cerr << " -b          Use broken-paired output (don't keep read pairing) [default: false]" << endl;
+    cerr << " -u UNPAIRED With -b, write reads whose mate was removed to this file." << endl
+         << "             [default: output file]" << endl;
+    cerr << " -t THREADS  Number of worker threads. [default: 1]" << endl;
+    cerr << " -A          Use asynchronous read-ahead and write-behind IO" << endl
+         << "             from a background thread. [default: false]" << endl;
+    cerr << " -m          Memory-map the input file, which must be uncompressed, and" << endl
+         << "             parse it in the worker threads. [default: false]" << endl;
+    cerr << " -N          Pin threads to CPUs, grouping workers by NUMA node (with -t" << endl
+         << "             or -m). [default: false]" << endl;
+    cerr << " -M MANIFEST Process each sample in a YAML manifest of input, output, and" << endl
+         << "             optional input_r2 (separate R2 reads), orphans and report" << endl
+         << "             files, sharing the worker threads." << endl
+         << "             -o, -y and -u are ignored. [default: none]" << endl;
     cerr << " -Q          Quiet mode, does not log progress [default: log progress to stderr]" << endl;
     cerr << " -h          Show this help message." << endl;
     cerr << endl;
@@ -59,7 +306,7 @@ usage_err()
     return EXIT_FAILURE;
 }
 
-const char *cli_opts = "q:y:o:l:L:bshQ";
+const char *cli_opts = "q:y:o:l:L:t:u:M:B:E:D:X:C:I:k:K:AmNbshQ";
 
 int
 main (int argc, char *argv[])
@@ -70,12 +317,25 @@ main (int argc, char *argv[])
     bool                    broken_paired = false;
     bool                    single_end = false;
     bool                    quiet = false;
-    std::ofstream           read_output;
+    bool                    mapped_input = false;
+    bool                    async_io = false;
+    bool                    numa_placement = false;
     std::string             outfile = "/dev/stdout";
+    std::string             unpaired_fname;
+    std::string             manifest_fname;
     std::string             infile = "";
     size_t                  truncate_length = 0;
     size_t                  filter_length = 0;
+    size_t                  duplicate_memory = 0;
+    std::string             polyx_bases;
+    std::vector<std::string> contaminant_files;
+    std::string             contaminant_index_fname;
+    size_t                  kmer_size = 0;
+    size_t                  kmer_memory = size_t(1024) << 20;
     int                     qual_threshold = 25;
+    size_t                  num_threads = 1;
+    std::vector<QualityBin> quality_bins;
+    std::string             encoding_name = "auto";
 
     std::cerr << argv[0] << " version " << QCPP_VERSION
                           << std::endl << std::endl;
@@ -106,6 +366,58 @@ main (int argc, char *argv[])
             case 'l':
                 filter_length = atoi(optarg);
                 break;
+            case 't':
+                num_threads = atoi(optarg);
+                break;
+            case 'u':
+                unpaired_fname = optarg;
+                break;
+            case 'M':
+                manifest_fname = optarg;
+                break;
+            case 'm':
+                mapped_input = true;
+                break;
+            case 'A':
+                async_io = true;
+                break;
+            case 'N':
+                numa_placement = true;
+                break;
+            case 'D':
+                duplicate_memory = size_t(atoi(optarg)) << 20;
+                break;
+            case 'X':
+                polyx_bases = optarg;
+                if (polyx_bases.find_first_not_of("ACGTacgt") != std::string::npos) {
+                    std::cerr << "Poly-X bases must be of A, C, G and T" << std::endl
+                              << std::endl;
+                    return usage_err();
+                }
+                break;
+            case 'C':
+                contaminant_files.push_back(optarg);
+                break;
+            case 'I':
+                contaminant_index_fname = optarg;
+                break;
+            case 'k':
+                kmer_size = atoi(optarg);
+                break;
+            case 'K':
+                kmer_memory = size_t(atoi(optarg)) << 20;
+                break;
+            case 'E':
+                encoding_name = optarg;
+                break;
+            case 'B':
+                try {
+                    quality_bins = parse_quality_bins(optarg);
+                } catch (qcpp::IOError &e) {
+                    std::cerr << e.what() << std::endl << std::endl;
+                    return usage_err();
+                }
+                break;
             case 'h':
                 usage_err();
                 return EXIT_SUCCESS;
@@ -116,6 +428,83 @@ main (int argc, char *argv[])
         }
     }
 
+    std::shared_ptr<const MinimizerIndex> contaminant_index;
+    if (contaminant_files.size() > 0 && contaminant_index_fname.size() > 0) {
+        std::cerr << "Can't use both -C and -I" << std::endl << std::endl;
+        return usage_err();
+    }
+    if (contaminant_files.size() > 0 || contaminant_index_fname.size() > 0) {
+        try {
+            if (contaminant_index_fname.size() > 0) {
+                contaminant_index = MinimizerIndex::load(contaminant_index_fname);
+            } else {
+                contaminant_index = MinimizerIndex::from_files(contaminant_files);
+            }
+        } catch (qcpp::IOError  &e) {
+            std::cerr << "Error reading contaminants:" << std::endl;
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (manifest_fname.size() > 0) {
+        PipelineOptions opts;
+
+        if (duplicate_memory > 0) {
+            // Samples' pipelines are set up with the same arguments, so
+            // would share one set of reads
+            std::cerr << "Can't remove duplicates in batch mode" << std::endl << std::endl;
+            return usage_err();
+        }
+        opts.duplicate_memory = 0;
+        opts.polyx_bases = polyx_bases;
+        opts.contaminant_index = contaminant_index;
+
+        opts.single_end = single_end;
+        opts.qual_threshold = qual_threshold;
+        opts.truncate_length = truncate_length;
+        opts.filter_length = filter_length;
+        opts.quality_bins = quality_bins;
+        if (num_threads < 1) {
+            std::cerr << "Must use at least one thread" << std::endl << std::endl;
+            return usage_err();
+        }
+        opts.kmer_size = kmer_size;
+        opts.kmer_memory = kmer_memory;
+        try {
+            std::vector<BatchJob> jobs = read_batch_manifest(manifest_fname);
+            std::vector<std::string> inputs;
+
+            for (const BatchJob &job: jobs) {
+                inputs.push_back(job.input);
+                if (job.input_r2.size() > 0) {
+                    inputs.push_back(job.input_r2);
+                }
+            }
+            opts.encoding = choose_encoding(encoding_name, inputs);
+
+            opts.measure_qual = false;
+            for (const BatchJob &job: jobs) {
+                opts.measure_qual |= job.report.size() > 0;
+            }
+            if (single_end) {
+                BatchQCProcessorSE batch(num_threads);
+                batch.add_jobs(jobs);
+                return run_batch(batch, opts, quiet);
+            }
+            BatchQCProcessor batch(num_threads);
+            batch.add_jobs(jobs);
+            if (broken_paired) {
+                batch.set_output_policy<BrokenPairedOutput>(64);
+            }
+            return run_batch(batch, opts, quiet);
+        } catch (qcpp::IOError  &e) {
+            std::cerr << "Error processing batch:" << std::endl;
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     if (optind == argc) {
         std::cerr << "Must give input file!" << std::endl << std::endl;
         usage_err();
@@ -124,71 +513,165 @@ main (int argc, char *argv[])
 
     infile = argv[optind];
     if (infile == "-") infile = "/dev/stdin";
-    read_output.open(outfile);
+    bool split_orphans = broken_paired && unpaired_fname.size() > 0;
 
-    ProcessedReadStream     stream;
     uint64_t                n_pairs = 0;
-    bool                    measure_qual = yaml_fname.size() > 0;
+    PipelineOptions         opts;
 
+    opts.measure_qual = yaml_fname.size() > 0;
+    opts.single_end = single_end;
+    opts.qual_threshold = qual_threshold;
+    opts.truncate_length = truncate_length;
+    opts.filter_length = filter_length;
+    opts.quality_bins = quality_bins;
+    opts.duplicate_memory = duplicate_memory;
+    opts.polyx_bases = polyx_bases;
+    opts.contaminant_index = contaminant_index;
 
-    if (measure_qual) {
-        stream.append_processor<PerBaseQuality>("before qc");
-    }
-    if (!single_end) {
-        const int min_overlap = 10;
-        stream.append_processor<AdaptorTrimPE>("trim or merge reads", min_overlap);
+    if (num_threads < 1) {
+        std::cerr << "Must use at least one thread" << std::endl << std::endl;
+        return usage_err();
     }
-    stream.append_processor<WindowedQualTrim>("QC", qual_threshold);
-    if (truncate_length > 0) {
-        stream.append_processor<ReadTruncator>("Fix Length", truncate_length);
-    }
-    if (filter_length > 0) {
-        stream.append_processor<ReadLenFilter>("Length Filter", filter_length);
+    // Each thread counts k-mers separately
+    opts.kmer_size = kmer_size;
+    opts.kmer_memory = kmer_memory / num_threads;
+
+    try {
+        opts.encoding = choose_encoding(encoding_name, {infile});
+    } catch (qcpp::IOError  &e) {
+        std::cerr << "Error choosing quality encoding:" << std::endl;
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
     }
-    if (measure_qual) {
-        stream.append_processor<PerBaseQuality>("after qc");
+
+    if (num_threads > 1 || mapped_input) {
+        try {
+            std::unique_ptr<std::streambuf> output_buf = open_output(outfile, async_io);
+            std::unique_ptr<std::streambuf> unpaired_buf;
+            if (split_orphans) {
+                unpaired_buf = open_output(unpaired_fname, async_io);
+            }
+            std::ostream read_output(output_buf.get());
+            std::ostream unpaired_output(unpaired_buf.get());
+            std::ostream *orphan_output = split_orphans ? &unpaired_output
+                                                        : &read_output;
+
+            int ret;
+            if (single_end) {
+                ThreadedQCProcessorSE proc(infile, &read_output, num_threads);
+                if (mapped_input) {
+                    proc.set_mapped_input();
+                } else if (async_io) {
+                    proc.set_async_input();
+                }
+                proc.set_numa_placement(numa_placement);
+                ret = run_threaded(proc, opts, yaml_fname, quiet);
+            } else {
+                ThreadedQCProcessor proc(infile, &read_output, num_threads);
+                if (mapped_input) {
+                    proc.set_mapped_input();
+                } else if (async_io) {
+                    proc.set_async_input();
+                }
+                proc.set_numa_placement(numa_placement);
+                if (broken_paired) {
+                    proc.set_output_policy<BrokenPairedOutput>(64);
+                    proc.set_orphan_output(orphan_output);
+                }
+                ret = run_threaded(proc, opts, yaml_fname, quiet);
+            }
+            close_output(output_buf.get());
+            if (split_orphans) {
+                close_output(unpaired_buf.get());
+            }
+            return ret;
+        } catch (qcpp::IOError  &e) {
+            std::cerr << "Error processing reads:" << std::endl;
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
     }
 
+    ProcessedReadStream     stream;
+    BufferedReadWriter      read_output;
+    BufferedReadWriter      unpaired_output;
+    BufferedReadWriter     *orphan_output = &read_output;
+
+    setup_pipeline(stream, opts);
+
     try {
-        stream.open(infile);
+        if (async_io) {
+            stream.open(infile, AsyncIOOptions());
+        } else {
+            stream.open(infile);
+        }
     } catch (qcpp::IOError  &e) {
         std::cerr << "Error opening input file:" << std::endl;
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
     }
-    system_clock::time_point start = system_clock::now();
-    if (single_end) {
-        Read rd;
-        while (stream.parse_read(rd)) {
-            read_output << rd.str();
-            if (!quiet && n_pairs % 10000 == 0) {
-                progress(n_pairs, start);
+    try {
+        if (async_io) {
+            read_output.open(outfile, AsyncIOOptions());
+        } else {
+            read_output.open(outfile);
+        }
+        if (split_orphans) {
+            if (async_io) {
+                unpaired_output.open(unpaired_fname, AsyncIOOptions());
+            } else {
+                unpaired_output.open(unpaired_fname);
             }
-            n_pairs++;
+            orphan_output = &unpaired_output;
         }
-    } else {
-        ReadPair rp;
-        while (stream.parse_read_pair(rp)) {
-            std::string rp_str = "";
-
-            if (broken_paired) {
-                if (rp.first.size() >= 64) {
-                    rp_str = rp.first.str();
-                }
-                if (rp.second.size() >= 64) {
-                    rp_str += rp.second.str();
+    } catch (qcpp::IOError  &e) {
+        std::cerr << "Error opening output file:" << std::endl;
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    system_clock::time_point start = system_clock::now();
+    std::string rd_str, orphan_str;
+    try {
+        if (single_end) {
+            SingleOutput output;
+            Read rd;
+            while (stream.parse_read(rd)) {
+                rd_str.clear();
+                output.format(rd, rd_str, orphan_str);
+                read_output.write(rd_str);
+                if (!quiet && n_pairs % 10000 == 0) {
+                    progress(n_pairs, start);
                 }
+                n_pairs++;
+            }
+        } else {
+            std::unique_ptr<OutputPolicy<ReadPair>> output;
+            if (broken_paired) {
+                output.reset(new BrokenPairedOutput(64));
             } else {
-                rp_str = rp.str();
+                output.reset(new PairedOutput);
             }
+            ReadPair rp;
+            while (stream.parse_read_pair(rp)) {
+                rd_str.clear();
+                orphan_str.clear();
+                output->format(rp, rd_str, orphan_str);
 
-            if (!quiet && n_pairs % 10000 == 0) {
-                progress(n_pairs, start);
-            }
-            n_pairs++;
+                if (!quiet && n_pairs % 10000 == 0) {
+                    progress(n_pairs, start);
+                }
+                n_pairs++;
 
-            read_output << rp_str;
+                read_output.write(rd_str);
+                orphan_output->write(orphan_str);
+            }
         }
+        read_output.close();
+        unpaired_output.close();
+    } catch (qcpp::IOError  &e) {
+        std::cerr << "Error processing reads:" << std::endl;
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
     }
     progress(n_pairs, start);
     std::cerr << std::endl;
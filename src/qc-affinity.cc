@@ -0,0 +1,204 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "qc-affinity.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <tuple>
+#include <dirent.h>
+
+#ifdef __linux__
+#   include <sched.h>
+#endif
+
+namespace qcpp
+{
+
+std::vector<int>
+parse_cpu_list(const std::string &list)
+{
+    std::vector<int> cpus;
+    const char *pos = list.c_str();
+
+    while (*pos != '\0' && *pos != '\n') {
+        char *end;
+        long first = strtol(pos, &end, 10);
+        long last = first;
+
+        if (end == pos || first < 0) {
+            throw IOError("Malformed CPU list '" + list + "'");
+        }
+        pos = end;
+        if (*pos == '-') {
+            last = strtol(++pos, &end, 10);
+            if (end == pos || last < first) {
+                throw IOError("Malformed CPU list '" + list + "'");
+            }
+            pos = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        if (*pos == ',') {
+            pos++;
+        } else if (*pos != '\0' && *pos != '\n') {
+            throw IOError("Malformed CPU list '" + list + "'");
+        }
+    }
+    return cpus;
+}
+
+// CPUs in the calling process's affinity mask
+static std::vector<int>
+allowed_cpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        int n_cpus = std::max(1u, std::thread::hardware_concurrency());
+        for (int cpu = 0; cpu < n_cpus; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/*****************************************************************************
+ *                                CpuTopology
+ *****************************************************************************/
+
+CpuTopology
+CpuTopology::
+detect(const std::string &sysfs_root)
+{
+    CpuTopology topology;
+    std::vector<int> allowed = allowed_cpus();
+    std::vector<int> node_ids;
+    DIR *dir = opendir(sysfs_root.c_str());
+
+    if (dir != NULL) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            const char *name = entry->d_name;
+            char *end;
+            if (strncmp(name, "node", 4) != 0) {
+                continue;
+            }
+            long id = strtol(name + 4, &end, 10);
+            if (end != name + 4 && *end == '\0') {
+                node_ids.push_back(static_cast<int>(id));
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(node_ids.begin(), node_ids.end());
+
+    for (int id: node_ids) {
+        std::ifstream cpulist(sysfs_root + "/node" + std::to_string(id) +
+                              "/cpulist");
+        std::string list;
+        std::vector<int> cpus;
+
+        if (!std::getline(cpulist, list)) {
+            continue;
+        }
+        for (int cpu: parse_cpu_list(list)) {
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            topology.node_ids.push_back(id);
+            topology.node_cpus.push_back(cpus);
+        }
+    }
+
+    if (topology.node_cpus.empty()) {
+        topology.node_ids.push_back(0);
+        topology.node_cpus.push_back(allowed);
+    }
+    return topology;
+}
+
+/*****************************************************************************
+ *                                ThreadLayout
+ *****************************************************************************/
+
+ThreadLayout
+ThreadLayout::
+plan(const CpuTopology &topology, size_t num_workers)
+{
+    ThreadLayout layout;
+    const size_t n_nodes = topology.num_nodes();
+    // Workers placed so far on each node
+    std::vector<size_t> node_workers(n_nodes, 0);
+
+    layout.node_ids = topology.node_ids;
+    for (size_t i = 0; i < num_workers; i++) {
+        ThreadPlacement worker;
+        worker.node = i * n_nodes / num_workers;
+
+        const std::vector<int> &cpus = topology.node_cpus[worker.node];
+        worker.cpus.push_back(cpus[node_workers[worker.node]++ % cpus.size()]);
+        layout.workers.push_back(worker);
+    }
+    layout.reader.cpus = topology.node_cpus[0];
+    layout.writer.cpus = topology.node_cpus[0];
+    return layout;
+}
+
+ThreadLayout
+ThreadLayout::
+unpinned(size_t num_workers)
+{
+    ThreadLayout layout;
+    layout.workers.resize(num_workers);
+    return layout;
+}
+
+bool
+pin_current_thread(const std::vector<int> &cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+
+    if (cpus.empty()) {
+        return false;
+    }
+    CPU_ZERO(&set);
+    for (int cpu: cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    // pid 0 is the calling thread
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    std::ignore = cpus;
+    return false;
+#endif
+}
+
+} // namespace qcpp
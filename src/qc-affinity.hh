@@ -0,0 +1,92 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_AFFINITY_HH
+#define QC_AFFINITY_HH
+
+#include "qc-config.hh"
+#include "qc-io.hh"
+
+#include <string>
+#include <vector>
+
+
+namespace qcpp
+{
+
+// Parses a Linux CPU list, e.g. "0-3,8,10-11", as found in sysfs. Throws
+// IOError if the list is malformed.
+std::vector<int> parse_cpu_list(const std::string &list);
+
+// The CPUs this process may run on, grouped by NUMA node. Read from sysfs, so
+// libnuma isn't needed.
+struct CpuTopology
+{
+    // System node number of each node
+    std::vector<int>        node_ids;
+    // CPUs of each node, restricted to the process's affinity mask. Nodes
+    // without any such CPUs are left out.
+    std::vector<std::vector<int>> node_cpus;
+
+    // Reads nodes from sysfs_root (e.g. /sys/devices/system/node). Without
+    // NUMA information, all CPUs are placed on a single node 0.
+    static CpuTopology detect(const std::string &sysfs_root="/sys/devices/system/node");
+
+    size_t
+    num_nodes                       () const
+    {
+        return node_cpus.size();
+    }
+};
+
+// Where one thread should run. node indexes CpuTopology::node_cpus. An
+// empty cpus leaves the thread unpinned.
+struct ThreadPlacement
+{
+    size_t                  node;
+    std::vector<int>        cpus;
+    // Set by the thread once it has pinned itself
+    bool                    pinned;
+
+    ThreadPlacement() : node(0), pinned(false) {}
+};
+
+// The placement of a threaded processor's reader, writer and workers
+struct ThreadLayout
+{
+    ThreadPlacement         reader;
+    ThreadPlacement         writer;
+    std::vector<ThreadPlacement> workers;
+    // System node number of each node
+    std::vector<int>        node_ids;
+
+    ThreadLayout() : node_ids(1, 0) {}
+
+    size_t
+    num_nodes                       () const
+    {
+        return node_ids.size();
+    }
+
+    // Spreads workers over nodes in contiguous blocks (so neighbouring
+    // workers share a node), each pinned to one CPU of its node in turn.
+    // The reader and writer may run on any CPU of the first node.
+    static ThreadLayout plan(const CpuTopology &topology, size_t num_workers);
+
+    // All threads unpinned on a single node
+    static ThreadLayout unpinned(size_t num_workers);
+};
+
+// Restricts the calling thread to cpus with sched_setaffinity(2). Returns
+// false if that isn't possible, in which case the thread is left as it was.
+bool pin_current_thread(const std::vector<int> &cpus);
+
+} // namespace qcpp
+
+#endif /* QC_AFFINITY_HH */
@@ -0,0 +1,494 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "qc-aio.hh"
+#include "qc-io.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace qcpp
+{
+
+/*****************************************************************************
+ *                                IO Engines
+ *****************************************************************************/
+
+// An IO engine owns num_buffers buffers ("slots"), and reads or writes each
+// slot asynchronously. At most one request per slot may be in flight.
+class AsyncIOEngine
+{
+public:
+    AsyncIOEngine(int fd, const AsyncIOOptions &options)
+        : _fd(fd)
+        , _seekable(false)
+        , _buffer_size(std::max<size_t>(options.buffer_size, 4096))
+    {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            _seekable = true;
+        }
+        size_t num_buffers = std::max<size_t>(options.num_buffers, 1);
+        for (size_t i = 0; i < num_buffers; i++) {
+            void *buf = NULL;
+            // Page-aligned, which also allows O_DIRECT
+            if (posix_memalign(&buf, 4096, _buffer_size) != 0) {
+                _free_buffers();
+                throw std::bad_alloc();
+            }
+            _buffers.push_back(static_cast<char *>(buf));
+        }
+    }
+
+    virtual
+    ~AsyncIOEngine()
+    {
+        _free_buffers();
+    }
+
+    char *
+    buffer(size_t slot)
+    {
+        return _buffers[slot];
+    }
+
+    size_t
+    buffer_size() const
+    {
+        return _buffer_size;
+    }
+
+    size_t
+    num_buffers() const
+    {
+        return _buffers.size();
+    }
+
+    // Reads len bytes at offset into slot. Offsets are ignored for files which
+    // can't seek (pipes etc.), which are read in submission order.
+    virtual void
+    submit_read(size_t slot, size_t offset, size_t len) = 0;
+
+    // Writes the first len bytes of slot at offset
+    virtual void
+    submit_write(size_t slot, size_t offset, size_t len) = 0;
+
+    // Waits for the request on slot, returning the number of bytes
+    // transferred. Reads return fewer than requested only at end of file.
+    virtual size_t
+    wait(size_t slot) = 0;
+
+    virtual const char *
+    name() const = 0;
+
+protected:
+    int                     _fd;
+    bool                    _seekable;
+    size_t                  _buffer_size;
+    std::vector<char *>     _buffers;
+
+    void
+    _free_buffers()
+    {
+        for (char *buf: _buffers) {
+            free(buf);
+        }
+        _buffers.clear();
+    }
+
+    // Synchronously transfers len bytes, retrying short transfers
+    size_t
+    _transfer(bool write, char *buf, size_t offset, size_t len)
+    {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t res;
+            if (write) {
+                res = _seekable ? pwrite(_fd, buf + done, len - done, offset + done)
+                                : ::write(_fd, buf + done, len - done);
+            } else {
+                res = _seekable ? pread(_fd, buf + done, len - done, offset + done)
+                                : ::read(_fd, buf + done, len - done);
+            }
+            if (res < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw IOError(std::string(write ? "Error writing: " : "Error reading: ")
+                              + strerror(errno));
+            }
+            if (res == 0) {
+                if (write) {
+                    throw IOError("Error writing: no data written");
+                }
+                break;  // End of file
+            }
+            done += res;
+        }
+        return done;
+    }
+};
+
+// Makes requests with blocking pread/pwrite (or read/write) calls from a
+// background thread, in the order they are submitted.
+class ThreadIOEngine: public AsyncIOEngine
+{
+public:
+    ThreadIOEngine(int fd, const AsyncIOOptions &options)
+        : AsyncIOEngine(fd, options)
+        , _done(num_buffers(), false)
+        , _result(num_buffers(), 0)
+        , _error(num_buffers())
+        , _stop(false)
+    {
+        _thread = std::thread(&ThreadIOEngine::_run, this);
+    }
+
+    ~ThreadIOEngine()
+    {
+        {
+            std::lock_guard<std::mutex> lg(_mutex);
+            // Outstanding read-ahead is no longer needed. Writers wait for
+            // their requests before destroying the engine.
+            _queue.clear();
+            _stop = true;
+        }
+        _work_cv.notify_one();
+        _thread.join();
+    }
+
+    void
+    submit_read(size_t slot, size_t offset, size_t len)
+    {
+        _submit(Request{slot, false, offset, len});
+    }
+
+    void
+    submit_write(size_t slot, size_t offset, size_t len)
+    {
+        _submit(Request{slot, true, offset, len});
+    }
+
+    size_t
+    wait(size_t slot)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done_cv.wait(lock, [this, slot]{ return _done[slot]; });
+        _done[slot] = false;
+        if (!_error[slot].empty()) {
+            std::string error;
+            std::swap(error, _error[slot]);
+            throw IOError(error);
+        }
+        return _result[slot];
+    }
+
+    const char *
+    name() const
+    {
+        return "pread";
+    }
+
+protected:
+    struct Request
+    {
+        size_t              slot;
+        bool                write;
+        size_t              offset;
+        size_t              len;
+    };
+
+    std::thread             _thread;
+    std::mutex              _mutex;
+    std::condition_variable _work_cv;
+    std::condition_variable _done_cv;
+    std::deque<Request>     _queue;
+    std::vector<bool>       _done;
+    std::vector<size_t>     _result;
+    std::vector<std::string> _error;
+    bool                    _stop;
+
+    void
+    _submit(const Request &req)
+    {
+        {
+            std::lock_guard<std::mutex> lg(_mutex);
+            _queue.push_back(req);
+        }
+        _work_cv.notify_one();
+    }
+
+    void
+    _run()
+    {
+        while (true) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _work_cv.wait(lock, [this]{ return _stop || !_queue.empty(); });
+            if (_stop) {
+                return;
+            }
+            Request req = _queue.front();
+            _queue.pop_front();
+            lock.unlock();
+
+            size_t result = 0;
+            std::string error;
+            try {
+                result = _transfer(req.write, buffer(req.slot), req.offset, req.len);
+            } catch (IOError &err) {
+                error = err.what();
+            }
+
+            lock.lock();
+            _result[req.slot] = result;
+            _error[req.slot] = error;
+            _done[req.slot] = true;
+            lock.unlock();
+            _done_cv.notify_all();
+        }
+    }
+};
+
+static std::unique_ptr<AsyncIOEngine>
+make_engine(int fd, const AsyncIOOptions &options)
+{
+    return std::unique_ptr<AsyncIOEngine>(new ThreadIOEngine(fd, options));
+}
+
+/*****************************************************************************
+ *                               AsyncInputBuf
+ *****************************************************************************/
+
+AsyncInputBuf::
+AsyncInputBuf(const std::string &filename, const AsyncIOOptions &options)
+    : _fd(-1)
+    , _current(0)
+    , _started(false)
+    , _eof(false)
+    , _next_offset(0)
+{
+    _fd = ::open(filename.c_str(), O_RDONLY);
+    if (_fd < 0) {
+        throw IOError("Could not open '" + filename + "' for reading: " +
+                      strerror(errno));
+    }
+    try {
+        _engine = make_engine(_fd, options);
+    } catch (...) {
+        ::close(_fd);
+        throw;
+    }
+    // Start reading ahead into every buffer
+    for (size_t i = 0; i < _engine->num_buffers(); i++) {
+        _engine->submit_read(i, _next_offset, _engine->buffer_size());
+        _next_offset += _engine->buffer_size();
+    }
+    setg(NULL, NULL, NULL);
+}
+
+AsyncInputBuf::
+~AsyncInputBuf()
+{
+    _engine.reset();
+    ::close(_fd);
+}
+
+AsyncInputBuf::int_type
+AsyncInputBuf::
+underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (_eof) {
+        return traits_type::eof();
+    }
+    if (_started) {
+        // The current block has been consumed, so reuse its buffer to read
+        // ahead, and move on to the next block
+        _engine->submit_read(_current, _next_offset, _engine->buffer_size());
+        _next_offset += _engine->buffer_size();
+        _current = (_current + 1) % _engine->num_buffers();
+    }
+    _started = true;
+
+    size_t len = _engine->wait(_current);
+    if (len < _engine->buffer_size()) {
+        // Any later blocks are past the end of the file
+        _eof = true;
+    }
+    if (len == 0) {
+        return traits_type::eof();
+    }
+    char *buf = _engine->buffer(_current);
+    setg(buf, buf, buf + len);
+    return traits_type::to_int_type(*buf);
+}
+
+const char *
+AsyncInputBuf::
+backend() const
+{
+    return _engine->name();
+}
+
+/*****************************************************************************
+ *                               AsyncOutputBuf
+ *****************************************************************************/
+
+AsyncOutputBuf::
+AsyncOutputBuf(const std::string &filename, const AsyncIOOptions &options)
+    : _fd(-1)
+    , _current(0)
+    , _offset(0)
+{
+    _fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (_fd < 0) {
+        throw IOError("Could not open '" + filename + "' for writing: " +
+                      strerror(errno));
+    }
+    try {
+        _engine = make_engine(_fd, options);
+    } catch (...) {
+        ::close(_fd);
+        throw;
+    }
+    _pending.assign(_engine->num_buffers(), false);
+    char *buf = _engine->buffer(_current);
+    setp(buf, buf + _engine->buffer_size());
+}
+
+AsyncOutputBuf::
+~AsyncOutputBuf()
+{
+    // Errors can't be reported from here; call close() to check for them
+    try {
+        close();
+    } catch (IOError &) {
+    }
+}
+
+void
+AsyncOutputBuf::
+_submit_current()
+{
+    size_t len = pptr() - pbase();
+    if (len == 0) {
+        return;
+    }
+    _engine->submit_write(_current, _offset, len);
+    _pending[_current] = true;
+    _offset += len;
+
+    // Wait for the oldest write, if any, to free its buffer
+    _current = (_current + 1) % _engine->num_buffers();
+    char *buf = _engine->buffer(_current);
+    setp(buf, buf + _engine->buffer_size());
+    if (_pending[_current]) {
+        _pending[_current] = false;
+        _engine->wait(_current);
+    }
+}
+
+void
+AsyncOutputBuf::
+_wait_all()
+{
+    std::string error;
+    for (size_t i = 0; i < _pending.size(); i++) {
+        if (_pending[i]) {
+            _pending[i] = false;
+            try {
+                _engine->wait(i);
+            } catch (IOError &err) {
+                error = err.what();
+            }
+        }
+    }
+    if (!error.empty()) {
+        throw IOError(error);
+    }
+}
+
+AsyncOutputBuf::int_type
+AsyncOutputBuf::
+overflow(int_type ch)
+{
+    if (!_engine) {
+        return traits_type::eof();
+    }
+    try {
+        _submit_current();
+    } catch (IOError &err) {
+        _error = err.what();
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int
+AsyncOutputBuf::
+sync()
+{
+    if (!_engine) {
+        return -1;
+    }
+    try {
+        _submit_current();
+        _wait_all();
+    } catch (IOError &err) {
+        _error = err.what();
+        return -1;
+    }
+    return 0;
+}
+
+void
+AsyncOutputBuf::
+close()
+{
+    if (_fd < 0) {
+        return;
+    }
+    sync();
+    _engine.reset();
+    setp(NULL, NULL);
+    if (::close(_fd) != 0 && _error.empty()) {
+        _error = strerror(errno);
+    }
+    _fd = -1;
+    if (!_error.empty()) {
+        std::string error;
+        std::swap(error, _error);
+        throw IOError("Error writing output: " + error);
+    }
+}
+
+const char *
+AsyncOutputBuf::
+backend() const
+{
+    return _engine ? _engine->name() : "closed";
+}
+
+} // namespace qcpp
@@ -0,0 +1,106 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_AIO_HH
+#define QC_AIO_HH
+
+#include "qc-config.hh"
+
+#include <streambuf>
+
+
+namespace qcpp
+{
+
+struct AsyncIOOptions
+{
+    // Size of each IO request
+    size_t                  buffer_size;
+    // Number of buffers, i.e. the maximum number of requests in flight
+    size_t                  num_buffers;
+
+    AsyncIOOptions()
+        : buffer_size(1 << 22)
+        , num_buffers(4)
+    {}
+};
+
+// Defined in qc-aio.cc
+class AsyncIOEngine;
+
+// A read-only streambuf which reads a file ahead of the consumer, keeping up
+// to num_buffers reads in flight. Blocks are handed to the consumer without
+// copying. Errors are thrown as IOError from the streambuf's input functions.
+class AsyncInputBuf: public std::streambuf
+{
+public:
+    AsyncInputBuf               (const std::string &filename,
+                                 const AsyncIOOptions &options=AsyncIOOptions());
+    ~AsyncInputBuf              ();
+
+    // Name of the IO backend in use, "pread"
+    const char *
+    backend                     () const;
+
+protected:
+    int_type
+    underflow                   ();
+
+    std::unique_ptr<AsyncIOEngine> _engine;
+    int                     _fd;
+    size_t                  _current;
+    bool                    _started;
+    bool                    _eof;
+    size_t                  _next_offset;
+};
+
+// A write-only streambuf which writes full buffers behind the producer,
+// keeping up to num_buffers writes in flight. As std::ostream swallows
+// exceptions from its streambuf, errors are reported by close(), which must be
+// called to detect write failures.
+class AsyncOutputBuf: public std::streambuf
+{
+public:
+    AsyncOutputBuf              (const std::string &filename,
+                                 const AsyncIOOptions &options=AsyncIOOptions());
+    ~AsyncOutputBuf             ();
+
+    // Writes any buffered data, waits for all writes, and closes the file.
+    // Throws IOError if any write failed. The destructor also closes the
+    // file, but can't report errors, so call this to check for them.
+    void
+    close                       ();
+
+    const char *
+    backend                     () const;
+
+protected:
+    int_type
+    overflow                    (int_type           ch);
+
+    int
+    sync                        ();
+
+    void
+    _submit_current             ();
+
+    void
+    _wait_all                   ();
+
+    std::unique_ptr<AsyncIOEngine> _engine;
+    int                     _fd;
+    size_t                  _current;
+    size_t                  _offset;
+    std::vector<bool>       _pending;
+    std::string             _error;
+};
+
+} // namespace qcpp
+
+#endif /* QC_AIO_HH */
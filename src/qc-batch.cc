@@ -0,0 +1,412 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "qc-batch.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <type_traits>
+
+#include <yaml-cpp/yaml.h>
+
+namespace qcpp
+{
+
+std::vector<BatchJob>
+read_batch_manifest(const std::string &filename)
+{
+    std::vector<BatchJob> jobs;
+    YAML::Node manifest;
+
+    try {
+        manifest = YAML::LoadFile(filename);
+    } catch (YAML::Exception &err) {
+        throw IOError("Could not read batch manifest '" + filename + "': " +
+                      err.what());
+    }
+    if (!manifest.IsSequence()) {
+        throw IOError("Batch manifest '" + filename + "' is not a list of jobs");
+    }
+    for (const YAML::Node &node: manifest) {
+        BatchJob job;
+
+        if (!node.IsMap() || !node["input"] || !node["output"]) {
+            throw IOError("Each job in batch manifest '" + filename +
+                          "' must give an input and output");
+        }
+        job.input = node["input"].as<std::string>();
+        if (node["input_r2"]) {
+            job.input_r2 = node["input_r2"].as<std::string>();
+        }
+        job.output = node["output"].as<std::string>();
+        if (node["orphans"]) {
+            job.orphans = node["orphans"].as<std::string>();
+        }
+        if (node["report"]) {
+            job.report = node["report"].as<std::string>();
+        }
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+/////////////////////////////  BatchQCProcessor ///////////////////////////////
+
+static inline void
+process_one(ReadProcessorPipeline &pipeline, Read &the_read)
+{
+    pipeline.process_read(the_read);
+}
+
+static inline void
+process_one(ReadProcessorPipeline &pipeline, ReadPair &the_read_pair)
+{
+    pipeline.process_read_pair(the_read_pair);
+}
+
+template<typename ReadType>
+struct BasicBatchQCProcessor<ReadType>::Job
+{
+    BatchJob                spec;
+    // A ReadParser, or a ReadInterleaver of separate R1 and R2 files
+    std::unique_ptr<ReadInputStream> input;
+    BufferedReadWriter      output;
+    BufferedReadWriter      orphans;
+    bool                    split_orphans;
+    // One per worker thread while the job is active. They are merged and
+    // freed once it finishes, keeping only the report.
+    std::vector<ReadProcessorPipeline> pipelines;
+    std::string             report;
+    // Held while parsing a chunk. input_complete is set under it.
+    std::mutex              input_mutex;
+    std::atomic<bool>       input_complete;
+    std::mutex              output_mutex;
+    // Chunks parsed but not yet written, guarded by the processor's _mutex
+    size_t                  in_flight;
+
+    Job(const BatchJob &job)
+        : spec(job)
+        , split_orphans(job.orphans.size() > 0)
+        , input_complete(false)
+        , in_flight(0)
+    {
+    }
+};
+
+template<typename ReadType>
+BasicBatchQCProcessor<ReadType>::
+BasicBatchQCProcessor(size_t worker_threads)
+    : _policy(new typename DefaultOutputPolicy<ReadType>::type)
+    , _num_threads(worker_threads)
+    , _num_reads(0)
+    , _finishing(0)
+    , _next_job(0)
+    , _max_active(worker_threads + 1)
+    , _failed(false)
+{
+}
+
+template<typename ReadType>
+BasicBatchQCProcessor<ReadType>::
+~BasicBatchQCProcessor()
+{
+}
+
+template<typename ReadType>
+void
+BasicBatchQCProcessor<ReadType>::
+add_job(const BatchJob &job)
+{
+    _jobs.emplace_back(new Job(job));
+}
+
+template<typename ReadType>
+void
+BasicBatchQCProcessor<ReadType>::
+add_jobs(const std::vector<BatchJob> &jobs)
+{
+    for (const BatchJob &job: jobs) {
+        add_job(job);
+    }
+}
+
+template<typename ReadType>
+void
+BasicBatchQCProcessor<ReadType>::
+set_progress_callback(std::function<void(size_t)> func)
+{
+    _progress_cb = func;
+}
+
+template<typename ReadType>
+void
+BasicBatchQCProcessor<ReadType>::
+_set_error(std::exception_ptr error)
+{
+    std_mutex_lock lg(_mutex);
+    if (!_error) {
+        _error = error;
+    }
+    _failed = true;
+    _job_cv.notify_all();
+}
+
+template<typename ReadType>
+void
+BasicBatchQCProcessor<ReadType>::
+_notify_workers()
+{
+    std_mutex_lock lg(_mutex);
+    _job_cv.notify_all();
+}
+
+template<typename ReadType>
+void
+BasicBatchQCProcessor<ReadType>::
+_activate_jobs()
+{
+    while (_active.size() + _finishing < _max_active &&
+           _next_job < _jobs.size()) {
+        Job *job = _jobs[_next_job++].get();
+
+        if (job->spec.input_r2.size() > 0) {
+            if (!std::is_same<ReadType, ReadPair>::value) {
+                throw IOError("Can't read separate R1 and R2 files of '" +
+                              job->spec.input + "' as single-end reads");
+            }
+            ReadInterleaver *interleaver = new ReadInterleaver();
+            job->input.reset(interleaver);
+            interleaver->open(job->spec.input, job->spec.input_r2);
+        } else {
+            ReadParser *parser = new ReadParser();
+            job->input.reset(parser);
+            parser->open(job->spec.input);
+        }
+        job->output.open(job->spec.output);
+        if (job->split_orphans) {
+            job->orphans.open(job->spec.orphans);
+        }
+        for (size_t i = 0; i < _num_threads; i++) {
+            job->pipelines.emplace_back();
+            for (auto &setup: _setup) {
+                setup(job->pipelines.back());
+            }
+        }
+        _active.push_back(job);
+    }
+}
+
+template<typename ReadType>
+typename BasicBatchQCProcessor<ReadType>::Job *
+BasicBatchQCProcessor<ReadType>::
+_take_job(size_t thread_id)
+{
+    const size_t n_active = _active.size();
+
+    for (size_t i = 0; i < n_active; i++) {
+        Job *job = _active[(thread_id + i) % n_active];
+        if (job->input_complete || !job->input_mutex.try_lock()) {
+            continue;
+        }
+        // The input may have finished since we checked
+        if (job->input_complete) {
+            job->input_mutex.unlock();
+            continue;
+        }
+        return job;
+    }
+    return NULL;
+}
+
+template<typename ReadType>
+void
+BasicBatchQCProcessor<ReadType>::
+_finish_job(Job *job)
+{
+    job->input.reset();
+    job->output.close();
+    if (job->split_orphans) {
+        job->orphans.close();
+    }
+    for (size_t i = 1; i < job->pipelines.size(); i++) {
+        job->pipelines[0].add_stats_from(job->pipelines[i]);
+    }
+    job->report = job->pipelines[0].report();
+    job->pipelines.clear();
+
+    if (job->spec.report.size() > 0) {
+        std::ofstream report_file(job->spec.report);
+        report_file << job->report;
+        if (!report_file) {
+            throw IOError("Could not write report '" + job->spec.report + "'");
+        }
+    }
+}
+
+template<typename ReadType>
+void
+BasicBatchQCProcessor<ReadType>::
+worker(BasicBatchQCProcessor *self, size_t thread_id)
+{
+    typedef std::chrono::steady_clock clock;
+    ReadChunk chunk, output;
+    std::vector<Read> orphans;
+
+    while (!self->_failed) {
+        Job *job = NULL;
+        bool draining = false;
+        {
+            std::unique_lock<std::mutex> lock(self->_mutex);
+            try {
+                self->_activate_jobs();
+            } catch (...) {
+                lock.unlock();
+                self->_set_error(std::current_exception());
+                return;
+            }
+            if (self->_active.empty()) {
+                if (self->_finishing == 0 || self->_failed) {
+                    return;
+                }
+                // More jobs may be opened once others have finished
+                self->_job_cv.wait_for(lock, std::chrono::milliseconds(10));
+                continue;
+            }
+            job = self->_take_job(thread_id);
+            if (job == NULL) {
+                // Every active job's input is busy or finished, but chunks
+                // are still in flight. The timeout is only a safeguard.
+                self->_job_cv.wait_for(lock, std::chrono::milliseconds(10));
+                continue;
+            }
+            job->in_flight++;
+            // Every sample is open, so workers may soon run out of work
+            draining = self->_next_job == self->_jobs.size();
+        }
+
+        bool finished = false;
+        try {
+            // Workers parse their own chunks, so time both parsing and
+            // processing
+            clock::time_point start = clock::now();
+            {
+                std_mutex_lock input_lock(job->input_mutex, std::adopt_lock);
+                if (!job->input->parse_chunk(chunk, self->_chunk_sizer.next(draining))) {
+                    job->input_complete = true;
+                }
+            }
+            self->_notify_workers();
+
+            ReadProcessorPipeline &pipeline = job->pipelines[thread_id];
+            for (ReadType &read: chunk) {
+                process_one(pipeline, read);
+            }
+            std::chrono::duration<double> elapsed = clock::now() - start;
+            self->_chunk_sizer.record(elapsed.count(), chunk.size());
+
+            {
+                std_mutex_lock output_lock(job->output_mutex);
+                output.clear();
+                orphans.clear();
+                self->_policy->select(chunk, output, orphans);
+                job->output.write_chunk(output);
+                if (job->split_orphans) {
+                    job->orphans.write_chunk(orphans);
+                } else {
+                    job->output.write_chunk(orphans);
+                }
+            }
+        } catch (...) {
+            self->_set_error(std::current_exception());
+            job->input_complete = true;
+        }
+
+        {
+            std_mutex_lock lock(self->_mutex);
+            job->in_flight--;
+            self->_num_reads += chunk.size();
+            if (job->input_complete && job->in_flight == 0) {
+                auto it = std::find(self->_active.begin(),
+                                    self->_active.end(), job);
+                if (it != self->_active.end()) {
+                    self->_active.erase(it);
+                    self->_finishing++;
+                    finished = true;
+                }
+                // Workers may finish
+                self->_job_cv.notify_all();
+            }
+            if (self->_progress_cb) {
+                self->_progress_cb(self->_num_reads);
+            }
+        }
+        if (finished) {
+            if (!self->_failed) {
+                try {
+                    self->_finish_job(job);
+                } catch (...) {
+                    self->_set_error(std::current_exception());
+                }
+            }
+            std_mutex_lock lock(self->_mutex);
+            self->_finishing--;
+            // A job may be opened in its place
+            self->_job_cv.notify_all();
+        }
+    }
+}
+
+template<typename ReadType>
+size_t
+BasicBatchQCProcessor<ReadType>::
+run()
+{
+    std::vector<std::thread> workers;
+
+    for (size_t i = 0; i < _num_threads; i++) {
+        workers.emplace_back(BasicBatchQCProcessor::worker, this, i);
+    }
+    for (auto &thr: workers) {
+        thr.join();
+    }
+    if (_error) {
+        std::rethrow_exception(_error);
+    }
+    return _num_reads;
+}
+
+template<typename ReadType>
+std::string
+BasicBatchQCProcessor<ReadType>::
+report(size_t job)
+{
+    return _jobs.at(job)->report;
+}
+
+template<typename ReadType>
+size_t
+BasicBatchQCProcessor<ReadType>::
+get_num_jobs()
+{
+    return _jobs.size();
+}
+
+template<typename ReadType>
+size_t
+BasicBatchQCProcessor<ReadType>::
+max_pipelines() const
+{
+    return std::max<size_t>(std::min(_max_active, _jobs.size()), 1) * _num_threads;
+}
+
+template class BasicBatchQCProcessor<Read>;
+template class BasicBatchQCProcessor<ReadPair>;
+
+} // namespace qcpp
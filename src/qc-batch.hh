@@ -0,0 +1,173 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_BATCH_HH
+#define QC_BATCH_HH
+
+#include "qc-config.hh"
+#include "qc-io.hh"
+#include "qc-processor.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+namespace qcpp
+{
+
+// One sample of a batch: reads are processed from input and written to
+// output. If input_r2 is given, input holds the first reads of pairs and
+// input_r2 their mates, which are interleaved by a ReadInterleaver; otherwise
+// input is interleaved. If given, orphaned reads are written to orphans rather
+// than output, and a YAML report of the sample's pipeline is written to
+// report.
+struct BatchJob
+{
+    std::string             input;
+    std::string             input_r2;
+    std::string             output;
+    std::string             orphans;
+    std::string             report;
+};
+
+// Reads a batch manifest: a YAML sequence of maps, each with input and output
+// keys, and optionally input_r2, orphans and report keys, e.g.:
+//
+//   - input: sample1.fastq.gz
+//     output: sample1.trimmed.fastq
+//     report: sample1.yml
+//   - input: sample2_R1.fastq.gz
+//     input_r2: sample2_R2.fastq.gz
+//     output: sample2.trimmed.fastq
+//
+// Relative paths are used as is. Throws IOError if the manifest can't be read
+// or is malformed.
+std::vector<BatchJob> read_batch_manifest(const std::string &filename);
+
+// Processes many samples with one pool of worker threads. Each worker parses,
+// processes and writes whole chunks. Workers prefer different samples, and
+// take chunks from any other sample whose input is free when theirs is busy or
+// finished, so no thread idles while a small file drains, and there is no
+// per-file thread startup.
+//
+// Each sample has its own pipeline per worker, built by append_processor(),
+// whose statistics are merged for the sample's report. Samples are opened a
+// few at a time, so the number of open files doesn't grow with the batch
+// size. Within a sample, chunks may be written out of order.
+template<typename ReadType>
+class BasicBatchQCProcessor
+{
+    typedef std::vector<ReadType> ReadChunk;
+public:
+    BasicBatchQCProcessor           (size_t             worker_threads=1);
+    ~BasicBatchQCProcessor          ();
+
+    void
+    add_job                         (const BatchJob    &job);
+
+    void
+    add_jobs                        (const std::vector<BatchJob> &jobs);
+
+    template<typename ReadProcType, class ...  Args>
+    void
+    append_processor                (Args&&...          args)
+    {
+        _setup.push_back([=](ReadProcessorPipeline &pipeline) {
+            pipeline.append_processor<ReadProcType>(args...);
+        });
+    }
+
+    // Replace the default output policy (PairedOutput or SingleOutput)
+    template<typename PolicyType, class ...  Args>
+    void
+    set_output_policy               (Args&&...          args)
+    {
+        _policy.reset(new PolicyType(args...));
+    }
+
+    // Called with the number of reads (or pairs) processed across all
+    // samples
+    void
+    set_progress_callback           (std::function<void(size_t)> func);
+
+    // Processes all jobs, writing outputs and reports. Returns the total
+    // number of reads (or pairs) processed. Throws the first error from any
+    // sample, after which no further chunks are processed.
+    size_t
+    run                             ();
+
+    // The YAML report of job i's pipeline, once run() has finished
+    std::string
+    report                          (size_t             job);
+
+    size_t
+    get_num_jobs                    ();
+
+    // The most pipelines that exist at once: one per worker thread for each
+    // active job, including jobs whose pipelines are being merged. Finished
+    // jobs keep only their reports. Processors with a memory budget (e.g. KmerSpectrum) should
+    // be given this share of it.
+    size_t
+    max_pipelines                   () const;
+
+    static void worker(BasicBatchQCProcessor *self, size_t thread_id);
+
+protected:
+    struct Job;
+
+    std::vector<std::unique_ptr<Job>> _jobs;
+    std::vector<std::function<void(ReadProcessorPipeline &)>> _setup;
+    std::unique_ptr<OutputPolicy<ReadType>> _policy;
+    std::function<void(size_t)> _progress_cb;
+    size_t                  _num_threads;
+    size_t                  _num_reads;
+    // Guards scheduling: _active, _next_job, and each job's in-flight count
+    std::mutex              _mutex;
+    // Signalled, under _mutex, when an input is freed or a job finishes
+    std::condition_variable _job_cv;
+    std::vector<Job *>      _active;
+    // Jobs no longer active whose pipelines are still being merged. They
+    // count towards _max_active, so max_pipelines() holds throughout.
+    size_t                  _finishing;
+    size_t                  _next_job;
+    size_t                  _max_active;
+    std::exception_ptr      _error;
+    std::atomic<bool>       _failed;
+    ChunkSizer              _chunk_sizer;
+
+    // Opens jobs until _max_active are active. Call with _mutex held.
+    void
+    _activate_jobs                  ();
+
+    // Picks an active job whose input is free, preferring the job at offset
+    // thread_id, and locks its input. Call with _mutex held.
+    Job *
+    _take_job                       (size_t             thread_id);
+
+    // Closes a job's outputs and writes its report
+    void
+    _finish_job                     (Job               *job);
+
+    void
+    _set_error                      (std::exception_ptr error);
+
+    // Wakes workers waiting for a free input
+    void
+    _notify_workers                 ();
+};
+
+typedef BasicBatchQCProcessor<ReadPair> BatchQCProcessor;
+typedef BasicBatchQCProcessor<Read> BatchQCProcessorSE;
+
+} // namespace qcpp
+
+#endif /* QC_BATCH_HH */
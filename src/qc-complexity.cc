@@ -0,0 +1,296 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include <yaml-cpp/yaml.h>
+#include "qc-complexity.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+namespace qcpp
+{
+
+// Fractions of the reads seen at which the complexity curve is reported
+static const double curve_fractions[] = {0.1, 0.25, 0.5, 0.75, 1, 2, 5, 10};
+
+double
+lander_waterman_library_size(double num_reads, double num_distinct)
+{
+    if (num_distinct >= num_reads || num_distinct <= 0) {
+        return 0;
+    }
+
+    // Distinct reads expected from a library of size x, which rises from
+    // below num_distinct at x = num_distinct towards num_reads
+    auto distinct = [num_reads](double x) {
+        return x * -std::expm1(-num_reads / x);
+    };
+    double lower = num_distinct, upper = num_distinct * 2;
+
+    while (distinct(upper) < num_distinct) {
+        lower = upper;
+        upper *= 2;
+    }
+    for (int i = 0; i < 100 && upper - lower > 0.5; i++) {
+        double mid = (lower + upper) / 2;
+        if (distinct(mid) < num_distinct) {
+            lower = mid;
+        } else {
+            upper = mid;
+        }
+    }
+    return (lower + upper) / 2;
+}
+
+/*****************************************************************************
+ *                               HyperLogLog
+ *****************************************************************************/
+
+HyperLogLog::
+HyperLogLog(unsigned precision)
+    : _precision(std::min(std::max(precision, 4u), 24u))
+    , _registers(size_t(1) << _precision, 0)
+{
+}
+
+void
+HyperLogLog::
+merge(const HyperLogLog &other)
+{
+    for (size_t i = 0; i < _registers.size(); i++) {
+        _registers[i] = std::max(_registers[i], other._registers[i]);
+    }
+}
+
+double
+HyperLogLog::
+estimate() const
+{
+    const double m = _registers.size();
+    const double alpha = 0.7213 / (1 + 1.079 / m);
+    double sum = 0;
+    size_t zeros = 0;
+
+    for (uint8_t rank: _registers) {
+        sum += std::ldexp(1.0, -rank);
+        zeros += rank == 0;
+    }
+    double estimate = alpha * m * m / sum;
+    // Linear counting is more accurate for small sets
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / zeros);
+    }
+    return estimate;
+}
+
+/*****************************************************************************
+ *                           ComplexityEstimator
+ *****************************************************************************/
+
+ComplexityEstimator::
+ComplexityEstimator(const std::string &name, unsigned precision,
+                    size_t max_sample, const QualityEncoding &encoding)
+    : ReadProcessor(name, encoding)
+    , _sketch(precision)
+    , _num_sequences(0)
+    , _max_sample(std::max<size_t>(max_sample, 1))
+    , _sample_level(0)
+{
+}
+
+void
+ComplexityEstimator::
+_add(uint64_t hash)
+{
+    _num_sequences++;
+    _sketch.add(hash);
+    if ((hash & ((uint64_t(1) << _sample_level) - 1)) == 0) {
+        _sample[hash]++;
+        while (_sample.size() > _max_sample && _sample_level < 63) {
+            _set_sample_level(_sample_level + 1);
+        }
+    }
+}
+
+void
+ComplexityEstimator::
+_set_sample_level(unsigned level)
+{
+    const uint64_t mask = (uint64_t(1) << level) - 1;
+
+    _sample_level = level;
+    for (auto it = _sample.begin(); it != _sample.end();) {
+        if ((it->first & mask) != 0) {
+            it = _sample.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void
+ComplexityEstimator::
+process_read(Read &the_read)
+{
+    _num_reads++;
+    if (the_read.size() > 0) {
+        _add(hash_bytes(the_read.sequence));
+    }
+}
+
+void
+ComplexityEstimator::
+process_read_pair(ReadPair &the_read_pair)
+{
+    const Read &r1 = the_read_pair.first;
+    const Read &r2 = the_read_pair.second;
+
+    _num_reads += 2;
+    if (r1.size() > 0 || r2.size() > 0) {
+        _add(hash_bytes(r2.sequence, hash_bytes(r1.sequence)));
+    }
+}
+
+void
+ComplexityEstimator::
+add_stats_from(ReadProcessor *other_ptr)
+{
+    ComplexityEstimator &other = *reinterpret_cast<ComplexityEstimator *>(other_ptr);
+
+    _num_reads += other._num_reads;
+    _num_sequences += other._num_sequences;
+    _sketch.merge(other._sketch);
+
+    // Both samples are cut to the sparser one's level before merging. As
+    // hashes are sampled by their value, both hold every copy of the hashes
+    // they share.
+    if (other._sample_level > _sample_level) {
+        _set_sample_level(other._sample_level);
+    }
+    const uint64_t mask = (uint64_t(1) << _sample_level) - 1;
+    for (const auto &entry: other._sample) {
+        if ((entry.first & mask) == 0) {
+            _sample[entry.first] += entry.second;
+        }
+    }
+    while (_sample.size() > _max_sample && _sample_level < 63) {
+        _set_sample_level(_sample_level + 1);
+    }
+}
+
+double
+ComplexityEstimator::
+library_size() const
+{
+    return lander_waterman_library_size(_num_sequences, distinct_sequences());
+}
+
+double
+ComplexityEstimator::
+expected_distinct(double fraction) const
+{
+    const double scale = std::ldexp(1.0, _sample_level);
+    double distinct = 0, sampled = 0;
+
+    if (fraction <= 1) {
+        // Each sampled sequence with k copies is missed by a random subset
+        // with probability (1 - fraction)^k
+        for (const auto &entry: _sample) {
+            distinct += -std::expm1(entry.second * std::log1p(-fraction));
+        }
+        return distinct * scale;
+    }
+    for (const auto &entry: _sample) {
+        sampled += entry.second;
+    }
+    // Beyond the reads seen, fit the sample to the Lander-Waterman model
+    const double size = lander_waterman_library_size(sampled, _sample.size());
+    if (size == 0) {
+        return sampled * fraction * scale;
+    }
+    return size * -std::expm1(-sampled * fraction / size) * scale;
+}
+
+std::string
+ComplexityEstimator::
+yaml_report()
+{
+    std::ostringstream ss;
+    YAML::Emitter yml;
+    const double scale = std::ldexp(1.0, _sample_level);
+    const double distinct = distinct_sequences();
+    const double lib_size = library_size();
+    double dup_rate = 0;
+    std::map<uint32_t, double> histogram;
+
+    if (_num_sequences > 0) {
+        dup_rate = std::max(0.0, 1 - distinct / _num_sequences);
+    }
+    for (const auto &entry: _sample) {
+        histogram[entry.second] += scale;
+    }
+
+    yml << YAML::BeginSeq;
+    yml << YAML::BeginMap;
+    yml << YAML::Key   << "ComplexityEstimator"
+        << YAML::Value
+        << YAML::BeginMap
+        << YAML::Key   << "name"
+        << YAML::Value << _name
+        << YAML::Key   << "parameters"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "quality_encoding"
+                       << YAML::Value << _encoding.name
+                       << YAML::Key << "precision"
+                       << YAML::Value << _sketch.precision()
+                       << YAML::Key << "max_sample"
+                       << YAML::Value << _max_sample
+                       << YAML::EndMap
+        << YAML::Key   << "output"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "num_reads"
+                       << YAML::Value << _num_reads
+                       << YAML::Key << "num_sequences"
+                       << YAML::Value << _num_sequences
+                       << YAML::Key << "distinct_sequences"
+                       << YAML::Value << std::llround(distinct)
+                       << YAML::Key << "duplicate_rate"
+                       << YAML::Value << dup_rate;
+    // Null without duplicates to estimate it from
+    yml << YAML::Key << "library_size" << YAML::Value;
+    if (lib_size > 0) {
+        yml << std::llround(lib_size);
+    } else {
+        yml << YAML::Null;
+    }
+    yml << YAML::Key << "sample_rate"
+        << YAML::Value << 1 / scale
+        << YAML::Key << "copy_number_histogram"
+        << YAML::Value << YAML::Flow << histogram
+        << YAML::Key << "complexity_curve"
+        << YAML::Value << YAML::BeginSeq;
+    for (double fraction: curve_fractions) {
+        yml << YAML::Flow << YAML::BeginMap
+            << YAML::Key << "reads"
+            << YAML::Value << std::llround(fraction * _num_sequences)
+            << YAML::Key << "distinct"
+            << YAML::Value << std::llround(expected_distinct(fraction))
+            << YAML::EndMap;
+    }
+    yml << YAML::EndSeq
+        << YAML::EndMap
+        << YAML::EndMap;
+    yml << YAML::EndMap;
+    yml << YAML::EndSeq;
+    ss << yml.c_str() << "\n";
+    return ss.str();
+}
+
+} // namespace qcpp
@@ -0,0 +1,141 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_COMPLEXITY_HH
+#define QC_COMPLEXITY_HH
+
+#include "qc-config.hh"
+#include "qc-processor.hh"
+#include "qc-quality.hh"
+#include "qc-util.hh"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace qcpp
+{
+
+// Estimates the number of distinct 64-bit hashes added, with a relative
+// standard error of about 1.04 / sqrt(2^precision), in 2^precision bytes.
+class HyperLogLog
+{
+public:
+    explicit
+    HyperLogLog                     (unsigned           precision=14);
+
+    void
+    add                             (uint64_t           hash)
+    {
+        // The top bits choose a register, which keeps the longest run of
+        // leading zeros seen in the rest (plus one)
+        const size_t idx = hash >> (64 - _precision);
+        const uint64_t rest = (hash << _precision) | (uint64_t(1) << (_precision - 1));
+        const uint8_t rank = __builtin_clzll(rest) + 1;
+
+        if (rank > _registers[idx]) {
+            _registers[idx] = rank;
+        }
+    }
+
+    // Adds other's hashes. Both must have the same precision.
+    void
+    merge                           (const HyperLogLog &other);
+
+    double
+    estimate                        () const;
+
+    unsigned
+    precision                       () const
+    {
+        return _precision;
+    }
+
+protected:
+    unsigned                _precision;
+    std::vector<uint8_t>    _registers;
+};
+
+// Estimates the duplication rate and complexity of a library. Each read (or
+// pair) is hashed once, as for DuplicateFilter. The hash is added to a
+// HyperLogLog sketch, which estimates the number of distinct sequences, and
+// the library size is estimated from that with the Lander-Waterman equation.
+// Copies of a sample of the sequences (those whose hashes end in enough zero
+// bits) are also counted exactly, in at most max_sample entries; each time
+// the sample is full, it is halved. These counts give the copy number
+// histogram and the complexity curve: the expected distinct sequences at
+// fractions of the reads seen, and, extrapolated, at more reads.
+class ComplexityEstimator: public ReadProcessor
+{
+public:
+    ComplexityEstimator             (const std::string &name,
+                                     unsigned           precision=14,
+                                     size_t             max_sample=65536,
+                                     const QualityEncoding &encoding=SangerEncoding);
+
+    void
+    process_read                    (Read              &the_read);
+
+    void
+    process_read_pair               (ReadPair          &the_read_pair);
+
+    void
+    add_stats_from                  (ReadProcessor     *other_ptr);
+
+    std::string
+    yaml_report                     ();
+
+    // Reads or pairs seen, and the estimated number of distinct ones
+    size_t
+    num_sequences                   () const
+    {
+        return _num_sequences;
+    }
+
+    double
+    distinct_sequences              () const
+    {
+        return _sketch.estimate();
+    }
+
+    // The estimated number of distinct molecules in the library, or 0 if no
+    // duplicates have been seen, so it can't be estimated
+    double
+    library_size                    () const;
+
+    // The expected number of distinct sequences among fraction * reads seen
+    double
+    expected_distinct               (double             fraction) const;
+
+private:
+    void
+    _add                            (uint64_t           hash);
+
+    // Drops sampled hashes without level trailing zero bits. Each level
+    // halves the sample.
+    void
+    _set_sample_level               (unsigned           level);
+
+    HyperLogLog             _sketch;
+    size_t                  _num_sequences;
+    size_t                  _max_sample;
+    // Copies of each hash whose lowest _sample_level bits are zero
+    std::unordered_map<uint64_t, uint32_t> _sample;
+    unsigned                _sample_level;
+};
+
+// The number of distinct molecules a library would need for num_reads reads
+// to include num_distinct distinct ones, by the Lander-Waterman equation:
+// num_distinct = library_size * (1 - exp(-num_reads / library_size)).
+// Returns 0 if num_distinct >= num_reads, when there's no estimate.
+double lander_waterman_library_size(double num_reads, double num_distinct);
+
+} // namespace qcpp
+
+#endif /* QC_COMPLEXITY_HH */
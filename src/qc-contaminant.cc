@@ -0,0 +1,598 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include <yaml-cpp/yaml.h>
+#include "qc-contaminant.hh"
+#include "qc-io.hh"
+#include "qc-kmer.hh"
+#include "qc-mmap.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace qcpp
+{
+
+static const size_t max_k = 31;
+// Windows are held on the stack, so are limited in size
+static const size_t max_window = 64;
+static const size_t initial_table_size = 1024;
+
+static const char index_magic[8] = {'Q', 'C', 'P', 'P', 'M', 'I', 'D', 'X'};
+// Bumped whenever the file layout, k-mer coding or hashing changes
+static const uint32_t index_version = 1;
+// Reads back as another value on a host of the other byte order
+static const uint32_t index_byte_order = 0x01020304;
+static const size_t index_alignment = 64;
+
+// The start of an index file. It is followed by the reference names, each
+// ending in a NUL, then by the table, from the next multiple of 64 bytes.
+struct IndexHeader
+{
+    char                magic[8];
+    uint32_t            version;
+    uint32_t            byte_order;
+    uint32_t            k;
+    uint32_t            w;
+    uint32_t            num_references;
+    uint32_t            padding;
+    uint64_t            names_size;
+    uint64_t            num_entries;
+    uint64_t            num_minimizers;
+    // Of the header up to here, the names and the table
+    uint64_t            checksum;
+};
+
+static_assert(sizeof(IndexHeader) == 64, "index headers must have no padding");
+
+static size_t
+index_table_offset(const IndexHeader &header)
+{
+    const size_t end = sizeof(IndexHeader) + header.names_size;
+    return (end + index_alignment - 1) / index_alignment * index_alignment;
+}
+
+static uint64_t
+index_checksum(const IndexHeader &header, const char *names, const char *table,
+               size_t table_bytes)
+{
+    uint64_t sum = hash_bytes(reinterpret_cast<const char *>(&header),
+                              offsetof(IndexHeader, checksum));
+    sum = hash_bytes(names, header.names_size, sum);
+    return hash_bytes(table, table_bytes, sum);
+}
+
+/*****************************************************************************
+ *                              MinimizerIndex
+ *****************************************************************************/
+
+MinimizerIndex::
+MinimizerIndex(size_t k, size_t w)
+    : _k(std::min(std::max<size_t>(k, 1), max_k))
+    , _w(std::min(std::max<size_t>(w, 1), max_window))
+    , _size(0)
+    , _table(initial_table_size, Entry{0, 0, 0})
+{
+    _use_table();
+}
+
+template<typename Sequence>
+void
+MinimizerIndex::
+_minimizers(const Sequence &sequence, std::vector<uint64_t> &minimizers) const
+{
+    // The hashes of the last _w k-mers of the current run of k-mers (those
+    // without a break between them), by their index in the run
+    uint64_t window[max_window];
+    size_t run = 0, last_pos = 0, min_idx = 0, emitted = SIZE_MAX;
+    uint64_t min_hash = 0;
+
+    // A run shorter than a window gives the least of its k-mers
+    auto end_run = [&]() {
+        if (run > 0 && run < _w) {
+            minimizers.push_back(min_hash);
+        }
+        run = 0;
+        emitted = SIZE_MAX;
+    };
+
+    minimizers.clear();
+    for_each_canonical_kmer(sequence, _k, [&](uint64_t kmer, size_t pos) {
+        if (run > 0 && pos != last_pos + 1) {
+            end_run();
+        }
+        last_pos = pos;
+
+        const uint64_t hash = hash_int(kmer);
+        const size_t i = run++;
+        window[i % _w] = hash;
+        if (i == 0 || hash < min_hash) {
+            min_hash = hash;
+            min_idx = i;
+        } else if (min_idx + _w <= i) {
+            // The minimum has left the window, so find the next
+            min_idx = i + 1 - _w;
+            min_hash = window[min_idx % _w];
+            for (size_t j = min_idx + 1; j <= i; j++) {
+                if (window[j % _w] < min_hash) {
+                    min_hash = window[j % _w];
+                    min_idx = j;
+                }
+            }
+        }
+        if (i + 1 >= _w && min_idx != emitted) {
+            minimizers.push_back(min_hash);
+            emitted = min_idx;
+        }
+    });
+    end_run();
+}
+
+void
+MinimizerIndex::
+minimizers(const std::string &sequence, std::vector<uint64_t> &minimizers) const
+{
+    _minimizers(sequence, minimizers);
+}
+
+void
+MinimizerIndex::
+minimizers(const PackedSequence &sequence, std::vector<uint64_t> &minimizers) const
+{
+    _minimizers(sequence, minimizers);
+}
+
+void
+MinimizerIndex::
+_use_table()
+{
+    _entries = _table.data();
+    _num_entries = _table.size();
+}
+
+void
+MinimizerIndex::
+_insert(uint64_t hash, uint32_t reference)
+{
+    // A loaded index is copied out of its mapping before it is changed
+    if (_mapping) {
+        _table.assign(_entries, _entries + _num_entries);
+        _mapping.reset();
+        _use_table();
+    }
+    // Keep the table at most half full, so that probes stay short
+    if ((_size + 1) * 2 > _table.size()) {
+        std::vector<Entry> old(_table.size() * 2, Entry{0, 0, 0});
+        old.swap(_table);
+        _use_table();
+        _size = 0;
+        for (const Entry &entry: old) {
+            if (entry.reference != 0) {
+                _insert(entry.hash, entry.reference - 1);
+            }
+        }
+    }
+
+    const size_t mask = _table.size() - 1;
+    size_t i = hash & mask;
+    for (; _table[i].reference != 0; i = (i + 1) & mask) {
+        if (_table[i].hash == hash) {
+            if (_table[i].reference != reference + 1) {
+                _table[i].reference = multiple_references + 1;
+            }
+            return;
+        }
+    }
+    _table[i].hash = hash;
+    _table[i].reference = reference + 1;
+    _size++;
+}
+
+void
+MinimizerIndex::
+add_sequence(const std::string &reference, const std::string &sequence)
+{
+    std::vector<uint64_t> mins;
+    std::string upper(sequence);
+    uint32_t ref = std::find(_references.begin(), _references.end(), reference)
+                   - _references.begin();
+
+    if (ref == _references.size()) {
+        _references.push_back(reference);
+    }
+    // References are often soft-masked in lower case
+    for (char &base: upper) {
+        base &= ~0x20;
+    }
+    minimizers(upper, mins);
+    for (uint64_t hash: mins) {
+        _insert(hash, ref);
+    }
+}
+
+void
+MinimizerIndex::
+add_file(const std::string &reference, const std::string &filename)
+{
+    ReadParser parser;
+    Read read;
+
+    parser.open(filename);
+    while (parser.parse_read(read)) {
+        add_sequence(reference, read.sequence);
+    }
+}
+
+std::shared_ptr<MinimizerIndex>
+MinimizerIndex::
+from_files(const std::vector<std::string> &filenames, size_t k, size_t w)
+{
+    std::shared_ptr<MinimizerIndex> index = std::make_shared<MinimizerIndex>(k, w);
+
+    for (const std::string &filename: filenames) {
+        std::string name = filename.substr(filename.find_last_of('/') + 1);
+        name = name.substr(0, name.find('.'));
+        index->add_file(name, filename);
+    }
+    return index;
+}
+
+// The process's umask, which can only be read by setting it. It's read once,
+// before any threads could be creating files.
+static mode_t
+file_creation_mask()
+{
+    static const mode_t mask = [] {
+        const mode_t old = umask(022);
+        umask(old);
+        return old;
+    }();
+    return mask;
+}
+
+void
+MinimizerIndex::
+save(const std::string &filename) const
+{
+    static_assert(sizeof(Entry) == 16, "index entries must have no padding");
+
+    const char *table = reinterpret_cast<const char *>(_entries);
+    const size_t table_bytes = _num_entries * sizeof(Entry);
+    IndexHeader header;
+    std::string names;
+
+    for (const std::string &name: _references) {
+        names += name;
+        names += '\0';
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, index_magic, sizeof(header.magic));
+    header.version = index_version;
+    header.byte_order = index_byte_order;
+    header.k = _k;
+    header.w = _w;
+    header.num_references = _references.size();
+    header.names_size = names.size();
+    header.num_entries = _num_entries;
+    header.num_minimizers = _size;
+    header.checksum = index_checksum(header, names.data(), table, table_bytes);
+    names.resize(index_table_offset(header) - sizeof(header), '\0');
+
+    // Written aside and renamed into place, so that jobs loading the index
+    // never see part of one. The temporary name is unique, so concurrent
+    // runs writing the same index don't write over each other's.
+    std::string tmp_filename = filename + ".XXXXXX";
+    const int fd = mkstemp(&tmp_filename[0]);
+    if (fd < 0) {
+        throw IOError("Could not write index '" + filename + "'");
+    }
+    // mkstemp() creates the file readable only by us
+    fchmod(fd, 0666 & ~file_creation_mask());
+    FILE *out = fdopen(fd, "wb");
+    if (out == NULL) {
+        close(fd);
+        std::remove(tmp_filename.c_str());
+        throw IOError("Could not write index '" + filename + "'");
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    ok = ok && fwrite(names.data(), 1, names.size(), out) == names.size();
+    ok = ok && fwrite(table, 1, table_bytes, out) == table_bytes;
+    ok = (fclose(out) == 0) && ok;
+    if (!ok || std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp_filename.c_str());
+        throw IOError("Could not write index '" + filename + "'");
+    }
+}
+
+std::shared_ptr<MinimizerIndex>
+MinimizerIndex::
+load(const std::string &filename)
+{
+    // Lookups hit the table at random, so it's read in whole up front
+    std::shared_ptr<const MappedFile> file =
+        std::make_shared<MappedFile>(filename, MappedFile::MapRandom);
+    const char *data = file->data();
+    const size_t size = file->size();
+    IndexHeader header;
+
+    auto invalid = [&filename](const std::string &why) {
+        return IOError("Could not load index '" + filename + "': " + why);
+    };
+
+    if (size < sizeof(header) || memcmp(data, index_magic, sizeof(index_magic)) != 0) {
+        throw invalid("not a minimizer index");
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.byte_order != index_byte_order) {
+        throw invalid("written on a host of another byte order");
+    }
+    if (header.version != index_version) {
+        throw invalid("version " + std::to_string(header.version) + ", not " +
+                      std::to_string(index_version));
+    }
+    if (header.k < 1 || header.k > max_k || header.w < 1 || header.w > max_window ||
+            header.num_entries == 0 ||
+            (header.num_entries & (header.num_entries - 1)) != 0 ||
+            header.num_entries > size / sizeof(Entry) ||
+            header.num_minimizers * 2 > header.num_entries ||
+            header.names_size > size - sizeof(header) ||
+            (header.names_size > 0 && data[sizeof(header) + header.names_size - 1] != '\0') ||
+            size != index_table_offset(header) + header.num_entries * sizeof(Entry)) {
+        throw invalid("truncated or corrupt");
+    }
+
+    const char *names = data + sizeof(header);
+    const char *table = data + index_table_offset(header);
+    if (index_checksum(header, names, table, header.num_entries * sizeof(Entry)) !=
+            header.checksum) {
+        throw invalid("checksum mismatch");
+    }
+
+    std::shared_ptr<MinimizerIndex> index = std::make_shared<MinimizerIndex>(header.k,
+                                                                             header.w);
+    for (const char *name = names; name < names + header.names_size;
+            name += strlen(name) + 1) {
+        index->_references.push_back(name);
+    }
+    if (index->_references.size() != header.num_references) {
+        throw invalid("truncated or corrupt");
+    }
+    index->_size = header.num_minimizers;
+    std::vector<Entry>().swap(index->_table);
+    index->_mapping = file;
+    index->_entries = reinterpret_cast<const Entry *>(table);
+    index->_num_entries = header.num_entries;
+    return index;
+}
+
+/*****************************************************************************
+ *                            ContaminantFilter
+ *****************************************************************************/
+
+ContaminantFilter::
+ContaminantFilter(const std::string &name,
+                  std::shared_ptr<const MinimizerIndex> index,
+                  double min_fraction, bool remove,
+                  const QualityEncoding &encoding)
+    : ReadProcessor(name, encoding)
+    , _index(index)
+    , _min_fraction(min_fraction)
+    , _remove(remove)
+    , _num_checked(0)
+    , _num_contaminated(0)
+    , _num_ambiguous(0)
+    , _reference_counts(index->num_references(), 0)
+    , _hits(index->num_references(), 0)
+{
+}
+
+uint32_t
+ContaminantFilter::
+_screen()
+{
+    uint32_t best = MinimizerIndex::multiple_references;
+    size_t found = 0, best_hits = 0;
+
+    std::fill(_hits.begin(), _hits.end(), 0);
+    for (uint64_t hash: _minimizers) {
+        const uint32_t ref = _index->lookup(hash);
+        if (ref == MinimizerIndex::no_reference) {
+            continue;
+        }
+        found++;
+        if (ref != MinimizerIndex::multiple_references) {
+            _hits[ref]++;
+        }
+    }
+    if (found == 0 || found < _min_fraction * _minimizers.size()) {
+        return MinimizerIndex::no_reference;
+    }
+
+    // Contaminated reads are put down to the reference with the most hits
+    for (uint32_t ref = 0; ref < _hits.size(); ref++) {
+        if (_hits[ref] > best_hits) {
+            best = ref;
+            best_hits = _hits[ref];
+        }
+    }
+    _num_contaminated++;
+    if (best == MinimizerIndex::multiple_references) {
+        _num_ambiguous++;
+    } else {
+        _reference_counts[best]++;
+    }
+    return best;
+}
+
+// The flag added to the names of contaminated reads
+static std::string
+contaminant_flag(const MinimizerIndex &index, uint32_t reference)
+{
+    if (reference == MinimizerIndex::multiple_references) {
+        return " contaminant=ambiguous";
+    }
+    return " contaminant=" + index.reference_name(reference);
+}
+
+void
+ContaminantFilter::
+process_read(Read &the_read)
+{
+    _num_reads++;
+    if (the_read.size() == 0) {
+        return;
+    }
+    _num_checked++;
+    _index->minimizers(the_read.sequence, _minimizers);
+
+    const uint32_t ref = _screen();
+    if (ref == MinimizerIndex::no_reference) {
+        return;
+    }
+    if (_remove) {
+        the_read.erase();
+    } else {
+        the_read.name += contaminant_flag(*_index, ref);
+    }
+}
+
+void
+ContaminantFilter::
+process_read(PackedRead &the_read)
+{
+    _num_reads++;
+    if (the_read.size() == 0) {
+        return;
+    }
+    _num_checked++;
+    _index->minimizers(the_read.sequence, _minimizers);
+
+    const uint32_t ref = _screen();
+    if (ref == MinimizerIndex::no_reference) {
+        return;
+    }
+    if (_remove) {
+        the_read.sequence.clear();
+        the_read.quality.clear();
+    } else {
+        the_read.name += contaminant_flag(*_index, ref);
+    }
+}
+
+void
+ContaminantFilter::
+process_read_pair(ReadPair &the_read_pair)
+{
+    Read &r1 = the_read_pair.first;
+    Read &r2 = the_read_pair.second;
+
+    _num_reads += 2;
+    if (r1.size() == 0 && r2.size() == 0) {
+        return;
+    }
+    _num_checked++;
+    // Pairs are screened as one, on both reads' minimizers
+    _index->minimizers(r1.sequence, _minimizers);
+    _index->minimizers(r2.sequence, _mate_minimizers);
+    _minimizers.insert(_minimizers.end(), _mate_minimizers.begin(),
+                       _mate_minimizers.end());
+
+    const uint32_t ref = _screen();
+    if (ref == MinimizerIndex::no_reference) {
+        return;
+    }
+    if (_remove) {
+        r1.erase();
+        r2.erase();
+    } else {
+        r1.name += contaminant_flag(*_index, ref);
+        r2.name += contaminant_flag(*_index, ref);
+    }
+}
+
+void
+ContaminantFilter::
+add_stats_from(ReadProcessor *other_ptr)
+{
+    ContaminantFilter &other = *reinterpret_cast<ContaminantFilter *>(other_ptr);
+
+    _num_reads += other._num_reads;
+    _num_checked += other._num_checked;
+    _num_contaminated += other._num_contaminated;
+    _num_ambiguous += other._num_ambiguous;
+    for (size_t i = 0; i < _reference_counts.size(); i++) {
+        _reference_counts[i] += other._reference_counts[i];
+    }
+}
+
+std::string
+ContaminantFilter::
+yaml_report()
+{
+    std::ostringstream ss;
+    YAML::Emitter yml;
+    double rate = _num_checked > 0 ? _num_contaminated / double(_num_checked) : 0;
+
+    yml << YAML::BeginSeq;
+    yml << YAML::BeginMap;
+    yml << YAML::Key   << "ContaminantFilter"
+        << YAML::Value
+        << YAML::BeginMap
+        << YAML::Key   << "name"
+        << YAML::Value << _name
+        << YAML::Key   << "parameters"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "quality_encoding"
+                       << YAML::Value << _encoding.name
+                       << YAML::Key << "k"
+                       << YAML::Value << _index->k()
+                       << YAML::Key << "w"
+                       << YAML::Value << _index->w()
+                       << YAML::Key << "min_fraction"
+                       << YAML::Value << _min_fraction
+                       << YAML::Key << "remove"
+                       << YAML::Value << _remove
+                       << YAML::Key << "index_minimizers"
+                       << YAML::Value << _index->size()
+                       << YAML::Key << "index_memory"
+                       << YAML::Value << _index->memory_size()
+                       << YAML::EndMap
+        << YAML::Key   << "output"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "num_reads"
+                       << YAML::Value << _num_reads
+                       << YAML::Key << "num_checked"
+                       << YAML::Value << _num_checked
+                       << YAML::Key << "num_contaminated"
+                       << YAML::Value << _num_contaminated
+                       << YAML::Key << "contaminated_rate"
+                       << YAML::Value << rate
+                       << YAML::Key << "ambiguous"
+                       << YAML::Value << _num_ambiguous
+                       << YAML::Key << "references"
+                       << YAML::Value << YAML::BeginMap;
+    for (uint32_t ref = 0; ref < _reference_counts.size(); ref++) {
+        yml << YAML::Key << _index->reference_name(ref)
+            << YAML::Value << _reference_counts[ref];
+    }
+    yml << YAML::EndMap
+        << YAML::EndMap
+        << YAML::EndMap;
+    yml << YAML::EndMap;
+    yml << YAML::EndSeq;
+    ss << yml.c_str() << "\n";
+    return ss.str();
+}
+
+} // namespace qcpp
@@ -0,0 +1,256 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_CONTAMINANT_HH
+#define QC_CONTAMINANT_HH
+
+#include "qc-config.hh"
+#include "qc-packed.hh"
+#include "qc-processor.hh"
+#include "qc-quality.hh"
+#include "qc-util.hh"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace qcpp
+{
+
+class MappedFile;
+
+// The minimizers of reference sequences, and the reference each came from.
+// A minimizer is the least hash (see hash_int) of the canonical k-mers in
+// each window of w consecutive k-mers; sequences shorter than a window give
+// the minimizer of the k-mers they have. Minimizer hashes are kept in an
+// open-addressing table of 16-byte entries, at most half full. Once built, an
+// index is only read, so one can be shared by every thread's pipeline.
+//
+// An index may be saved to a file and loaded again by memory-mapping it,
+// without parsing or copying the table, so that many processes on a host
+// share one copy of it in the page cache. Index files are only portable
+// between hosts of the same byte order.
+class MinimizerIndex
+{
+public:
+    // Returned by lookup() for minimizers in no reference, and in more than
+    // one
+    static const uint32_t no_reference = 0xFFFFFFFF;
+    static const uint32_t multiple_references = 0xFFFFFFFE;
+
+    explicit
+    MinimizerIndex                  (size_t             k=21,
+                                     size_t             w=11);
+
+    MinimizerIndex                  (const MinimizerIndex &other) = delete;
+    MinimizerIndex &
+    operator=                       (const MinimizerIndex &other) = delete;
+
+    // Adds the minimizers of sequence to reference, which is created if
+    // there's none of that name
+    void
+    add_sequence                    (const std::string &reference,
+                                     const std::string &sequence);
+
+    // Adds every sequence in a FASTA or FASTQ file to reference. Throws
+    // IOError if the file can't be read.
+    void
+    add_file                        (const std::string &reference,
+                                     const std::string &filename);
+
+    // An index of each file, with references named for the files (less
+    // their directories and extensions)
+    static std::shared_ptr<MinimizerIndex>
+    from_files                      (const std::vector<std::string> &filenames,
+                                     size_t             k=21,
+                                     size_t             w=11);
+
+    // Writes the index to filename, replacing any file there only once the
+    // whole index is written. Throws IOError if it can't be written.
+    void
+    save                            (const std::string &filename) const;
+
+    // Maps an index written by save(). Throws IOError if the file isn't an
+    // index, is of another version or byte order, or fails its checksum.
+    static std::shared_ptr<MinimizerIndex>
+    load                            (const std::string &filename);
+
+    // Replaces minimizers with the minimizer hashes of sequence, in order
+    void
+    minimizers                      (const std::string &sequence,
+                                     std::vector<uint64_t> &minimizers) const;
+
+    // As above, taking k-mers straight from the packed words
+    void
+    minimizers                      (const PackedSequence &sequence,
+                                     std::vector<uint64_t> &minimizers) const;
+
+    // The reference holding a minimizer hash, no_reference or
+    // multiple_references
+    uint32_t
+    lookup                          (uint64_t           minimizer) const
+    {
+        const size_t mask = _num_entries - 1;
+
+        for (size_t i = minimizer & mask;; i = (i + 1) & mask) {
+            const Entry &entry = _entries[i];
+            if (entry.reference == 0 || entry.hash == minimizer) {
+                return entry.reference - 1;
+            }
+        }
+    }
+
+    size_t
+    num_references                  () const
+    {
+        return _references.size();
+    }
+
+    const std::string &
+    reference_name                  (uint32_t           reference) const
+    {
+        return _references[reference];
+    }
+
+    // The number of distinct minimizers
+    size_t
+    size                            () const
+    {
+        return _size;
+    }
+
+    size_t
+    memory_size                     () const
+    {
+        return _num_entries * sizeof(Entry);
+    }
+
+    size_t
+    k                               () const
+    {
+        return _k;
+    }
+
+    size_t
+    w                               () const
+    {
+        return _w;
+    }
+
+protected:
+    struct Entry
+    {
+        uint64_t            hash;
+        // The reference plus one, so that zero marks an empty entry
+        uint32_t            reference;
+        // Zero, so that saved tables are reproducible
+        uint32_t            padding;
+    };
+
+    void
+    _insert                         (uint64_t           hash,
+                                     uint32_t           reference);
+
+    // Points lookups at _table, after it has changed
+    void
+    _use_table                      ();
+
+    template<typename Sequence>
+    void
+    _minimizers                     (const Sequence    &sequence,
+                                     std::vector<uint64_t> &minimizers) const;
+
+    size_t                  _k;
+    size_t                  _w;
+    size_t                  _size;
+    // The table, in _table or in _mapping if the index was loaded
+    const Entry            *_entries;
+    size_t                  _num_entries;
+    std::vector<Entry>      _table;
+    std::shared_ptr<const MappedFile> _mapping;
+    std::vector<std::string> _references;
+};
+
+// Screens reads for contamination against a shared MinimizerIndex. A read,
+// or pair, is contaminated if at least min_fraction of its minimizers are in
+// the index, and is put down to the reference with the most of them. If
+// remove is true, contaminated reads are removed; otherwise their names are
+// flagged with " contaminant=REFERENCE". The report counts contaminated reads
+// by reference, with those whose minimizers are all shared by several
+// references as ambiguous.
+class ContaminantFilter: public ReadProcessor
+{
+public:
+    ContaminantFilter               (const std::string &name,
+                                     std::shared_ptr<const MinimizerIndex> index,
+                                     double             min_fraction=0.5,
+                                     bool               remove=true,
+                                     const QualityEncoding &encoding=SangerEncoding);
+
+    void
+    process_read                    (Read              &the_read);
+
+    void
+    process_read_pair               (ReadPair          &the_read_pair);
+
+    // Screens a packed read on the minimizers of its packed words. Removed
+    // reads are left with no sequence or qualities.
+    void
+    process_read                    (PackedRead        &the_read);
+
+    void
+    add_stats_from                  (ReadProcessor     *other_ptr);
+
+    std::string
+    yaml_report                     ();
+
+    // Reads or pairs checked, and those found to be contaminated
+    size_t
+    num_checked                     () const
+    {
+        return _num_checked;
+    }
+
+    size_t
+    num_contaminated                () const
+    {
+        return _num_contaminated;
+    }
+
+    // Contaminated reads or pairs put down to reference
+    size_t
+    num_contaminated_by             (uint32_t           reference) const
+    {
+        return _reference_counts[reference];
+    }
+
+private:
+    // Screens the minimizers in _minimizers, counting a contaminated read.
+    // Returns the reference it is put down to, multiple_references if
+    // ambiguous, or no_reference if not contaminated.
+    uint32_t
+    _screen                         ();
+
+    std::shared_ptr<const MinimizerIndex> _index;
+    double                  _min_fraction;
+    bool                    _remove;
+    size_t                  _num_checked;
+    size_t                  _num_contaminated;
+    size_t                  _num_ambiguous;
+    std::vector<size_t>     _reference_counts;
+    // Per-read scratch space
+    std::vector<uint64_t>   _minimizers;
+    std::vector<uint64_t>   _mate_minimizers;
+    std::vector<size_t>     _hits;
+};
+
+} // namespace qcpp
+
+#endif /* QC_CONTAMINANT_HH */
@@ -0,0 +1,325 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include <yaml-cpp/yaml.h>
+#include "qc-duplicate.hh"
+
+#include <cmath>
+
+namespace qcpp
+{
+
+// Shards are chosen from bits 40 and up of a hash, leaving the low bits,
+// which index tables and filters, independent of the shard
+static const unsigned shard_bit = 40;
+static const size_t max_shards = size_t(1) << 16;
+static const size_t min_shard_budget = 64;
+static const size_t initial_table_size = 1024;
+static const unsigned bloom_hashes = 4;
+
+// The largest power of two <= n, for n > 0
+static size_t
+floor_pow2(size_t n)
+{
+    size_t p = 1;
+    while (p <= n / 2) {
+        p *= 2;
+    }
+    return p;
+}
+
+/*****************************************************************************
+ *                               DuplicateSet
+ *****************************************************************************/
+
+DuplicateSet::
+DuplicateSet(size_t memory_budget, size_t num_shards)
+    : _memory_budget(memory_budget)
+{
+    num_shards = floor_pow2(std::min(std::max<size_t>(num_shards, 1), max_shards));
+    _shard_budget = std::max(memory_budget / num_shards, min_shard_budget);
+    for (size_t i = 0; i < num_shards; i++) {
+        _shards.emplace_back(new Shard);
+        _shards.back()->count = 0;
+    }
+}
+
+bool
+DuplicateSet::
+insert(uint64_t hash)
+{
+    Shard &shard = *_shards[(hash >> shard_bit) & (_shards.size() - 1)];
+    std_mutex_lock lock(shard.mutex);
+
+    if (hash == 0) {
+        hash = 1;
+    }
+    if (shard.bloom.size() > 0) {
+        return _bloom_insert(shard, hash);
+    }
+    return _table_insert(shard, hash);
+}
+
+bool
+DuplicateSet::
+_table_insert(Shard &shard, uint64_t hash)
+{
+    if (shard.table.size() == 0) {
+        shard.table.resize(std::min(initial_table_size,
+                                    floor_pow2(_shard_budget / sizeof(uint64_t))));
+    }
+
+    const size_t mask = shard.table.size() - 1;
+    size_t i = hash & mask;
+
+    for (; shard.table[i] != 0; i = (i + 1) & mask) {
+        if (shard.table[i] == hash) {
+            return true;
+        }
+    }
+    // Keep tables at most 3/4 full, so that probes stay short
+    if ((shard.count + 1) * 4 > shard.table.size() * 3) {
+        _grow(shard);
+        if (shard.bloom.size() > 0) {
+            return _bloom_insert(shard, hash);
+        }
+        return _table_insert(shard, hash);
+    }
+    shard.table[i] = hash;
+    shard.count++;
+    return false;
+}
+
+bool
+DuplicateSet::
+_bloom_insert(Shard &shard, uint64_t hash)
+{
+    const uint64_t mask = shard.bloom.size() * 64 - 1;
+    // Double hashing, with an odd step so that every probe differs. The step
+    // comes from a second mix of the hash, as its high bits are shared by
+    // every hash in the shard.
+    const uint64_t step = hash_int(hash) | 1;
+    bool present = true;
+
+    for (unsigned i = 0; i < bloom_hashes; i++) {
+        const uint64_t bit = (hash + i * step) & mask;
+        uint64_t &word = shard.bloom[bit / 64];
+        const uint64_t flag = uint64_t(1) << (bit % 64);
+
+        present = present && (word & flag);
+        word |= flag;
+    }
+    if (!present) {
+        shard.count++;
+    }
+    return present;
+}
+
+void
+DuplicateSet::
+_grow(Shard &shard)
+{
+    std::vector<uint64_t> old;
+
+    old.swap(shard.table);
+    shard.count = 0;
+    if (old.size() * 2 * sizeof(uint64_t) <= _shard_budget) {
+        shard.table.resize(old.size() * 2);
+        for (uint64_t hash: old) {
+            if (hash != 0) {
+                _table_insert(shard, hash);
+            }
+        }
+        return;
+    }
+    shard.bloom.resize(floor_pow2(_shard_budget / sizeof(uint64_t)));
+    for (uint64_t hash: old) {
+        if (hash != 0) {
+            _bloom_insert(shard, hash);
+        }
+    }
+}
+
+size_t
+DuplicateSet::
+size()
+{
+    size_t count = 0;
+
+    for (auto &shard: _shards) {
+        std_mutex_lock lock(shard->mutex);
+        count += shard->count;
+    }
+    return count;
+}
+
+size_t
+DuplicateSet::
+num_approximate_shards()
+{
+    size_t count = 0;
+
+    for (auto &shard: _shards) {
+        std_mutex_lock lock(shard->mutex);
+        count += shard->bloom.size() > 0;
+    }
+    return count;
+}
+
+double
+DuplicateSet::
+false_positive_rate()
+{
+    double sum = 0;
+    size_t n_shards = 0;
+
+    for (auto &shard: _shards) {
+        std_mutex_lock lock(shard->mutex);
+        if (shard->bloom.size() == 0) {
+            continue;
+        }
+        const double bits = shard->bloom.size() * 64.0;
+        sum += std::pow(1 - std::exp(-double(bloom_hashes * shard->count) / bits),
+                        bloom_hashes);
+        n_shards++;
+    }
+    return n_shards > 0 ? sum / n_shards : 0;
+}
+
+size_t
+DuplicateSet::
+memory_size()
+{
+    size_t bytes = 0;
+
+    for (auto &shard: _shards) {
+        std_mutex_lock lock(shard->mutex);
+        bytes += (shard->table.size() + shard->bloom.size()) * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+/*****************************************************************************
+ *                              DuplicateFilter
+ *****************************************************************************/
+
+DuplicateFilter::
+DuplicateFilter(const std::string &name, size_t memory_budget,
+                const QualityEncoding &encoding)
+    : DuplicateFilter(name, std::make_shared<DuplicateSet>(memory_budget),
+                      encoding)
+{
+}
+
+DuplicateFilter::
+DuplicateFilter(const std::string &name, std::shared_ptr<DuplicateSet> set,
+                const QualityEncoding &encoding)
+    : ReadProcessor(name, encoding)
+    , _set(set)
+    , _num_checked(0)
+    , _num_duplicates(0)
+{
+}
+
+void
+DuplicateFilter::
+process_read(Read &the_read)
+{
+    _num_reads++;
+    if (the_read.size() == 0) {
+        return;
+    }
+    _num_checked++;
+    if (_set->insert(hash_bytes(the_read.sequence))) {
+        the_read.erase();
+        _num_duplicates++;
+    }
+}
+
+void
+DuplicateFilter::
+process_read_pair(ReadPair &the_read_pair)
+{
+    Read &r1 = the_read_pair.first;
+    Read &r2 = the_read_pair.second;
+
+    _num_reads += 2;
+    if (r1.size() == 0 && r2.size() == 0) {
+        return;
+    }
+    _num_checked++;
+    // The length of R1 is part of its hash, so the split between R1 and R2
+    // counts
+    if (_set->insert(hash_bytes(r2.sequence, hash_bytes(r1.sequence)))) {
+        r1.erase();
+        r2.erase();
+        _num_duplicates++;
+    }
+}
+
+void
+DuplicateFilter::
+add_stats_from(ReadProcessor *other_ptr)
+{
+    DuplicateFilter &other = *reinterpret_cast<DuplicateFilter *>(other_ptr);
+
+    _num_reads += other._num_reads;
+    _num_checked += other._num_checked;
+    _num_duplicates += other._num_duplicates;
+}
+
+std::string
+DuplicateFilter::
+yaml_report()
+{
+    std::ostringstream ss;
+    YAML::Emitter yml;
+    double rate = _num_checked > 0 ? _num_duplicates / double(_num_checked) : 0;
+
+    yml << YAML::BeginSeq;
+    yml << YAML::BeginMap;
+    yml << YAML::Key   << "DuplicateFilter"
+        << YAML::Value
+        << YAML::BeginMap
+        << YAML::Key   << "name"
+        << YAML::Value << _name
+        << YAML::Key   << "parameters"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "quality_encoding"
+                       << YAML::Value << _encoding.name
+                       << YAML::Key << "memory_budget"
+                       << YAML::Value << _set->memory_budget()
+                       << YAML::EndMap
+        << YAML::Key   << "output"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "num_reads"
+                       << YAML::Value << _num_reads
+                       << YAML::Key << "num_checked"
+                       << YAML::Value << _num_checked
+                       << YAML::Key << "num_duplicates"
+                       << YAML::Value << _num_duplicates
+                       << YAML::Key << "duplicate_rate"
+                       << YAML::Value << rate
+                       << YAML::Key << "distinct_sequences"
+                       << YAML::Value << _set->size()
+                       << YAML::Key << "approximate_shards"
+                       << YAML::Value << _set->num_approximate_shards()
+                       << YAML::Key << "false_positive_rate"
+                       << YAML::Value << _set->false_positive_rate()
+                       << YAML::Key << "memory_used"
+                       << YAML::Value << _set->memory_size()
+                       << YAML::EndMap
+        << YAML::EndMap;
+    yml << YAML::EndMap;
+    yml << YAML::EndSeq;
+    ss << yml.c_str() << "\n";
+    return ss.str();
+}
+
+} // namespace qcpp
@@ -0,0 +1,134 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_DUPLICATE_HH
+#define QC_DUPLICATE_HH
+
+#include "qc-config.hh"
+#include "qc-processor.hh"
+#include "qc-quality.hh"
+#include "qc-util.hh"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace qcpp
+{
+
+// A set of 64-bit hashes which may be shared between threads, using at most
+// (about) memory_budget bytes. Hashes are split between shards by some of
+// their bits, each shard with its own lock and an open-addressing table which
+// grows to its share of the budget. A shard that would outgrow its share
+// becomes a Bloom filter of that size, so from then on the set may wrongly
+// report hashes in that shard as present. While it is converted, the shard
+// briefly holds both.
+class DuplicateSet
+{
+public:
+    static const size_t     default_memory_budget = size_t(1) << 30;
+
+    explicit
+    DuplicateSet                    (size_t             memory_budget=default_memory_budget,
+                                     size_t             num_shards=64);
+
+    // Adds hash to the set, returning true if it was already present
+    bool
+    insert                          (uint64_t           hash);
+
+    // The number of distinct hashes inserted
+    size_t
+    size                            ();
+
+    // The number of shards which have become Bloom filters
+    size_t
+    num_approximate_shards          ();
+
+    // The mean chance that a new hash in one of the approximate shards is
+    // reported as present, estimated from the number of hashes they hold
+    double
+    false_positive_rate             ();
+
+    // Bytes currently used by the shards' tables and filters
+    size_t
+    memory_size                     ();
+
+    size_t
+    memory_budget                   () const
+    {
+        return _memory_budget;
+    }
+
+protected:
+    struct Shard
+    {
+        std::mutex              mutex;
+        // Empty slots are 0, so hashes of 0 are stored as 1
+        std::vector<uint64_t>   table;
+        size_t                  count;
+        // Bloom filter bits, used instead of table once it is full
+        std::vector<uint64_t>   bloom;
+    };
+
+    bool
+    _table_insert                   (Shard             &shard,
+                                     uint64_t           hash);
+
+    bool
+    _bloom_insert                   (Shard             &shard,
+                                     uint64_t           hash);
+
+    void
+    _grow                           (Shard             &shard);
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+    size_t                  _memory_budget;
+    size_t                  _shard_budget;
+};
+
+// Removes exact duplicate reads, or read pairs whose R1 and R2 sequences both
+// match an earlier pair. Each read (or pair) is hashed into a DuplicateSet.
+// Given only a memory budget, each DuplicateFilter has its own set, so each
+// thread of a ThreadedQCProcessor would only see its own chunks; pass one
+// shared set to append_processor() to filter across the whole input. Once
+// the set is full, some unique reads will be removed as duplicates (see
+// DuplicateSet), as the report shows.
+class DuplicateFilter: public ReadProcessor
+{
+public:
+    DuplicateFilter                 (const std::string &name,
+                                     size_t             memory_budget=DuplicateSet::default_memory_budget,
+                                     const QualityEncoding &encoding=SangerEncoding);
+
+    DuplicateFilter                 (const std::string &name,
+                                     std::shared_ptr<DuplicateSet> set,
+                                     const QualityEncoding &encoding=SangerEncoding);
+
+    void
+    process_read                    (Read              &the_read);
+
+    void
+    process_read_pair               (ReadPair          &the_read_pair);
+
+    void
+    add_stats_from                  (ReadProcessor     *other_ptr);
+
+    std::string
+    yaml_report                     ();
+
+private:
+    std::shared_ptr<DuplicateSet> _set;
+    // Reads or read pairs checked, and those removed
+    size_t                  _num_checked;
+    size_t                  _num_duplicates;
+};
+
+} // namespace qcpp
+
+#endif /* QC_DUPLICATE_HH */
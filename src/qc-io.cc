@@ -9,6 +9,12 @@
 
 #include "qc-io.hh"
 
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
 #include <seqan/sequence.h>
 #include <seqan/seq_io.h>
 #include <seqan/stream.h>
@@ -54,24 +60,33 @@ std::string
 Read::
 str() const
 {
-    std::ostringstream oss;
+    std::string output;
+
+    append_to(output);
+    return output;
+}
 
+void
+Read::
+append_to(std::string &buffer) const
+{
     if (name.size() == 0 || sequence.size() == 0) {
-        return "";
+        return;
     }
     if (quality.size() > 0) {
-        oss << "@";
+        buffer += '@';
     } else {
-        oss << ">";
+        buffer += '>';
     }
-    oss << name << "\n";
-    oss << sequence << "\n";
+    buffer += name;
+    buffer += '\n';
+    buffer += sequence;
+    buffer += '\n';
     if (quality.size() > 0) {
-        oss << "+\n";
-        oss << quality << "\n";
+        buffer += "+\n";
+        buffer += quality;
+        buffer += '\n';
     }
-
-    return oss.str();
 }
 
 void
@@ -115,56 +130,70 @@ ReadPair(const std::string &name1, const std::string &sequence1,
 
 std::string
 ReadPair::
-str()
+str() const
+{
+    std::string output;
+
+    append_to(output);
+    return output;
+}
+
+// Make a fake record of a single N, to avoid breaking pairing.
+static inline void
+append_placeholder(const Read &the_read, bool fastq, std::string &buffer)
+{
+    buffer += fastq ? '@' : '>';
+    buffer += the_read.name;
+    buffer += "\nN\n";
+    if (fastq) {
+        // 'B' is the lowest quality score that is valid in all encodings.
+        // See https://en.wikipedia.org/wiki/FASTQ_format#Encoding
+        buffer += "+\nB\n";
+    }
+}
+
+void
+ReadPair::
+append_to(std::string &buffer) const
 {
-    std::ostringstream oss;
     bool fastq = first.quality.size() > 0 || second.quality.size() > 0;
 
     if (first.name.size() == 0 || second.name.size() == 0 ||
             (first.sequence.size() == 0 && second.quality.size() == 0)) {
-        return "";
+        return;
     }
 
     if (first.sequence.size() == 0) {
-        // Make a fake record of a single N, to avoid breaking pairing.
-        if (fastq) {
-            oss << "@";
-        } else {
-            oss << ">";
-        }
-        oss << first.name << "\n";
-        oss << "N\n";
-        if (fastq) {
-            oss << "+\n";
-            // 'B' is the lowest quality score that is valid in all encodings.
-            // See https://en.wikipedia.org/wiki/FASTQ_format#Encoding
-            oss << "B\n";
-        }
+        append_placeholder(first, fastq, buffer);
     } else {
-        oss << first.str();
+        first.append_to(buffer);
     }
 
     if (second.sequence.size() == 0) {
-        // Make a fake record of a single N, to avoid breaking pairing.
-        if (fastq) {
-            oss << "@";
-        } else {
-            oss << ">";
-        }
-        oss << second.name << "\n";
-        oss << "N\n";
-        if (fastq) {
-            oss << "+\n";
-            // 'B' is the lowest quality score that is valid in all encodings.
-            // See https://en.wikipedia.org/wiki/FASTQ_format#Encoding
-            oss << "B\n";
-        }
+        append_placeholder(second, fastq, buffer);
     } else {
-        oss << second.str();
+        second.append_to(buffer);
     }
+}
 
-    return oss.str();
+bool
+ReadPair::
+fill_placeholders()
+{
+    bool fastq = first.quality.size() > 0 || second.quality.size() > 0;
 
+    // Keep in sync with append_to()
+    if (first.name.size() == 0 || second.name.size() == 0 ||
+            (first.sequence.size() == 0 && second.quality.size() == 0)) {
+        return false;
+    }
+    for (Read *the_read: {&first, &second}) {
+        if (the_read->sequence.size() == 0) {
+            the_read->sequence = "N";
+            the_read->quality = fastq ? "B" : "";
+        }
+    }
+    return true;
 }
 
 bool
@@ -173,12 +202,29 @@ operator==(const ReadPair &r1, const ReadPair &r2)
     return r1.first == r2.first && r1.second == r2.second;
 }
 
+std::string
+read_pair_name(const std::string &name)
+{
+    size_t len = name.find_first_of(" \t");
+    if (len == std::string::npos) {
+        len = name.size();
+    }
+    if (len >= 2 && name[len - 2] == '/' &&
+            (name[len - 1] == '1' || name[len - 1] == '2')) {
+        len -= 2;
+    }
+    return name.substr(0, len);
+}
+
 /*****************************************************************************
  *                               SeqAn Wrapper
  *****************************************************************************/
 
 struct SeqAnReadWrapper
 {
+    // Must outlive stream, so are declared first
+    std::unique_ptr<AsyncInputBuf> async_buf;
+    std::unique_ptr<std::istream> async_stream;
     seqan::SeqFileIn stream;
     //std::mutex _mutex;
 
@@ -199,6 +245,21 @@ struct SeqAnReadWrapper
             throw IOError(message);
         }
     }
+
+    void open_async(const char *filename, const AsyncIOOptions &aio)
+    {
+        async_buf.reset(new AsyncInputBuf(filename, aio));
+        async_stream.reset(new std::istream(async_buf.get()));
+        if (!seqan::open(stream, *async_stream)) {
+            std::string message = "Could not open '";
+            message = message + filename + "' for reading.";
+            throw IOError(message);
+        } else if (seqan::atEnd(stream)) {
+            std::string message = "File '";
+            message = message + filename + "' does not contain any sequences!";
+            throw IOError(message);
+        }
+    }
 };
 
 struct SeqAnWriteWrapper
@@ -293,6 +354,49 @@ ReadInputStream(const ReadInputStream &other)
     _at_end = other._at_end;
 }
 
+bool
+ReadInputStream::
+parse_chunk(std::vector<Read> &chunk, size_t max_reads)
+{
+    for (size_t i = 0; i < max_reads; i++) {
+        if (i == chunk.size()) {
+            chunk.emplace_back();
+        }
+        if (!parse_read(chunk[i])) {
+            chunk.resize(i);
+            return false;
+        }
+    }
+    chunk.resize(max_reads);
+    return true;
+}
+
+bool
+ReadInputStream::
+parse_chunk(std::vector<ReadPair> &chunk, size_t max_pairs)
+{
+    for (size_t i = 0; i < max_pairs; i++) {
+        if (i == chunk.size()) {
+            chunk.emplace_back();
+        }
+        if (!parse_read_pair(chunk[i])) {
+            chunk.resize(i);
+            return false;
+        }
+    }
+    chunk.resize(max_pairs);
+    return true;
+}
+
+void
+ReadParser::
+open(const std::string &filename, const AsyncIOOptions &aio)
+{
+    delete _private;
+    _private = new SeqAnReadWrapper();
+    _private->open_async(filename.c_str(), aio);
+}
+
 bool
 ReadParser::
 parse_read(Read &the_read)
@@ -353,16 +457,32 @@ parse_read_pair(ReadPair &the_read_pair)
     return true;
 }
 
+// Reads per chunk, and chunks queued ahead of the consumer, for each of R1
+// and R2
+static const size_t interleaver_chunksize = 4096;
+static const size_t interleaver_queue_depth = 4;
+
 ReadInterleaver::
 ReadInterleaver()
+    : _num_pairs(0)
+    , _check_names(false)
+    , _started(false)
+    , _stop(false)
 {
-    _num_pairs = 0;
+    _pos[0] = _pos[1] = 0;
+}
+
+ReadInterleaver::
+~ReadInterleaver()
+{
+    _stop_producers();
 }
 
 void
 ReadInterleaver::
 open(const char *r1_filename, const char *r2_filename)
 {
+    _stop_producers();
     r1_parser.open(r1_filename);
     r2_parser.open(r2_filename);
 }
@@ -371,23 +491,186 @@ void
 ReadInterleaver::
 open(const std::string &r1_filename, const std::string &r2_filename)
 {
-    r1_parser.open(r1_filename);
-    r2_parser.open(r2_filename);
+    open(r1_filename.c_str(), r2_filename.c_str());
+}
+
+void
+ReadInterleaver::
+set_check_pair_names(bool check)
+{
+    _check_names = check;
+}
+
+void
+ReadInterleaver::
+_produce(ReadInterleaver *self, ReadParser *parser, ChunkQueue *queue)
+{
+    bool last = false;
+    while (!last) {
+        Chunk chunk;
+        chunk.last = false;
+        chunk.reads.reserve(interleaver_chunksize);
+        try {
+            Read read;
+            while (chunk.reads.size() < interleaver_chunksize) {
+                if (!parser->parse_read(read)) {
+                    chunk.last = true;
+                    break;
+                }
+                chunk.reads.push_back(read);
+            }
+        } catch (...) {
+            chunk.error = std::current_exception();
+            chunk.last = true;
+        }
+        last = chunk.last;
+
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        queue->cv.wait(lock, [self, queue]{
+            return self->_stop ||
+                   queue->chunks.size() < interleaver_queue_depth;
+        });
+        if (self->_stop) {
+            return;
+        }
+        queue->chunks.push_back(std::move(chunk));
+        lock.unlock();
+        queue->cv.notify_all();
+    }
+}
+
+void
+ReadInterleaver::
+_stop_producers()
+{
+    if (!_started) {
+        return;
+    }
+    for (ChunkQueue &queue: _queues) {
+        std::lock_guard<std::mutex> lg(queue.mutex);
+        _stop = true;
+    }
+    for (size_t i = 0; i < 2; i++) {
+        _queues[i].cv.notify_all();
+        _producers[i].join();
+        _queues[i].chunks.clear();
+        _current[i] = Chunk();
+    }
+    _stop = false;
+    _started = false;
+    _pos[0] = _pos[1] = 0;
+}
+
+bool
+ReadInterleaver::
+_next_chunk(size_t which)
+{
+    ChunkQueue &queue = _queues[which];
+    Chunk &current = _current[which];
+
+    if (current.last) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.cv.wait(lock, [&queue]{ return !queue.chunks.empty(); });
+    current = std::move(queue.chunks.front());
+    queue.chunks.pop_front();
+    _pos[which] = 0;
+    lock.unlock();
+    queue.cv.notify_all();
+
+    if (current.error) {
+        std::rethrow_exception(current.error);
+    }
+    return true;
+}
+
+bool
+ReadInterleaver::
+_fill()
+{
+    if (!_started) {
+        _current[0] = Chunk();
+        _current[1] = Chunk();
+        _producers[0] = std::thread(_produce, this, &r1_parser, &_queues[0]);
+        _producers[1] = std::thread(_produce, this, &r2_parser, &_queues[1]);
+        _started = true;
+    }
+
+    bool have_read[2];
+    for (size_t i = 0; i < 2; i++) {
+        have_read[i] = true;
+        while (have_read[i] && _pos[i] >= _current[i].reads.size()) {
+            have_read[i] = _next_chunk(i);
+        }
+    }
+    if (!have_read[0] && !have_read[1]) {
+        _at_end = true;
+        return false;
+    }
+    if (!have_read[0] || !have_read[1]) {
+        throw IOError("R1 and R2 files contain different numbers of reads");
+    }
+    return true;
+}
+
+static inline void
+check_pair_names(const ReadPair &the_read_pair)
+{
+    if (read_pair_name(the_read_pair.first.name) !=
+            read_pair_name(the_read_pair.second.name)) {
+        throw IOError("Mismatched read names in R1 and R2: '" +
+                      the_read_pair.first.name + "' and '" +
+                      the_read_pair.second.name + "'");
+    }
 }
 
 bool
 ReadInterleaver::
 parse_read_pair(ReadPair &the_read_pair)
 {
-    bool first = r1_parser.parse_read(the_read_pair.first);
-    bool second = r2_parser.parse_read(the_read_pair.second);
-    if (first && second) {
-        _num_pairs++;
-        return true;
+    if (!_fill()) {
+        the_read_pair.first.clear();
+        the_read_pair.second.clear();
+        return false;
     }
-    the_read_pair.first.clear();
-    the_read_pair.second.clear();
-    return false;
+    std::swap(the_read_pair.first, _current[0].reads[_pos[0]++]);
+    std::swap(the_read_pair.second, _current[1].reads[_pos[1]++]);
+    if (_check_names) {
+        check_pair_names(the_read_pair);
+    }
+    _num_pairs++;
+    return true;
+}
+
+bool
+ReadInterleaver::
+parse_chunk(std::vector<ReadPair> &chunk, size_t max_pairs)
+{
+    size_t n_pairs = 0;
+    while (n_pairs < max_pairs) {
+        if (!_fill()) {
+            chunk.resize(n_pairs);
+            return false;
+        }
+        size_t n = std::min(max_pairs - n_pairs,
+                            std::min(_current[0].reads.size() - _pos[0],
+                                     _current[1].reads.size() - _pos[1]));
+        for (size_t i = 0; i < n; i++) {
+            if (n_pairs == chunk.size()) {
+                chunk.emplace_back();
+            }
+            ReadPair &the_read_pair = chunk[n_pairs++];
+            std::swap(the_read_pair.first, _current[0].reads[_pos[0]++]);
+            std::swap(the_read_pair.second, _current[1].reads[_pos[1]++]);
+            if (_check_names) {
+                check_pair_names(the_read_pair);
+            }
+        }
+        _num_pairs += n;
+    }
+    chunk.resize(max_pairs);
+    return true;
 }
 
 size_t
@@ -420,6 +703,24 @@ ReadOutputStream(const ReadOutputStream &other)
     std::ignore = other;
 }
 
+void
+ReadOutputStream::
+write_chunk(std::vector<Read> &chunk)
+{
+    for (Read &the_read: chunk) {
+        write_read(the_read);
+    }
+}
+
+void
+ReadOutputStream::
+write_chunk(std::vector<ReadPair> &chunk)
+{
+    for (ReadPair &the_read_pair: chunk) {
+        write_read_pair(the_read_pair);
+    }
+}
+
 void
 ReadWriter::
 close()
@@ -462,6 +763,282 @@ write_read_pair(ReadPair &the_read_pair)
     write_read(the_read_pair.second);
 }
 
+BufferedReadWriter::
+BufferedReadWriter(size_t buffer_size)
+    : _buffer_size(buffer_size)
+    , _fd(-1)
+    , _own_fd(false)
+    , _num_reads(0)
+{
+    // Leave headroom so appending a record rarely reallocates.
+    _buffer.reserve(_buffer_size + (_buffer_size >> 4));
+}
+
+BufferedReadWriter::
+~BufferedReadWriter()
+{
+    // Errors can't be reported from here; call close() to check for them
+    try {
+        close();
+    } catch (IOError &) {
+    }
+}
+
+void
+BufferedReadWriter::
+open(const char *filename)
+{
+    close();
+    _fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (_fd < 0) {
+        std::string message = "Could not open '";
+        message = message + filename + "' for writing: " + strerror(errno);
+        throw IOError(message);
+    }
+    _own_fd = true;
+}
+
+void
+BufferedReadWriter::
+open(const std::string &filename)
+{
+    open(filename.c_str());
+}
+
+void
+BufferedReadWriter::
+open(int fd)
+{
+    close();
+    _fd = fd;
+    _own_fd = false;
+}
+
+void
+BufferedReadWriter::
+open(const std::string &filename, const AsyncIOOptions &aio)
+{
+    close();
+    _async.reset(new AsyncOutputBuf(filename, aio));
+}
+
+void
+BufferedReadWriter::
+write_read(Read &the_read)
+{
+    the_read.append_to(_buffer);
+    _num_reads++;
+    _maybe_flush();
+}
+
+void
+BufferedReadWriter::
+write_read_pair(ReadPair &the_read_pair)
+{
+    the_read_pair.append_to(_buffer);
+    _num_reads += 2;
+    _maybe_flush();
+}
+
+void
+BufferedReadWriter::
+write_chunk(std::vector<Read> &chunk)
+{
+    for (const Read &the_read: chunk) {
+        the_read.append_to(_buffer);
+        _maybe_flush();
+    }
+    _num_reads += chunk.size();
+}
+
+void
+BufferedReadWriter::
+write_chunk(std::vector<ReadPair> &chunk)
+{
+    for (const ReadPair &the_read_pair: chunk) {
+        the_read_pair.append_to(_buffer);
+        _maybe_flush();
+    }
+    _num_reads += 2 * chunk.size();
+}
+
+void
+BufferedReadWriter::
+write(const std::string &records)
+{
+    if (_buffer.size() + records.size() < _buffer_size) {
+        _buffer += records;
+        return;
+    }
+    // Large writes go straight to the fd along with anything buffered, rather
+    // than being copied into the buffer first.
+    _writev(_buffer.data(), _buffer.size(), records.data(), records.size());
+    _buffer.clear();
+}
+
+void
+BufferedReadWriter::
+flush()
+{
+    if (_buffer.size() > 0) {
+        _writev(_buffer.data(), _buffer.size(), NULL, 0);
+        _buffer.clear();
+    }
+}
+
+void
+BufferedReadWriter::
+close()
+{
+    if (_async) {
+        flush();
+        // Reset before closing, so a failed close isn't retried
+        std::unique_ptr<AsyncOutputBuf> async(std::move(_async));
+        async->close();
+        return;
+    }
+    if (_fd < 0) {
+        return;
+    }
+    flush();
+    if (_own_fd && ::close(_fd) != 0) {
+        _fd = -1;
+        throw IOError(std::string("Error closing output: ") + strerror(errno));
+    }
+    _fd = -1;
+}
+
+size_t
+BufferedReadWriter::
+get_num_reads()
+{
+    return _num_reads;
+}
+
+void
+BufferedReadWriter::
+_maybe_flush()
+{
+    if (_buffer.size() >= _buffer_size) {
+        flush();
+    }
+}
+
+void
+BufferedReadWriter::
+_writev(const char *data1, size_t len1, const char *data2, size_t len2)
+{
+    struct iovec iov[2];
+    int iovcnt = 0;
+
+    if (_async) {
+        if ((size_t)_async->sputn(data1, len1) != len1 ||
+                (size_t)_async->sputn(data2, len2) != len2) {
+            // The error itself is reported by close()
+            throw IOError("Error writing output");
+        }
+        return;
+    }
+    if (_fd < 0) {
+        throw IOError("BufferedReadWriter: output is not open");
+    }
+    if (len1 > 0) {
+        iov[iovcnt].iov_base = const_cast<char *>(data1);
+        iov[iovcnt++].iov_len = len1;
+    }
+    if (len2 > 0) {
+        iov[iovcnt].iov_base = const_cast<char *>(data2);
+        iov[iovcnt++].iov_len = len2;
+    }
+
+    struct iovec *cur = iov;
+    while (iovcnt > 0) {
+        ssize_t written = ::writev(_fd, cur, iovcnt);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw IOError(std::string("Error writing output: ") + strerror(errno));
+        }
+        // Skip past whatever was written, which may be a partial iovec
+        size_t remaining = written;
+        while (iovcnt > 0 && remaining >= cur->iov_len) {
+            remaining -= cur->iov_len;
+            cur++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            cur->iov_base = static_cast<char *>(cur->iov_base) + remaining;
+            cur->iov_len -= remaining;
+        }
+    }
+}
+
+StreamReadWriter::
+StreamReadWriter(std::ostream *output)
+    : _output(output)
+    , _num_reads(0)
+{
+}
+
+void
+StreamReadWriter::
+_write_buffer()
+{
+    _output->write(_buffer.data(), _buffer.size());
+    _buffer.clear();
+    if (!*_output) {
+        throw IOError("Error writing output stream");
+    }
+}
+
+void
+StreamReadWriter::
+write_read(Read &the_read)
+{
+    the_read.append_to(_buffer);
+    _num_reads++;
+    _write_buffer();
+}
+
+void
+StreamReadWriter::
+write_read_pair(ReadPair &the_read_pair)
+{
+    the_read_pair.append_to(_buffer);
+    _num_reads += 2;
+    _write_buffer();
+}
+
+void
+StreamReadWriter::
+write_chunk(std::vector<Read> &chunk)
+{
+    for (const Read &the_read: chunk) {
+        the_read.append_to(_buffer);
+    }
+    _num_reads += chunk.size();
+    _write_buffer();
+}
+
+void
+StreamReadWriter::
+write_chunk(std::vector<ReadPair> &chunk)
+{
+    for (const ReadPair &the_read_pair: chunk) {
+        the_read_pair.append_to(_buffer);
+    }
+    _num_reads += 2 * chunk.size();
+    _write_buffer();
+}
+
+size_t
+StreamReadWriter::
+get_num_reads()
+{
+    return _num_reads;
+}
+
 ReadDeInterleaver::
 ReadDeInterleaver()
 {
@@ -11,9 +11,14 @@
 #define QC_IO_HH
 
 #include "qc-config.hh"
+#include "qc-aio.hh"
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <mutex>
+#include <thread>
 #include <tuple>
 
 namespace qcpp
@@ -51,6 +56,11 @@ public:
     std::string
     str                         () const;
 
+    // Appends this read as a FASTQ (or FASTA, if there are no qualities)
+    // record to buffer. Empty reads append nothing.
+    void
+    append_to                   (std::string       &buffer) const;
+
     void
     erase                       (size_t             pos=0);
     void
@@ -72,12 +82,27 @@ public:
                                  const std::string &sequence2,
                                  const std::string &quality2);
     std::string
-    str                         ();
+    str                         () const;
+
+    // Appends both reads to buffer, substituting a placeholder record of a
+    // single N for a read that has been removed, to keep pairing intact.
+    void
+    append_to                   (std::string       &buffer) const;
+
+    // Replaces any removed read with the placeholder record append_to()
+    // writes for it, so that the pair can be written by any
+    // ReadOutputStream. Returns false if append_to() would write nothing.
+    bool
+    fill_placeholders           ();
 
     Read                first;
     Read                second;
 };
 
+// Returns the name shared by both reads of a pair: the read name up to any
+// whitespace, without a /1 or /2 suffix.
+std::string read_pair_name(const std::string &name);
+
 
 // Declare wrappers from the source. We keep these in obfuscated structs to
 // avoid having to install the SeqAn headers, or compile them in every source
@@ -115,6 +140,8 @@ class ReadInputStream
 public:
     ReadInputStream             ();
     ReadInputStream             (const ReadInputStream &other);
+    virtual
+    ~ReadInputStream            () {}
 
     virtual bool
     parse_read                  (Read              &the_read) = 0;
@@ -122,6 +149,19 @@ public:
     virtual bool
     parse_read_pair             (ReadPair          &the_read_pair) = 0;
 
+    // Replace the contents of chunk with up to max_reads reads (or pairs).
+    // Reads already in chunk are parsed over in place, reusing their memory,
+    // and any not needed are removed. Returns false once the end of the input
+    // has been reached, though chunk may still hold the final reads. Streams
+    // may override these to fill chunks without a call per read.
+    virtual bool
+    parse_chunk                 (std::vector<Read> &chunk,
+                                 size_t             max_reads);
+
+    virtual bool
+    parse_chunk                 (std::vector<ReadPair> &chunk,
+                                 size_t             max_pairs);
+
     bool
     at_end                      ();
 
@@ -134,6 +174,14 @@ protected:
 class ReadParser: public ReadInputStream, public ReadIO<SeqAnReadWrapper>
 {
 public:
+    using ReadIO<SeqAnReadWrapper>::open;
+
+    // Parse from a file read ahead asynchronously (see AsyncInputBuf). The
+    // format and compression are detected from the file contents.
+    void
+    open                        (const std::string &filename,
+                                 const AsyncIOOptions &aio);
+
     bool
     parse_read                  (Read              &the_read);
 
@@ -147,11 +195,22 @@ class ReadOutputStream
 public:
     ReadOutputStream            ();
     ReadOutputStream            (const ReadOutputStream &other);
-    void
-    write_read                  (Read              &the_read);
+    virtual
+    ~ReadOutputStream           () {}
 
-    void
-    write_read_pair             (ReadPair          &the_read_pair);
+    virtual void
+    write_read                  (Read              &the_read) = 0;
+
+    virtual void
+    write_read_pair             (ReadPair          &the_read_pair) = 0;
+
+    // Write each read (or pair) in chunk. Streams may override these to
+    // write chunks without a call per read.
+    virtual void
+    write_chunk                 (std::vector<Read> &chunk);
+
+    virtual void
+    write_chunk                 (std::vector<ReadPair> &chunk);
 
 protected:
     // Locks paired IO to ensure proper pairing
@@ -172,11 +231,121 @@ public:
 
 };
 
+// Writes reads to a file descriptor through a large reusable buffer, which is
+// flushed with write(2)/writev(2) in blocks of buffer_size bytes. Records are
+// serialised with Read::append_to(), so output is identical to Read::str().
+class BufferedReadWriter: public ReadOutputStream
+{
+public:
+    BufferedReadWriter          (size_t             buffer_size=1<<22);
+    ~BufferedReadWriter         ();
+
+    void
+    open                        (const char        *filename);
+
+    void
+    open                        (const std::string &filename);
+
+    // Write to an already open file descriptor, which is not closed by
+    // close()
+    void
+    open                        (int                fd);
+
+    // Write behind asynchronously, with up to aio.num_buffers writes in
+    // flight (see AsyncOutputBuf)
+    void
+    open                        (const std::string &filename,
+                                 const AsyncIOOptions &aio);
+
+    void
+    write_read                  (Read              &the_read);
+
+    void
+    write_read_pair             (ReadPair          &the_read_pair);
+
+    void
+    write_chunk                 (std::vector<Read> &chunk);
+
+    void
+    write_chunk                 (std::vector<ReadPair> &chunk);
+
+    // Write preformatted records, e.g. from an OutputPolicy
+    void
+    write                       (const std::string &records);
+
+    void
+    flush                       ();
+
+    // Flushes and closes the output, throwing IOError if any write failed.
+    // The destructor also closes it, but can't report errors.
+    void
+    close                       ();
+
+    size_t
+    get_num_reads               ();
+
+protected:
+    std::string             _buffer;
+    size_t                  _buffer_size;
+    std::unique_ptr<AsyncOutputBuf> _async;
+    int                     _fd;
+    bool                    _own_fd;
+    size_t                  _num_reads;
+
+    void
+    _maybe_flush                ();
+
+    void
+    _writev                     (const char        *data1,
+                                 size_t             len1,
+                                 const char        *data2,
+                                 size_t             len2);
+};
+
+// Writes reads to a std::ostream, serialising each chunk into a reusable
+// buffer that is written with a single ostream::write(). The stream is not
+// owned. Throws IOError once the stream has failed.
+class StreamReadWriter: public ReadOutputStream
+{
+public:
+    StreamReadWriter            (std::ostream      *output);
+
+    void
+    write_read                  (Read              &the_read);
+
+    void
+    write_read_pair             (ReadPair          &the_read_pair);
+
+    void
+    write_chunk                 (std::vector<Read> &chunk);
+
+    void
+    write_chunk                 (std::vector<ReadPair> &chunk);
+
+    size_t
+    get_num_reads               ();
+
+protected:
+    std::ostream           *_output;
+    std::string             _buffer;
+    size_t                  _num_reads;
+
+    void
+    _write_buffer               ();
+};
+
+// Interleaves reads from separate R1 and R2 files. Each file is parsed (and
+// decompressed) on its own producer thread, which fills chunks of reads ahead
+// of the consumer. The files must have the same number of reads; otherwise,
+// parse_read_pair() throws IOError. Mates are paired by position, not by name
+// (names such as frag_R1 and frag_R2 differ), unless set_check_pair_names() is
+// used.
 class ReadInterleaver : public ReadInputStream
 {
 
 public:
     ReadInterleaver             ();
+    ~ReadInterleaver            ();
 
     void
     open                        (const char        *r1_filename,
@@ -188,6 +357,18 @@ public:
     bool
     parse_read_pair             (ReadPair          &the_read_pair);
 
+    using ReadInputStream::parse_chunk;
+
+    // Hands over reads from the producers' chunks without copying
+    bool
+    parse_chunk                 (std::vector<ReadPair> &chunk,
+                                 size_t             max_pairs);
+
+    // If check, throw IOError from parsing when mates don't have the same
+    // read_pair_name(). Off by default.
+    void
+    set_check_pair_names        (bool               check);
+
     size_t
     get_num_reads               ();
 
@@ -195,10 +376,54 @@ public:
     get_num_pairs               ();
 
 private:
+    struct Chunk
+    {
+        std::vector<Read>   reads;
+        // Set on the final chunk from a file
+        bool                last;
+        std::exception_ptr  error;
+
+        Chunk() : last(false) {}
+    };
+
+    // A bounded queue of chunks from one producer thread
+    struct ChunkQueue
+    {
+        std::mutex              mutex;
+        std::condition_variable cv;
+        std::deque<Chunk>       chunks;
+    };
+
     ReadParser          r1_parser;
     ReadParser          r2_parser;
     size_t              _num_pairs;
     std::mutex          _mutex;
+    bool                _check_names;
+    bool                _started;
+    std::atomic<bool>   _stop;
+    ChunkQueue          _queues[2];
+    Chunk               _current[2];
+    // Index of the next read in each current chunk
+    size_t              _pos[2];
+    std::thread         _producers[2];
+
+    static void
+    _produce                    (ReadInterleaver   *self,
+                                 ReadParser        *parser,
+                                 ChunkQueue        *queue);
+
+    // Makes the next chunk from queue current. Returns false at the end of
+    // the file.
+    bool
+    _next_chunk                 (size_t             which);
+
+    // Makes reads available in both current chunks. Returns false at the end
+    // of both files.
+    bool
+    _fill                       ();
+
+    void
+    _stop_producers             ();
 
     bool
     parse_read                  (Read              &the_read)
@@ -0,0 +1,426 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include <yaml-cpp/yaml.h>
+#include "qc-kmer.hh"
+
+#include <algorithm>
+#include <limits>
+
+namespace qcpp
+{
+
+static_assert(sizeof(uint64_t) * 5 + sizeof(uint32_t) * 5 <= 64,
+              "k-mer buckets must fit in a cache line");
+
+// Partitions are chosen from the top 8 bits of a hash, buckets from bits 24
+// and up, and samples from the lowest bits, so that each is independent
+static const size_t max_partitions = 256;
+static const unsigned bucket_bit = 24;
+static const unsigned max_sample_level = bucket_bit;
+static const size_t initial_buckets = 64;
+// How many k-mers ahead buckets are prefetched
+static const size_t prefetch_distance = 8;
+// At most 4 of each 5 slots are filled, so that probes stay short
+static const size_t max_per_bucket = 4;
+
+static const size_t max_k = 31;
+
+// The largest power of two <= n, for n > 0
+static size_t
+floor_pow2(size_t n)
+{
+    size_t p = 1;
+    while (p <= n / 2) {
+        p *= 2;
+    }
+    return p;
+}
+
+uint64_t
+canonical_kmer(const std::string &sequence, size_t k)
+{
+    uint64_t fw = 0, rc = 0;
+
+    k = std::min(k, sequence.size());
+    for (size_t i = 0; i < k; i++) {
+        const uint64_t code = kmer_base_code(sequence[i]);
+        fw = (fw << 2) | code;
+        rc |= (code ^ 2) << (2 * i);
+    }
+    return std::min(fw, rc);
+}
+
+/*****************************************************************************
+ *                               KmerCounter
+ *****************************************************************************/
+
+KmerCounter::
+KmerCounter(size_t memory_budget, size_t num_partitions)
+    : _memory_budget(memory_budget)
+    , _sample_level(0)
+    , _sample_mask(0)
+{
+    num_partitions = floor_pow2(std::min(std::max<size_t>(num_partitions, 1),
+                                         max_partitions));
+    _partition_budget = std::max(memory_budget / num_partitions, sizeof(Bucket));
+    _partitions.resize(num_partitions);
+}
+
+unsigned
+KmerCounter::
+_probe(const Partition &part, uint64_t key, uint64_t hash, size_t &bucket)
+{
+    const size_t mask = part.buckets.size() - 1;
+
+    for (bucket = (hash >> bucket_bit) & mask;; bucket = (bucket + 1) & mask) {
+        const Bucket &b = part.buckets[bucket];
+        for (unsigned i = 0; i < 5; i++) {
+            if (b.keys[i] == key || b.keys[i] == 0) {
+                return i;
+            }
+        }
+    }
+}
+
+void
+KmerCounter::
+_insert(uint64_t kmer, uint64_t hash, uint32_t count)
+{
+    Partition &part = _partitions[_partition_of(hash)];
+    const uint64_t key = kmer + 1;
+    size_t bucket;
+
+    if (part.buckets.size() == 0) {
+        part.buckets.resize(std::min(initial_buckets,
+                                     floor_pow2(_partition_budget / sizeof(Bucket))));
+    }
+
+    unsigned slot = _probe(part, key, hash, bucket);
+    Bucket &b = part.buckets[bucket];
+    if (b.keys[slot] == key) {
+        const uint64_t sum = uint64_t(b.counts[slot]) + count;
+        b.counts[slot] = std::min<uint64_t>(sum, std::numeric_limits<uint32_t>::max());
+        return;
+    }
+    if (part.count + 1 > part.buckets.size() * max_per_bucket) {
+        if (part.buckets.size() * 2 * sizeof(Bucket) <= _partition_budget) {
+            _rebuild(part, part.buckets.size() * 2);
+        } else if (_sample_level < max_sample_level) {
+            _set_sample_level(_sample_level + 1);
+        } else {
+            // Even the sparsest sample is full; drop the k-mer
+            return;
+        }
+        add(kmer, count);
+        return;
+    }
+    b.keys[slot] = key;
+    b.counts[slot] = count;
+    part.count++;
+}
+
+void
+KmerCounter::
+add(const std::vector<uint64_t> &kmers)
+{
+    for (size_t i = 0; i < kmers.size(); i++) {
+        if (i + prefetch_distance < kmers.size()) {
+            const uint64_t hash = hash_int(kmers[i + prefetch_distance]);
+            const Partition &part = _partitions[_partition_of(hash)];
+            const size_t mask = part.buckets.size() - 1;
+            if (part.buckets.size() > 0 && (hash & _sample_mask) == 0) {
+                __builtin_prefetch(&part.buckets[(hash >> bucket_bit) & mask]);
+            }
+        }
+        add(kmers[i]);
+    }
+}
+
+void
+KmerCounter::
+_rebuild(Partition &part, size_t num_buckets)
+{
+    std::vector<Bucket, CacheAlignedAllocator<Bucket>> old(num_buckets, Bucket());
+
+    old.swap(part.buckets);
+    part.count = 0;
+    for (const Bucket &b: old) {
+        for (unsigned i = 0; i < 5; i++) {
+            if (b.keys[i] == 0) {
+                continue;
+            }
+            const uint64_t hash = hash_int(b.keys[i] - 1);
+            if ((hash & _sample_mask) != 0) {
+                continue;
+            }
+            size_t bucket;
+            unsigned slot = _probe(part, b.keys[i], hash, bucket);
+            part.buckets[bucket].keys[slot] = b.keys[i];
+            part.buckets[bucket].counts[slot] = b.counts[i];
+            part.count++;
+        }
+    }
+}
+
+void
+KmerCounter::
+_filter(Partition &part)
+{
+    bool moved = true;
+
+    for (Bucket &b: part.buckets) {
+        for (unsigned i = 0; i < 5; i++) {
+            if (b.keys[i] != 0 && (hash_int(b.keys[i] - 1) & _sample_mask) != 0) {
+                b.keys[i] = 0;
+                part.count--;
+            }
+        }
+    }
+    // Emptied slots may now end the probes of k-mers beyond them, so move
+    // each k-mer to the first empty slot on its probe, until none move. Each
+    // move shortens a probe, so this ends, usually after a pass or two.
+    while (moved) {
+        moved = false;
+        for (size_t i = 0; i < part.buckets.size(); i++) {
+            for (unsigned j = 0; j < 5; j++) {
+                const uint64_t key = part.buckets[i].keys[j];
+                if (key == 0) {
+                    continue;
+                }
+                size_t bucket;
+                unsigned slot = _probe(part, key, hash_int(key - 1), bucket);
+                if (bucket != i || slot != j) {
+                    part.buckets[bucket].keys[slot] = key;
+                    part.buckets[bucket].counts[slot] = part.buckets[i].counts[j];
+                    part.buckets[i].keys[j] = 0;
+                    moved = true;
+                }
+            }
+        }
+    }
+}
+
+void
+KmerCounter::
+_set_sample_level(unsigned level)
+{
+    _sample_level = level;
+    _sample_mask = (uint64_t(1) << level) - 1;
+    for (Partition &part: _partitions) {
+        _filter(part);
+    }
+}
+
+void
+KmerCounter::
+merge(KmerCounter &other)
+{
+    // Counters are split from one budget, one per thread, so the merged
+    // counter may use all of theirs
+    _memory_budget += other._memory_budget;
+    _partition_budget += other._partition_budget;
+    if (other._sample_level > _sample_level) {
+        _set_sample_level(other._sample_level);
+    }
+    // Each of other's partitions is freed once merged, so that both
+    // counters together stay within the budget they now share
+    for (Partition &part: other._partitions) {
+        for (const Bucket &b: part.buckets) {
+            for (unsigned i = 0; i < 5; i++) {
+                if (b.keys[i] != 0) {
+                    add(b.keys[i] - 1, b.counts[i]);
+                }
+            }
+        }
+        std::vector<Bucket, CacheAlignedAllocator<Bucket>>().swap(part.buckets);
+        part.count = 0;
+    }
+    other._memory_budget = 0;
+    other._partition_budget = sizeof(Bucket);
+}
+
+std::map<uint32_t, uint64_t>
+KmerCounter::
+histogram() const
+{
+    std::map<uint32_t, uint64_t> hist;
+
+    for (const Partition &part: _partitions) {
+        for (const Bucket &b: part.buckets) {
+            for (unsigned i = 0; i < 5; i++) {
+                if (b.keys[i] != 0) {
+                    hist[b.counts[i]]++;
+                }
+            }
+        }
+    }
+    return hist;
+}
+
+uint32_t
+KmerCounter::
+count(uint64_t kmer) const
+{
+    const uint64_t hash = hash_int(kmer);
+    const Partition &part = _partitions[_partition_of(hash)];
+    size_t bucket;
+
+    if (part.buckets.size() == 0) {
+        return 0;
+    }
+    unsigned slot = _probe(part, kmer + 1, hash, bucket);
+    return part.buckets[bucket].keys[slot] == kmer + 1 ? part.buckets[bucket].counts[slot] : 0;
+}
+
+size_t
+KmerCounter::
+size() const
+{
+    size_t count = 0;
+
+    for (const Partition &part: _partitions) {
+        count += part.count;
+    }
+    return count;
+}
+
+size_t
+KmerCounter::
+memory_size() const
+{
+    size_t bytes = 0;
+
+    for (const Partition &part: _partitions) {
+        bytes += part.buckets.size() * sizeof(Bucket);
+    }
+    return bytes;
+}
+
+/*****************************************************************************
+ *                               KmerSpectrum
+ *****************************************************************************/
+
+KmerSpectrum::
+KmerSpectrum(const std::string &name, size_t k, size_t memory_budget,
+             const QualityEncoding &encoding)
+    : ReadProcessor(name, encoding)
+    , _k(std::min(std::max<size_t>(k, 1), max_k))
+    , _num_kmers(0)
+    , _counter(memory_budget)
+{
+}
+
+template<typename Sequence>
+void
+KmerSpectrum::
+_count_kmers(const Sequence &sequence)
+{
+    _kmers.clear();
+    for_each_canonical_kmer(sequence, _k, [this](uint64_t kmer, size_t) {
+        _kmers.push_back(kmer);
+    });
+    _num_kmers += _kmers.size();
+    _counter.add(_kmers);
+}
+
+void
+KmerSpectrum::
+process_read(Read &the_read)
+{
+    _num_reads++;
+    _count_kmers(the_read.sequence);
+}
+
+void
+KmerSpectrum::
+process_read_pair(ReadPair &the_read_pair)
+{
+    _num_reads += 2;
+    _count_kmers(the_read_pair.first.sequence);
+    _count_kmers(the_read_pair.second.sequence);
+}
+
+void
+KmerSpectrum::
+process_read(const PackedRead &the_read)
+{
+    _num_reads++;
+    _count_kmers(the_read.sequence);
+}
+
+void
+KmerSpectrum::
+add_stats_from(ReadProcessor *other_ptr)
+{
+    KmerSpectrum &other = *reinterpret_cast<KmerSpectrum *>(other_ptr);
+
+    _num_reads += other._num_reads;
+    _num_kmers += other._num_kmers;
+    _counter.merge(other._counter);
+}
+
+std::map<uint32_t, uint64_t>
+KmerSpectrum::
+spectrum() const
+{
+    std::map<uint32_t, uint64_t> spectrum = _counter.histogram();
+
+    for (auto &entry: spectrum) {
+        entry.second <<= _counter.sample_level();
+    }
+    return spectrum;
+}
+
+std::string
+KmerSpectrum::
+yaml_report()
+{
+    std::ostringstream ss;
+    YAML::Emitter yml;
+
+    yml << YAML::BeginSeq;
+    yml << YAML::BeginMap;
+    yml << YAML::Key   << "KmerSpectrum"
+        << YAML::Value
+        << YAML::BeginMap
+        << YAML::Key   << "name"
+        << YAML::Value << _name
+        << YAML::Key   << "parameters"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "quality_encoding"
+                       << YAML::Value << _encoding.name
+                       << YAML::Key << "k"
+                       << YAML::Value << _k
+                       << YAML::Key << "memory_budget"
+                       << YAML::Value << _counter.memory_budget()
+                       << YAML::EndMap
+        << YAML::Key   << "output"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "num_reads"
+                       << YAML::Value << _num_reads
+                       << YAML::Key << "num_kmers"
+                       << YAML::Value << _num_kmers
+                       << YAML::Key << "distinct_kmers"
+                       << YAML::Value << distinct_kmers()
+                       << YAML::Key << "sample_rate"
+                       << YAML::Value << 1.0 / (uint64_t(1) << _counter.sample_level())
+                       << YAML::Key << "memory_used"
+                       << YAML::Value << _counter.memory_size()
+                       << YAML::Key << "spectrum"
+                       << YAML::Value << YAML::Flow << spectrum()
+                       << YAML::EndMap
+        << YAML::EndMap;
+    yml << YAML::EndMap;
+    yml << YAML::EndSeq;
+    ss << yml.c_str() << "\n";
+    return ss.str();
+}
+
+} // namespace qcpp
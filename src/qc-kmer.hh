@@ -0,0 +1,352 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_KMER_HH
+#define QC_KMER_HH
+
+#include "qc-config.hh"
+#include "qc-packed.hh"
+#include "qc-processor.hh"
+#include "qc-quality.hh"
+#include "qc-util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <vector>
+
+#include <sys/mman.h>
+
+namespace qcpp
+{
+
+// The 2-bit code of an upper case base, as in PackedSequence: A = 0, C = 1,
+// T = 2, G = 3, so that a base's complement is its code XOR 2
+static inline uint64_t
+kmer_base_code(char base)
+{
+    return (base >> 1) & 3;
+}
+
+// Calls fn(kmer, pos) with each canonical k-mer (the lesser of the k-mer and
+// its reverse complement, coded with the first base in the highest bits) of
+// sequence, and the position of its first base, for k <= 31. k-mers restart
+// after any base other than A, C, G or T.
+template<typename Fn>
+inline void
+for_each_canonical_kmer(const std::string &sequence, size_t k, Fn fn)
+{
+    const uint64_t mask = (uint64_t(1) << (2 * k)) - 1;
+    const unsigned top = 2 * (k - 1);
+    uint64_t fw = 0, rc = 0;
+    size_t run = 0;
+
+    // The forward k-mer gains each base at the bottom, and its reverse
+    // complement gains the base's complement at the top
+    for (size_t i = 0; i < sequence.size(); i++) {
+        const char base = sequence[i];
+        if (base != 'A' && base != 'C' && base != 'G' && base != 'T') {
+            run = 0;
+            continue;
+        }
+        const uint64_t code = kmer_base_code(base);
+        fw = ((fw << 2) | code) & mask;
+        rc = (rc >> 2) | ((code ^ 2) << top);
+        if (++run >= k) {
+            fn(std::min(fw, rc), i + 1 - k);
+        }
+    }
+}
+
+// As above, for a packed sequence, giving the same k-mers. Bases are taken
+// from the packed words, with no per-base check; runs restart at the bases
+// of its ambiguous list instead.
+template<typename Fn>
+inline void
+for_each_canonical_kmer(const PackedSequence &sequence, size_t k, Fn fn)
+{
+    const uint64_t mask = (uint64_t(1) << (2 * k)) - 1;
+    const unsigned top = 2 * (k - 1);
+    const std::vector<uint64_t> &words = sequence.words();
+    auto ambiguous = sequence.ambiguous().begin();
+    const auto ambiguous_end = sequence.ambiguous().end();
+    uint64_t fw = 0, rc = 0, bits = 0;
+    size_t run = 0;
+
+    for (size_t i = 0; i < sequence.size(); i++) {
+        if (i % 32 == 0) {
+            bits = words[i / 32];
+        }
+        const uint64_t code = bits & 3;
+        bits >>= 2;
+        if (ambiguous != ambiguous_end && ambiguous->first == i) {
+            ++ambiguous;
+            run = 0;
+            continue;
+        }
+        fw = ((fw << 2) | code) & mask;
+        rc = (rc >> 2) | ((code ^ 2) << top);
+        if (++run >= k) {
+            fn(std::min(fw, rc), i + 1 - k);
+        }
+    }
+}
+
+// Allocates memory aligned to cache lines, which std::allocator doesn't
+// guarantee for over-aligned types before C++17. Large tables are mapped
+// directly, so that freeing one (e.g. when it grows) returns its memory at
+// once rather than leaving it in malloc's heap.
+template<typename T>
+struct CacheAlignedAllocator
+{
+    typedef T value_type;
+
+    static const size_t map_size = size_t(1) << 20;
+
+    CacheAlignedAllocator() = default;
+
+    template<typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U> &)
+    {
+    }
+
+    T *
+    allocate(size_t n)
+    {
+        void *ptr = NULL;
+        if (n * sizeof(T) >= map_size) {
+            ptr = mmap(NULL, n * sizeof(T), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+        } else if (posix_memalign(&ptr, 64, n * sizeof(T)) != 0) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(ptr);
+    }
+
+    void
+    deallocate(T *ptr, size_t n)
+    {
+        if (n * sizeof(T) >= map_size) {
+            munmap(ptr, n * sizeof(T));
+        } else {
+            free(ptr);
+        }
+    }
+
+    template<typename U>
+    bool
+    operator==(const CacheAlignedAllocator<U> &) const
+    {
+        return true;
+    }
+
+    template<typename U>
+    bool
+    operator!=(const CacheAlignedAllocator<U> &) const
+    {
+        return false;
+    }
+};
+
+// Counts of k-mers (2-bit coded, k <= 31) in at most memory_budget bytes.
+// The table is split into partitions by hash, and each partition into
+// 64-byte buckets of five k-mers and their counts, so that most lookups touch
+// one cache line. A partition that can't grow within its share of the budget
+// raises the sample level: from then on, only k-mers whose hashes have that
+// many trailing zero bits are counted, and those without are dropped. Counts
+// of the k-mers that are kept are exact.
+class KmerCounter
+{
+public:
+    static const size_t default_memory_budget = size_t(1) << 30;
+
+    explicit
+    KmerCounter                     (size_t             memory_budget=default_memory_budget,
+                                     size_t             num_partitions=16);
+
+    // Counts kmer count more times, if it is in the sample
+    void
+    add                             (uint64_t           kmer,
+                                     uint32_t           count=1)
+    {
+        const uint64_t hash = hash_int(kmer);
+
+        if ((hash & _sample_mask) == 0) {
+            _insert(kmer, hash, count);
+        }
+    }
+
+    // Counts each of kmers once more. Buckets are prefetched a few k-mers
+    // ahead, so that their cache misses overlap.
+    void
+    add                             (const std::vector<uint64_t> &kmers);
+
+    // Adds other's counts, at the sparser of both sample levels. This counter
+    // takes on other's memory budget as well as its own, and other is left
+    // empty, its memory freed as it is merged.
+    void
+    merge                           (KmerCounter       &other);
+
+    // The number of sampled k-mers with each count
+    std::map<uint32_t, uint64_t>
+    histogram                       () const;
+
+    // The count of kmer, or 0 if it was not seen or not sampled
+    uint32_t
+    count                           (uint64_t           kmer) const;
+
+    // The number of distinct k-mers in the sample
+    size_t
+    size                            () const;
+
+    // One in 2^sample_level k-mers are counted
+    unsigned
+    sample_level                    () const
+    {
+        return _sample_level;
+    }
+
+    size_t
+    memory_size                     () const;
+
+    size_t
+    memory_budget                   () const
+    {
+        return _memory_budget;
+    }
+
+protected:
+    struct alignas(64) Bucket
+    {
+        // k-mers plus one, so that zero marks an empty slot
+        uint64_t            keys[5];
+        uint32_t            counts[5];
+    };
+
+    struct Partition
+    {
+        std::vector<Bucket, CacheAlignedAllocator<Bucket>> buckets;
+        size_t              count = 0;
+    };
+
+    // Partitions are chosen from the top bits of a hash
+    size_t
+    _partition_of                   (uint64_t           hash) const
+    {
+        return (hash >> 56) & (_partitions.size() - 1);
+    }
+
+    // The slot of bucket holding key, or the empty slot where it would go
+    static unsigned
+    _probe                          (const Partition   &part,
+                                     uint64_t           key,
+                                     uint64_t           hash,
+                                     size_t            &bucket);
+
+    void
+    _insert                         (uint64_t           kmer,
+                                     uint64_t           hash,
+                                     uint32_t           count);
+
+    // Moves part's sampled k-mers into a table of num_buckets buckets
+    void
+    _rebuild                        (Partition         &part,
+                                     size_t             num_buckets);
+
+    // Removes k-mers no longer in the sample from part, in place
+    void
+    _filter                         (Partition         &part);
+
+    void
+    _set_sample_level               (unsigned           level);
+
+    size_t                  _memory_budget;
+    size_t                  _partition_budget;
+    unsigned                _sample_level;
+    uint64_t                _sample_mask;
+    std::vector<Partition>  _partitions;
+};
+
+// Counts the canonical k-mers of every read (see for_each_canonical_kmer),
+// for the k-mer abundance spectrum of a library. Each copy of the
+// processor counts into its own KmerCounter of at most memory_budget bytes;
+// copies are merged by add_stats_from(). The spectrum is reported as the
+// estimated number of distinct k-mers seen each number of times, scaled up
+// from the sample if the counter had to sub-sample.
+class KmerSpectrum: public ReadProcessor
+{
+public:
+    KmerSpectrum                    (const std::string &name,
+                                     size_t             k=21,
+                                     size_t             memory_budget=KmerCounter::default_memory_budget,
+                                     const QualityEncoding &encoding=SangerEncoding);
+
+    void
+    process_read                    (Read              &the_read);
+
+    void
+    process_read_pair               (ReadPair          &the_read_pair);
+
+    // Counts a packed read's k-mers straight from its packed words
+    void
+    process_read                    (const PackedRead  &the_read);
+
+    void
+    add_stats_from                  (ReadProcessor     *other_ptr);
+
+    std::string
+    yaml_report                     ();
+
+    // All k-mers seen, counting repeats
+    uint64_t
+    num_kmers                       () const
+    {
+        return _num_kmers;
+    }
+
+    // The estimated number of distinct k-mers seen each number of times
+    std::map<uint32_t, uint64_t>
+    spectrum                        () const;
+
+    uint64_t
+    distinct_kmers                  () const
+    {
+        return uint64_t(_counter.size()) << _counter.sample_level();
+    }
+
+    const KmerCounter &
+    counter                         () const
+    {
+        return _counter;
+    }
+
+private:
+    template<typename Sequence>
+    void
+    _count_kmers                    (const Sequence    &sequence);
+
+    size_t                  _k;
+    uint64_t                _num_kmers;
+    // The current read's canonical k-mers
+    std::vector<uint64_t>   _kmers;
+    KmerCounter             _counter;
+};
+
+// The canonical k-mer of the first k bases of sequence, coded as by
+// KmerSpectrum (the first base in the highest bits)
+uint64_t canonical_kmer(const std::string &sequence, size_t k);
+
+} // namespace qcpp
+
+#endif /* QC_KMER_HH */
@@ -7,6 +7,8 @@
  */
 
 
+#include <algorithm>
+
 #include <yaml-cpp/yaml.h>
 
 #include "qc-measure.hh"
@@ -38,18 +40,51 @@ add_stats_from(ReadProcessor *other_ptr)
     while (_qual_scores_r2.size() < other._qual_scores_r2.size()) {
         _qual_scores_r2.emplace_back();
     }
-    for (size_t i = 0, len = _qual_scores_r1.size(); i < len; i++) {
-        for (const auto &pair: other._qual_scores_r1[i]) {
-            _qual_scores_r1[i][pair.first] += pair.second;
+    for (size_t i = 0, len = other._qual_scores_r1.size(); i < len; i++) {
+        for (size_t j = 0; j < _qual_scores_r1[i].size(); j++) {
+            _qual_scores_r1[i][j] += other._qual_scores_r1[i][j];
+        }
+    }
+    for (size_t i = 0, len = other._qual_scores_r2.size(); i < len; i++) {
+        for (size_t j = 0; j < _qual_scores_r2[i].size(); j++) {
+            _qual_scores_r2[i][j] += other._qual_scores_r2[i][j];
         }
     }
-    for (size_t i = 0, len = _qual_scores_r2.size(); i < len; i++) {
-        for (const auto &pair: other._qual_scores_r2[i]) {
-            _qual_scores_r2[i][pair.first] += pair.second;
+    _max_len = std::max(_max_len, other._max_len);
+    _have_r2 = _have_r2 || other._have_r2;
+}
+
+
+void
+PerBaseQuality::
+_count_qualities(const Read &the_read, std::vector<QualityCounts> &counts)
+{
+    const std::string &qual = the_read.quality;
+    const size_t len = std::min(qual.size(), the_read.size());
+
+    for (size_t i = 0; i < len; i++) {
+        // Characters outside '!' to '~' wrap around past the end, and
+        // aren't qualities
+        size_t idx = static_cast<unsigned char>(qual[i]) - size_t('!');
+        if (idx < counts[i].size()) {
+            counts[i][idx]++;
         }
     }
 }
 
+PhredHistogram
+PerBaseQuality::
+_histogram(const QualityCounts &counts)
+{
+    PhredHistogram hist;
+
+    for (size_t i = 0; i < counts.size(); i++) {
+        if (counts[i] > 0) {
+            hist[_encoding.p2q('!' + i)] = counts[i];
+        }
+    }
+    return hist;
+}
 
 void
 PerBaseQuality::
@@ -63,10 +98,7 @@ process_read(Read &the_read)
         _max_len = read_len;
     }
 
-    for (size_t i = 0; i < read_len; i++) {
-        size_t qual_score = _encoding.p2q(the_read.quality[i]);
-        _qual_scores_r1[i][qual_score]++;
-    }
+    _count_qualities(the_read, _qual_scores_r1);
     _num_reads++;
 }
 
@@ -88,14 +120,8 @@ process_read_pair(ReadPair &the_read_pair)
         }
         _max_len = larger_len;
     }
-    for (size_t i = 0; i < read_len1; i++) {
-        size_t qual_score = _encoding.p2q(r1.quality[i]);
-        _qual_scores_r1[i][qual_score]++;
-    }
-    for (size_t i = 0; i < read_len2; i++) {
-        size_t qual_score = _encoding.p2q(r2.quality[i]);
-        _qual_scores_r2[i][qual_score]++;
-    }
+    _count_qualities(r1, _qual_scores_r1);
+    _count_qualities(r2, _qual_scores_r2);
     _num_reads += 2;
 }
 
@@ -126,7 +152,7 @@ yaml_report()
              << Value << BeginSeq;
             // Handle R1 phred scores
             for (size_t i = 0; i < _max_len; i++) {
-                yml << Flow << _qual_scores_r1[i];
+                yml << Flow << _histogram(_qual_scores_r1[i]);
             }
             yml << EndSeq; // End of r1_phred_scores
             yml << Key << "r2_phred_scores"
@@ -134,7 +160,7 @@ yaml_report()
     if (_have_r2) {
         // Handle R2 phred scores
         for (size_t i = 0; i < _max_len; i++) {
-            yml << Flow << _qual_scores_r2[i];
+            yml << Flow << _histogram(_qual_scores_r2[i]);
         }
     }
     yml << EndSeq; // End of r2_phred_scores
@@ -147,4 +173,235 @@ yaml_report()
     return ss.str();
 }
 
+/////////////////////////////// BaseCounts /////////////////////////////
+// The 8-bit batch counters can't overflow within this many reads
+static const unsigned base_count_batch = 255;
+static const char count_bases[] = {'A', 'C', 'G', 'T'};
+
+void
+BaseCounts::
+_grow(size_t length)
+{
+    for (size_t b = 0; b < 4; b++) {
+        _batch[b].resize(length, 0);
+        _counts[b].resize(length, 0);
+    }
+    _lengths.resize(length + 1, 0);
+}
+
+void
+BaseCounts::
+add(const std::string &sequence)
+{
+    const size_t len = sequence.size();
+    const char *seq = sequence.data();
+    unsigned gc = 0, acgt = 0;
+
+    if (len >= _lengths.size()) {
+        _grow(len);
+    }
+    uint8_t *a = _batch[0].data();
+    uint8_t *c = _batch[1].data();
+    uint8_t *g = _batch[2].data();
+    uint8_t *t = _batch[3].data();
+    for (size_t i = 0; i < len; i++) {
+        // Clearing bit 5 upper-cases letters
+        const char base = seq[i] & ~0x20;
+        const uint8_t is_a = base == 'A', is_c = base == 'C';
+        const uint8_t is_g = base == 'G', is_t = base == 'T';
+        a[i] += is_a;
+        c[i] += is_c;
+        g[i] += is_g;
+        t[i] += is_t;
+        gc += is_c + is_g;
+        acgt += is_a + is_c + is_g + is_t;
+    }
+    _lengths[len]++;
+    if (acgt > 0) {
+        _gc[(gc * 100 + acgt / 2) / acgt]++;
+    }
+    if (++_batch_reads == base_count_batch) {
+        flush();
+    }
+}
+
+void
+BaseCounts::
+flush()
+{
+    for (size_t b = 0; b < 4; b++) {
+        for (size_t i = 0; i < _batch[b].size(); i++) {
+            _counts[b][i] += _batch[b][i];
+        }
+        std::fill(_batch[b].begin(), _batch[b].end(), 0);
+    }
+    _batch_reads = 0;
+}
+
+void
+BaseCounts::
+merge(BaseCounts &other)
+{
+    flush();
+    other.flush();
+    if (other._lengths.size() > _lengths.size()) {
+        _grow(other.max_length());
+    }
+    for (size_t b = 0; b < 4; b++) {
+        for (size_t i = 0; i < other._counts[b].size(); i++) {
+            _counts[b][i] += other._counts[b][i];
+        }
+    }
+    for (size_t i = 0; i < other._lengths.size(); i++) {
+        _lengths[i] += other._lengths[i];
+    }
+    for (size_t i = 0; i < _gc.size(); i++) {
+        _gc[i] += other._gc[i];
+    }
+}
+
+size_t
+BaseCounts::
+coverage(size_t pos) const
+{
+    size_t reads = 0;
+
+    for (size_t len = pos + 1; len < _lengths.size(); len++) {
+        reads += _lengths[len];
+    }
+    return reads;
+}
+
+size_t
+BaseCounts::
+count(size_t pos, char base) const
+{
+    if (pos >= max_length()) {
+        return 0;
+    }
+    base &= ~0x20;
+    for (size_t b = 0; b < 4; b++) {
+        if (base == count_bases[b]) {
+            return _counts[b][pos];
+        }
+    }
+    size_t others = coverage(pos);
+    for (size_t b = 0; b < 4; b++) {
+        others -= _counts[b][pos];
+    }
+    return others;
+}
+
+/////////////////////////////// BaseComposition //////////////////////////
+BaseComposition::
+BaseComposition(const std::string &name, const QualityEncoding &encoding)
+    : ReadProcessor(name, encoding)
+    , _have_r2(false)
+{
+}
+
+void
+BaseComposition::
+process_read(Read &the_read)
+{
+    _r1.add(the_read.sequence);
+    _num_reads++;
+}
+
+void
+BaseComposition::
+process_read_pair(ReadPair &the_read_pair)
+{
+    _have_r2 = true;
+    _r1.add(the_read_pair.first.sequence);
+    _r2.add(the_read_pair.second.sequence);
+    _num_reads += 2;
+}
+
+void
+BaseComposition::
+add_stats_from(ReadProcessor *other_ptr)
+{
+    BaseComposition &other = *reinterpret_cast<BaseComposition *>(other_ptr);
+
+    _num_reads += other._num_reads;
+    _r1.merge(other._r1);
+    _r2.merge(other._r2);
+    _have_r2 = _have_r2 || other._have_r2;
+}
+
+static void
+emit_base_counts(YAML::Emitter &yml, const BaseCounts &counts)
+{
+    using namespace YAML;
+
+    // Reads covering each position, from which the others are counted
+    size_t covered = counts.coverage(0);
+
+    yml << BeginSeq;
+    for (size_t i = 0; i < counts.max_length(); i++) {
+        size_t others = covered;
+        yml << Flow << BeginMap;
+        for (char base: count_bases) {
+            const size_t count = counts.count(i, base);
+            yml << Key << std::string(1, base) << Value << count;
+            others -= count;
+        }
+        yml << Key << "N" << Value << others;
+        yml << EndMap;
+        covered -= counts.num_reads_of_length(i + 1);
+    }
+    yml << EndSeq;
+}
+
+std::string
+BaseComposition::
+yaml_report()
+{
+    using namespace YAML;
+    std::ostringstream ss;
+    YAML::Emitter yml;
+    const BaseCounts &r1 = r1_counts();
+    const BaseCounts &r2 = r2_counts();
+
+    yml << BeginSeq;
+    yml << BeginMap;
+    yml << Key << "BaseComposition" << Value;
+
+    yml << BeginMap;
+    yml << Key << "name" << Value << _name;
+    yml << Key << "parameters"
+        << Value << BeginMap
+            << Key << "quality_encoding" << Value << _encoding.name
+            << EndMap;
+
+    yml << Key << "output"
+        << Value << BeginMap
+             << Key << "num_reads"
+             << Value << _num_reads
+             << Key << "r1_base_counts"
+             << Value;
+    emit_base_counts(yml, r1);
+    yml << Key << "r1_gc_histogram"
+        << Value << Flow << std::vector<size_t>(r1.gc_histogram().begin(),
+                                                r1.gc_histogram().end());
+    yml << Key << "r2_base_counts" << Value;
+    if (_have_r2) {
+        emit_base_counts(yml, r2);
+        yml << Key << "r2_gc_histogram"
+            << Value << Flow << std::vector<size_t>(r2.gc_histogram().begin(),
+                                                    r2.gc_histogram().end());
+    } else {
+        yml << Flow << BeginSeq << EndSeq;
+        yml << Key << "r2_gc_histogram" << Value << Flow << BeginSeq << EndSeq;
+    }
+
+    yml << EndMap
+        << EndMap;
+    yml << EndMap;  // BaseComposition
+    yml << EndSeq;  // root
+    ss << yml.c_str() << "\n";
+    return ss.str();
+}
+
 } // end namespace qcpp
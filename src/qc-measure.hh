@@ -38,10 +38,125 @@ public:
     yaml_report                     ();
 
 private:
+    // Counts of each quality character from '!' to '~' at one cycle. These
+    // are only turned into scores for the report, so counting needs no
+    // offset and no map lookup.
+    typedef std::array<size_t, '~' - '!' + 1> QualityCounts;
+
+    void
+    _count_qualities                (const Read        &the_read,
+                                     std::vector<QualityCounts> &counts);
+
+    PhredHistogram
+    _histogram                      (const QualityCounts &counts);
+
     bool                    _have_r2;
     size_t                  _max_len;
-    std::vector<PhredHistogram> _qual_scores_r1;
-    std::vector<PhredHistogram> _qual_scores_r2;
+    std::vector<QualityCounts> _qual_scores_r1;
+    std::vector<QualityCounts> _qual_scores_r2;
+};
+
+// Counts of A, C, G, T and other bases at each read position, and a
+// histogram of reads' GC content. Each read is counted into 8-bit counters
+// with compare-and-add loops that the compiler vectorises, and these are
+// added to the totals every 255 reads, or by flush().
+class BaseCounts
+{
+public:
+    void
+    add                             (const std::string &sequence);
+
+    // Adds the batch counters to the totals
+    void
+    flush                           ();
+
+    // Adds other's counts. Both are flushed.
+    void
+    merge                           (BaseCounts        &other);
+
+    // The count of base (A, C, G or T, or N for anything else, case
+    // insensitive) at position pos, as of the last flush()
+    size_t
+    count                           (size_t             pos,
+                                     char               base) const;
+
+    // The number of reads at least pos + 1 bases long
+    size_t
+    coverage                        (size_t             pos) const;
+
+    size_t
+    num_reads_of_length             (size_t             length) const
+    {
+        return length < _lengths.size() ? _lengths[length] : 0;
+    }
+
+    // The length of the longest read
+    size_t
+    max_length                      () const
+    {
+        return _lengths.size() > 0 ? _lengths.size() - 1 : 0;
+    }
+
+    // Reads by GC percentage of their A, C, G and T bases, rounded. Reads
+    // without any are not counted.
+    const std::array<size_t, 101> &
+    gc_histogram                    () const
+    {
+        return _gc;
+    }
+
+private:
+    void
+    _grow                           (size_t             length);
+
+    // 8-bit counts of A, C, G and T at each position, for the current batch
+    std::array<std::vector<uint8_t>, 4> _batch;
+    unsigned                _batch_reads = 0;
+    std::array<std::vector<size_t>, 4> _counts;
+    // Reads of each length
+    std::vector<size_t>     _lengths;
+    std::array<size_t, 101> _gc = {};
+};
+
+// Records the base composition of each read position, and the distribution
+// of reads' GC content, for R1 and R2.
+class BaseComposition: public ReadProcessor
+{
+public:
+    BaseComposition                 (const std::string &name,
+                                     const QualityEncoding &encoding=SangerEncoding);
+
+    void
+    process_read                    (Read              &the_read);
+
+    void
+    process_read_pair               (ReadPair          &the_read_pair);
+
+    void
+    add_stats_from                  (ReadProcessor     *other);
+
+    std::string
+    yaml_report                     ();
+
+    // The counts so far for R1 (or single end reads) and R2
+    const BaseCounts &
+    r1_counts                       ()
+    {
+        _r1.flush();
+        return _r1;
+    }
+
+    const BaseCounts &
+    r2_counts                       ()
+    {
+        _r2.flush();
+        return _r2;
+    }
+
+private:
+    bool                    _have_r2;
+    BaseCounts              _r1;
+    BaseCounts              _r2;
 };
 
 
@@ -0,0 +1,346 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "qc-mmap.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace qcpp
+{
+
+/*****************************************************************************
+ *                                MappedFile
+ *****************************************************************************/
+
+MappedFile::
+MappedFile(const std::string &filename, int flags)
+    : _data(NULL)
+    , _size(0)
+{
+    struct stat st;
+    int fd = ::open(filename.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        throw IOError("Could not open '" + filename + "' for reading: " +
+                      strerror(errno));
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        throw IOError("'" + filename + "' is not a regular file, and can't be "
+                      "memory-mapped.");
+    }
+    if (st.st_size == 0) {
+        ::close(fd);
+        throw IOError("File '" + filename + "' does not contain any sequences!");
+    }
+    _size = st.st_size;
+
+    int mmap_flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (flags & MapPopulate) {
+        mmap_flags |= MAP_POPULATE;
+    }
+#endif
+    void *addr = mmap(NULL, _size, PROT_READ, mmap_flags, fd, 0);
+    int mmap_errno = errno;
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw IOError("Could not memory-map '" + filename + "': " +
+                      strerror(mmap_errno));
+    }
+    _data = static_cast<const char *>(addr);
+
+    // These are only hints, so failure is not an error
+    if (flags & MapRandom) {
+        madvise(addr, _size, MADV_RANDOM);
+        madvise(addr, _size, MADV_WILLNEED);
+    } else {
+        madvise(addr, _size, MADV_SEQUENTIAL);
+    }
+#ifdef MADV_HUGEPAGE
+    if (flags & MapHugePages) {
+        madvise(addr, _size, MADV_HUGEPAGE);
+    }
+#endif
+
+    // Check for gzip and bzip2 magic numbers
+    if ((_size >= 2 && _data[0] == '\x1f' && _data[1] == '\x8b') ||
+            (_size >= 3 && strncmp(_data, "BZh", 3) == 0)) {
+        munmap(addr, _size);
+        _data = NULL;
+        throw IOError("File '" + filename + "' is compressed, and can't be "
+                      "memory-mapped.");
+    }
+}
+
+MappedFile::
+~MappedFile()
+{
+    if (_data != NULL) {
+        munmap(const_cast<char *>(_data), _size);
+    }
+}
+
+/*****************************************************************************
+ *                             MappedReadParser
+ *****************************************************************************/
+
+// Returns a pointer to the end of the line starting at p (i.e. the newline, or
+// end if there is none)
+static inline const char *
+line_end(const char *p, const char *end)
+{
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    return eol != NULL ? eol : end;
+}
+
+// Strips any carriage return before the newline
+static inline const char *
+strip_cr(const char *begin, const char *eol)
+{
+    if (eol > begin && eol[-1] == '\r') {
+        return eol - 1;
+    }
+    return eol;
+}
+
+MappedReadParser::
+MappedReadParser()
+    : _pos(0)
+    , _end(0)
+    , _num_reads(0)
+    , _fastq(true)
+{
+}
+
+MappedReadParser::
+MappedReadParser(const MappedReadParser &other, size_t begin, size_t end)
+    : ReadInputStream(other)
+    , _file(other._file)
+    , _pos(begin)
+    , _end(end)
+    , _num_reads(0)
+    , _fastq(other._fastq)
+{
+    _at_end = _pos >= _end;
+}
+
+void
+MappedReadParser::
+open(const char *filename, int flags)
+{
+    open(std::string(filename), flags);
+}
+
+void
+MappedReadParser::
+open(const std::string &filename, int flags)
+{
+    _file = std::make_shared<MappedFile>(filename, flags);
+    _pos = 0;
+    _end = _file->size();
+    _num_reads = 0;
+    _at_end = false;
+
+    const char *data = _file->data();
+    size_t first = 0;
+    while (first < _end && isspace(data[first])) {
+        first++;
+    }
+    if (first == _end) {
+        throw IOError("File '" + filename + "' does not contain any sequences!");
+    }
+    if (data[first] != '@' && data[first] != '>') {
+        throw IOError("File '" + filename + "' is not a FASTQ or FASTA file.");
+    }
+    _fastq = data[first] == '@';
+}
+
+bool
+MappedReadParser::
+_parse_at(size_t &pos, Read &the_read) const
+{
+    const char *data = _file->data();
+    const char *end = data + _end;
+    const char *p = data + pos;
+
+    the_read.clear();
+    while (p < end && (*p == '\n' || *p == '\r')) {
+        p++;
+    }
+    if (p == end) {
+        pos = _end;
+        return false;
+    }
+
+    if (_fastq) {
+        const char *line[4], *eol[4];
+        if (*p != '@') {
+            throw IOError("Malformed FASTQ record: expected '@'");
+        }
+        for (size_t i = 0; i < 4; i++) {
+            if (p >= end) {
+                throw IOError("Truncated FASTQ record");
+            }
+            line[i] = p;
+            eol[i] = line_end(p, end);
+            p = eol[i] < end ? eol[i] + 1 : end;
+            eol[i] = strip_cr(line[i], eol[i]);
+        }
+        if (line[2] == eol[2] || *line[2] != '+') {
+            throw IOError("Malformed FASTQ record: expected '+'");
+        }
+        the_read.name.assign(line[0] + 1, eol[0]);
+        the_read.sequence.assign(line[1], eol[1]);
+        the_read.quality.assign(line[3], eol[3]);
+        if (the_read.sequence.size() != the_read.quality.size()) {
+            throw IOError("Sequence and Quality lengths differ");
+        }
+    } else {
+        if (*p != '>') {
+            throw IOError("Malformed FASTA record: expected '>'");
+        }
+        const char *eol = line_end(p, end);
+        the_read.name.assign(p + 1, strip_cr(p, eol));
+        p = eol < end ? eol + 1 : end;
+        // Sequence lines continue until the next header
+        while (p < end && *p != '>') {
+            eol = line_end(p, end);
+            the_read.sequence.append(p, strip_cr(p, eol));
+            p = eol < end ? eol + 1 : end;
+        }
+    }
+    pos = p - data;
+    return true;
+}
+
+bool
+MappedReadParser::
+parse_read(Read &the_read)
+{
+    if (!_file || !_parse_at(_pos, the_read)) {
+        the_read.clear();
+        _at_end = true;
+        return false;
+    }
+    _num_reads++;
+    return true;
+}
+
+bool
+MappedReadParser::
+parse_read_pair(ReadPair &the_read_pair)
+{
+    bool first = parse_read(the_read_pair.first);
+    bool second = parse_read(the_read_pair.second);
+    if (!first || !second) {
+        the_read_pair.first.clear();
+        the_read_pair.second.clear();
+        return false;
+    }
+    return true;
+}
+
+size_t
+MappedReadParser::
+_next_record(size_t pos) const
+{
+    const char *data = _file->data();
+
+    // Move to the start of a line
+    if (pos > 0 && data[pos - 1] != '\n') {
+        const char *eol = line_end(data + pos, data + _end);
+        pos = eol - data + 1;
+    }
+    while (pos < _end) {
+        size_t next = line_end(data + pos, data + _end) - data + 1;
+        if (_fastq && data[pos] == '@') {
+            // Quality lines may also start with '@', but are never followed
+            // two lines later by a '+' line
+            size_t plus = next < _end ?
+                          line_end(data + next, data + _end) - data + 1 : _end;
+            if (plus < _end && data[plus] == '+') {
+                return pos;
+            }
+        } else if (!_fastq && data[pos] == '>') {
+            return pos;
+        }
+        pos = next;
+    }
+    return _end;
+}
+
+bool
+MappedReadParser::
+_odd_num_records(size_t begin, size_t pos) const
+{
+    Read read;
+    bool odd = false;
+
+    while (begin < pos && _parse_at(begin, read)) {
+        odd = !odd;
+    }
+    return odd;
+}
+
+std::vector<size_t>
+MappedReadParser::
+partition(size_t n, bool paired) const
+{
+    std::vector<size_t> offsets;
+
+    if (n == 0) {
+        n = 1;
+    }
+    offsets.push_back(_pos);
+    for (size_t i = 1; i < n; i++) {
+        size_t offset = _pos + (_end - _pos) * i / n;
+        offset = std::max(offsets.back(), _next_record(offset));
+        if (paired && offset < _end && offset > offsets.back()) {
+            // A range starts at this record if it and the next are mates,
+            // and at the next if that and the one after are. Where names
+            // can't tell (e.g. mates named frag_R1 and frag_R2, or all
+            // alike), records are counted from the last range, which starts
+            // at a pair.
+            Read r1, r2, r3;
+            size_t next = offset;
+            _parse_at(next, r1);
+            size_t after = next;
+            bool this_pair = _parse_at(after, r2) &&
+                             read_pair_name(r1.name) == read_pair_name(r2.name);
+            bool next_pair = _parse_at(after, r3) &&
+                             read_pair_name(r2.name) == read_pair_name(r3.name);
+            if (this_pair == next_pair) {
+                next_pair = _odd_num_records(offsets.back(), offset);
+            }
+            if (next_pair) {
+                offset = next;
+            }
+        }
+        offsets.push_back(offset);
+    }
+    offsets.push_back(_end);
+    return offsets;
+}
+
+size_t
+MappedReadParser::
+get_num_reads()
+{
+    return _num_reads;
+}
+
+} // namespace qcpp
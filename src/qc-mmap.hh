@@ -0,0 +1,130 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_MMAP_HH
+#define QC_MMAP_HH
+
+#include "qc-config.hh"
+#include "qc-io.hh"
+
+
+namespace qcpp
+{
+
+// A read-only memory mapping of a whole file. Only uncompressed, regular files
+// may be mapped.
+class MappedFile
+{
+public:
+    enum MapFlags {
+        MapDefault      = 0,
+        // Pre-fault the whole mapping with MAP_POPULATE
+        MapPopulate     = 1 << 0,
+        // Ask for transparent huge pages (ignored if unsupported)
+        MapHugePages    = 1 << 1,
+        // The file is read at random (e.g. an index), rather than from start
+        // to end, so read all of it ahead but don't read ahead of faults
+        MapRandom       = 1 << 2,
+    };
+
+    MappedFile                  (const std::string &filename,
+                                 int                flags=MapDefault);
+    ~MappedFile                 ();
+
+    MappedFile                  (const MappedFile  &other) = delete;
+    MappedFile &
+    operator=                   (const MappedFile  &other) = delete;
+
+    const char *
+    data                        () const
+    {
+        return _data;
+    }
+
+    size_t
+    size                        () const
+    {
+        return _size;
+    }
+
+protected:
+    const char             *_data;
+    size_t                  _size;
+};
+
+// Parses FASTQ or FASTA reads directly from a memory-mapped file, without
+// read(2) calls or intermediate buffers. Reads are copied out of the mapping
+// into the Read's strings, reusing their capacity.
+//
+// FASTQ records must be 4 lines; FASTA sequences may span multiple lines.
+//
+// A parser may be restricted to a byte range of the file, and partition()
+// splits a file into record-aligned ranges, so that many threads may parse
+// disjoint parts of one file concurrently, each with its own parser.
+class MappedReadParser: public ReadInputStream
+{
+public:
+    MappedReadParser            ();
+
+    // Parse reads from [begin, end) of the same mapping as other. begin and
+    // end must be record boundaries, e.g. from partition().
+    MappedReadParser            (const MappedReadParser &other,
+                                 size_t             begin,
+                                 size_t             end);
+
+    void
+    open                        (const char        *filename,
+                                 int                flags=MappedFile::MapDefault);
+
+    void
+    open                        (const std::string &filename,
+                                 int                flags=MappedFile::MapDefault);
+
+    bool
+    parse_read                  (Read              &the_read);
+
+    bool
+    parse_read_pair             (ReadPair          &the_read_pair);
+
+    // Returns n + 1 offsets, dividing this parser's range into n ranges of
+    // roughly equal size which each start at a record. If paired, ranges
+    // start at the first read of a pair. Pairs are found by mate names that
+    // are the same after removing /1 and /2 suffixes and comments, or where
+    // names don't tell, by counting records from the start of the previous
+    // range. Ranges may be empty.
+    std::vector<size_t>
+    partition                   (size_t             n,
+                                 bool               paired=false) const;
+
+    size_t
+    get_num_reads               ();
+
+protected:
+    std::shared_ptr<MappedFile> _file;
+    size_t                  _pos;
+    size_t                  _end;
+    size_t                  _num_reads;
+    bool                    _fastq;
+
+    bool
+    _parse_at                   (size_t            &pos,
+                                 Read              &the_read) const;
+
+    size_t
+    _next_record                (size_t             pos) const;
+
+    // Whether there are an odd number of records in [begin, pos)
+    bool
+    _odd_num_records              (size_t             begin,
+                                 size_t             pos) const;
+};
+
+} // namespace qcpp
+
+#endif /* QC_MMAP_HH */
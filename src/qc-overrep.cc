@@ -0,0 +1,321 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include <yaml-cpp/yaml.h>
+#include "qc-overrep.hh"
+
+#include <algorithm>
+#include <limits>
+
+namespace qcpp
+{
+
+// Heavy hitters keeps this many times more strings than are reported, so
+// that the reported ones have had time to displace rarer strings
+static const size_t candidates_per_report = 10;
+
+/*****************************************************************************
+ *                              CountMinSketch
+ *****************************************************************************/
+
+CountMinSketch::
+CountMinSketch(size_t width, size_t depth)
+    : _width(1)
+    , _depth(std::max<size_t>(depth, 1))
+{
+    while (_width < width) {
+        _width *= 2;
+    }
+    _counts.assign(_width * _depth, 0);
+}
+
+uint32_t
+CountMinSketch::
+add(uint64_t hash)
+{
+    uint32_t min = estimate(hash);
+
+    if (min == std::numeric_limits<uint32_t>::max()) {
+        return min;
+    }
+    for (size_t row = 0; row < _depth; row++) {
+        uint32_t &count = _counts[_index(hash, row)];
+        if (count == min) {
+            count++;
+        }
+    }
+    return min + 1;
+}
+
+uint32_t
+CountMinSketch::
+estimate(uint64_t hash) const
+{
+    uint32_t min = std::numeric_limits<uint32_t>::max();
+
+    for (size_t row = 0; row < _depth; row++) {
+        min = std::min(min, _counts[_index(hash, row)]);
+    }
+    return min;
+}
+
+void
+CountMinSketch::
+merge(const CountMinSketch &other)
+{
+    for (size_t i = 0; i < _counts.size(); i++) {
+        uint64_t sum = uint64_t(_counts[i]) + other._counts[i];
+        _counts[i] = std::min<uint64_t>(sum, std::numeric_limits<uint32_t>::max());
+    }
+}
+
+/*****************************************************************************
+ *                               HeavyHitters
+ *****************************************************************************/
+
+HeavyHitters::
+HeavyHitters(size_t capacity, size_t sketch_width, size_t sketch_depth)
+    : _sketch(sketch_width, sketch_depth)
+    , _capacity(std::max<size_t>(capacity, 1))
+    , _total(0)
+{
+}
+
+void
+HeavyHitters::
+add(const char *key, size_t len)
+{
+    const uint64_t hash = hash_bytes(key, len);
+    const uint32_t count = _sketch.add(hash);
+    auto it = _pos.find(hash);
+
+    _total++;
+    if (it != _pos.end()) {
+        _heap[it->second].count = count;
+        _sift_down(it->second);
+    } else if (_heap.size() < _capacity) {
+        _heap.push_back({std::string(key, len), hash, count});
+        _pos[hash] = _heap.size() - 1;
+        _sift_up(_heap.size() - 1);
+    } else if (count > _heap[0].count) {
+        _pos.erase(_heap[0].hash);
+        _heap[0].key.assign(key, len);
+        _heap[0].hash = hash;
+        _heap[0].count = count;
+        _pos[hash] = 0;
+        _sift_down(0);
+    }
+}
+
+void
+HeavyHitters::
+merge(const HeavyHitters &other)
+{
+    std::vector<Item> items;
+
+    _sketch.merge(other._sketch);
+    _total += other._total;
+
+    // Re-estimate both sets of strings with the merged sketch, and keep
+    // the most frequent
+    items.swap(_heap);
+    for (const Item &item: other._heap) {
+        if (_pos.count(item.hash) == 0) {
+            items.push_back(item);
+        }
+    }
+    for (Item &item: items) {
+        item.count = _sketch.estimate(item.hash);
+    }
+    std::sort(items.begin(), items.end(), [](const Item &a, const Item &b) {
+        return a.count > b.count;
+    });
+    items.resize(std::min(items.size(), _capacity));
+
+    _pos.clear();
+    for (Item &item: items) {
+        _heap.push_back(std::move(item));
+        _pos[_heap.back().hash] = _heap.size() - 1;
+        _sift_up(_heap.size() - 1);
+    }
+}
+
+std::vector<HeavyHitters::Item>
+HeavyHitters::
+top(size_t n) const
+{
+    std::vector<Item> items(_heap);
+
+    std::sort(items.begin(), items.end(), [](const Item &a, const Item &b) {
+        return a.count > b.count || (a.count == b.count && a.key < b.key);
+    });
+    items.resize(std::min(items.size(), n));
+    return items;
+}
+
+void
+HeavyHitters::
+_swap(size_t a, size_t b)
+{
+    std::swap(_heap[a], _heap[b]);
+    _pos[_heap[a].hash] = a;
+    _pos[_heap[b].hash] = b;
+}
+
+void
+HeavyHitters::
+_sift_down(size_t pos)
+{
+    while (true) {
+        size_t smallest = pos;
+        for (size_t child = 2 * pos + 1; child <= 2 * pos + 2; child++) {
+            if (child < _heap.size() && _heap[child].count < _heap[smallest].count) {
+                smallest = child;
+            }
+        }
+        if (smallest == pos) {
+            return;
+        }
+        _swap(pos, smallest);
+        pos = smallest;
+    }
+}
+
+void
+HeavyHitters::
+_sift_up(size_t pos)
+{
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (_heap[parent].count <= _heap[pos].count) {
+            return;
+        }
+        _swap(pos, parent);
+        pos = parent;
+    }
+}
+
+/*****************************************************************************
+ *                         OverrepresentedSequences
+ *****************************************************************************/
+
+OverrepresentedSequences::
+OverrepresentedSequences(const std::string &name, size_t prefix_length,
+                         size_t num_report, const QualityEncoding &encoding)
+    : ReadProcessor(name, encoding)
+    , _prefix_length(prefix_length)
+    , _num_report(num_report)
+    , _have_r2(false)
+    , _r1(num_report * candidates_per_report)
+    , _r2(num_report * candidates_per_report)
+{
+}
+
+void
+OverrepresentedSequences::
+_add(const Read &the_read, HeavyHitters &counts)
+{
+    const size_t len = std::min(the_read.size(), _prefix_length);
+
+    if (len > 0) {
+        counts.add(the_read.sequence.data(), len);
+    }
+}
+
+void
+OverrepresentedSequences::
+process_read(Read &the_read)
+{
+    _num_reads++;
+    _add(the_read, _r1);
+}
+
+void
+OverrepresentedSequences::
+process_read_pair(ReadPair &the_read_pair)
+{
+    _num_reads += 2;
+    _have_r2 = true;
+    _add(the_read_pair.first, _r1);
+    _add(the_read_pair.second, _r2);
+}
+
+void
+OverrepresentedSequences::
+add_stats_from(ReadProcessor *other_ptr)
+{
+    OverrepresentedSequences &other =
+        *reinterpret_cast<OverrepresentedSequences *>(other_ptr);
+
+    _num_reads += other._num_reads;
+    _have_r2 = _have_r2 || other._have_r2;
+    _r1.merge(other._r1);
+    _r2.merge(other._r2);
+}
+
+static void
+emit_top(YAML::Emitter &yml, const HeavyHitters &counts, size_t n)
+{
+    yml << YAML::BeginSeq;
+    for (const HeavyHitters::Item &item: counts.top(n)) {
+        double percent = 100.0 * item.count / counts.total();
+        yml << YAML::Flow << YAML::BeginMap
+            << YAML::Key << "sequence" << YAML::Value << item.key
+            << YAML::Key << "count" << YAML::Value << item.count
+            << YAML::Key << "percentage" << YAML::Value << percent
+            << YAML::EndMap;
+    }
+    yml << YAML::EndSeq;
+}
+
+std::string
+OverrepresentedSequences::
+yaml_report()
+{
+    std::ostringstream ss;
+    YAML::Emitter yml;
+
+    yml << YAML::BeginSeq;
+    yml << YAML::BeginMap;
+    yml << YAML::Key   << "OverrepresentedSequences"
+        << YAML::Value
+        << YAML::BeginMap
+        << YAML::Key   << "name"
+        << YAML::Value << _name
+        << YAML::Key   << "parameters"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "quality_encoding"
+                       << YAML::Value << _encoding.name
+                       << YAML::Key << "prefix_length"
+                       << YAML::Value << _prefix_length
+                       << YAML::Key << "num_report"
+                       << YAML::Value << _num_report
+                       << YAML::EndMap
+        << YAML::Key   << "output"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "num_reads"
+                       << YAML::Value << _num_reads
+                       << YAML::Key << "r1_sequences"
+                       << YAML::Value;
+    emit_top(yml, _r1, _num_report);
+    yml << YAML::Key << "r2_sequences" << YAML::Value;
+    if (_have_r2) {
+        emit_top(yml, _r2, _num_report);
+    } else {
+        yml << YAML::Flow << YAML::BeginSeq << YAML::EndSeq;
+    }
+    yml << YAML::EndMap
+        << YAML::EndMap;
+    yml << YAML::EndMap;
+    yml << YAML::EndSeq;
+    ss << yml.c_str() << "\n";
+    return ss.str();
+}
+
+} // namespace qcpp
@@ -0,0 +1,179 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_OVERREP_HH
+#define QC_OVERREP_HH
+
+#include "qc-config.hh"
+#include "qc-processor.hh"
+#include "qc-quality.hh"
+#include "qc-util.hh"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace qcpp
+{
+
+// Approximate counts of 64-bit hashes in depth rows of width counters (width
+// is rounded up to a power of two). Counts are never under-estimated, and are
+// over-estimated by about total / width at most, with high probability.
+// Counters are only incremented where they hold the hash's current estimate
+// (conservative update), which keeps over-estimates smaller.
+class CountMinSketch
+{
+public:
+    explicit
+    CountMinSketch                  (size_t             width=65536,
+                                     size_t             depth=4);
+
+    // Counts hash once more, returning its new estimate
+    uint32_t
+    add                             (uint64_t           hash);
+
+    uint32_t
+    estimate                        (uint64_t           hash) const;
+
+    // Adds other's counts. Both must have the same width and depth.
+    void
+    merge                           (const CountMinSketch &other);
+
+    size_t
+    memory_size                     () const
+    {
+        return _counts.size() * sizeof(_counts[0]);
+    }
+
+protected:
+    // Each row's counter for hash, by double hashing
+    size_t
+    _index                          (uint64_t           hash,
+                                     size_t             row) const
+    {
+        return row * _width + ((hash + row * ((hash >> 32) | 1)) & (_width - 1));
+    }
+
+    size_t                  _width;
+    size_t                  _depth;
+    std::vector<uint32_t>   _counts;
+};
+
+// The most frequent of a stream of strings, in bounded memory. Strings are
+// counted in a CountMinSketch, and up to capacity of those with the highest
+// estimates are kept in a min-heap (as in the Space-Saving algorithm, a new
+// string replaces the least frequent one once the heap is full). Counts are
+// upper bounds from the sketch.
+class HeavyHitters
+{
+public:
+    struct Item
+    {
+        std::string         key;
+        uint64_t            hash;
+        uint32_t            count;
+    };
+
+    explicit
+    HeavyHitters                    (size_t             capacity=200,
+                                     size_t             sketch_width=65536,
+                                     size_t             sketch_depth=4);
+
+    void
+    add                             (const char        *key,
+                                     size_t             len);
+
+    // Adds other's counts and strings, keeping the most frequent of both
+    void
+    merge                           (const HeavyHitters &other);
+
+    // The n most frequent strings, most frequent first
+    std::vector<Item>
+    top                             (size_t             n) const;
+
+    // The number of strings added
+    uint64_t
+    total                           () const
+    {
+        return _total;
+    }
+
+protected:
+    void
+    _sift_down                      (size_t             pos);
+
+    void
+    _sift_up                        (size_t             pos);
+
+    void
+    _swap                           (size_t             a,
+                                     size_t             b);
+
+    CountMinSketch          _sketch;
+    size_t                  _capacity;
+    uint64_t                _total;
+    // A min-heap on count, and the position of each hash in it
+    std::vector<Item>       _heap;
+    std::unordered_map<uint64_t, size_t> _pos;
+};
+
+// Finds the most common read prefixes (the first prefix_length bases, or
+// whole reads if shorter), like FastQC's overrepresented sequences. R1 and
+// R2 are counted separately. The num_report most frequent of each are
+// reported, with their counts and the percentage of reads they make up.
+// Memory use is fixed: about 1MB of sketch, plus 10 * num_report prefixes,
+// for each of R1 and R2.
+class OverrepresentedSequences: public ReadProcessor
+{
+public:
+    OverrepresentedSequences        (const std::string &name,
+                                     size_t             prefix_length=50,
+                                     size_t             num_report=20,
+                                     const QualityEncoding &encoding=SangerEncoding);
+
+    void
+    process_read                    (Read              &the_read);
+
+    void
+    process_read_pair               (ReadPair          &the_read_pair);
+
+    void
+    add_stats_from                  (ReadProcessor     *other_ptr);
+
+    std::string
+    yaml_report                     ();
+
+    // The num_report most common R1 (or single end) or R2 prefixes
+    std::vector<HeavyHitters::Item>
+    top_r1                          () const
+    {
+        return _r1.top(_num_report);
+    }
+
+    std::vector<HeavyHitters::Item>
+    top_r2                          () const
+    {
+        return _r2.top(_num_report);
+    }
+
+private:
+    void
+    _add                            (const Read        &the_read,
+                                     HeavyHitters      &counts);
+
+    size_t                  _prefix_length;
+    size_t                  _num_report;
+    bool                    _have_r2;
+    HeavyHitters            _r1;
+    HeavyHitters            _r2;
+};
+
+} // namespace qcpp
+
+#endif /* QC_OVERREP_HH */
@@ -0,0 +1,390 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "qc-packed.hh"
+
+#include <algorithm>
+#include <cstring>
+
+namespace qcpp
+{
+
+// Eight bases at a time are handled as the bytes of a 64-bit word, which
+// relies on the first base being the word's lowest byte.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#   define QCPP_PACK_WORDS 1
+#else
+#   define QCPP_PACK_WORDS 0
+#endif
+
+static const uint64_t ones = 0x0101010101010101ULL;
+static const char code_bases[] = "ACTG";
+
+// 0x80 in each byte of x that is zero, and 0 in the others
+static inline uint64_t
+zero_bytes(uint64_t x)
+{
+    const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+    return ~(((x & low7) + low7) | x | low7);
+}
+
+// Whether all eight bytes are one of A, C, G or T
+static inline bool
+all_acgt(uint64_t bytes)
+{
+    uint64_t found = zero_bytes(bytes ^ (ones * 'A')) |
+                     zero_bytes(bytes ^ (ones * 'C')) |
+                     zero_bytes(bytes ^ (ones * 'G')) |
+                     zero_bytes(bytes ^ (ones * 'T'));
+    return found == ones * 0x80;
+}
+
+// Packs eight bases into 16 bits
+static inline uint64_t
+pack8(uint64_t bytes)
+{
+    uint64_t x = (bytes >> 1) & (ones * 3);
+    x = (x | (x >> 6)) & 0x000F000F000F000FULL;
+    x = (x | (x >> 12)) & 0x000000FF000000FFULL;
+    x = (x | (x >> 24)) & 0xFFFFULL;
+    return x;
+}
+
+// Unpacks 16 bits into eight bases
+static inline uint64_t
+unpack8(uint64_t bits)
+{
+    uint64_t x = bits;
+    x = (x | (x << 24)) & 0x000000FF000000FFULL;
+    x = (x | (x << 12)) & 0x000F000F000F000FULL;
+    x = (x | (x << 6)) & 0x0303030303030303ULL;
+    // A = 0x41, C = 0x43, T = 0x54, G = 0x47
+    uint64_t b0 = x & ones;
+    uint64_t b1 = (x >> 1) & ones;
+    return ones * 'A' + 2 * b0 + 0x13 * b1 - 0x0F * (b0 & b1);
+}
+
+static inline char
+complement(char base)
+{
+    switch (base) {
+        case 'A': return 'T';
+        case 'C': return 'G';
+        case 'G': return 'C';
+        case 'T': return 'A';
+        case 'a': return 't';
+        case 'c': return 'g';
+        case 'g': return 'c';
+        case 't': return 'a';
+        case 'R': return 'Y';
+        case 'Y': return 'R';
+        case 'K': return 'M';
+        case 'M': return 'K';
+        case 'B': return 'V';
+        case 'V': return 'B';
+        case 'D': return 'H';
+        case 'H': return 'D';
+        case 'r': return 'y';
+        case 'y': return 'r';
+        case 'k': return 'm';
+        case 'm': return 'k';
+        case 'b': return 'v';
+        case 'v': return 'b';
+        case 'd': return 'h';
+        case 'h': return 'd';
+        default: return base;
+    }
+}
+
+uint64_t
+kmer_reverse_complement(uint64_t kmer, size_t k)
+{
+    if (k == 0) {
+        return 0;
+    }
+    // Complement every base, then reverse the order of the 32 bases in the
+    // word, leaving ours at the top.
+    uint64_t x = kmer ^ 0xAAAAAAAAAAAAAAAAULL;
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+    x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+    x = (x >> 32) | (x << 32);
+    return x >> (64 - 2 * k);
+}
+
+/*****************************************************************************
+ *                              PackedSequence
+ *****************************************************************************/
+
+PackedSequence::
+PackedSequence()
+    : _size(0)
+{
+}
+
+PackedSequence::
+PackedSequence(const std::string &sequence)
+    : _size(0)
+{
+    pack(sequence);
+}
+
+void
+PackedSequence::
+pack(const std::string &sequence)
+{
+    pack(sequence.data(), sequence.size());
+}
+
+void
+PackedSequence::
+pack(const char *sequence, size_t length)
+{
+    size_t i = 0;
+
+    _size = length;
+    _words.assign((length + 31) / 32, 0);
+    _ambiguous.clear();
+
+    // i stays a multiple of 8, so eight bases never span two words
+    while (i + 8 <= length) {
+#if QCPP_PACK_WORDS
+        uint64_t bytes;
+        memcpy(&bytes, sequence + i, 8);
+        if (all_acgt(bytes)) {
+            _words[i / 32] |= pack8(bytes) << (2 * (i % 32));
+            i += 8;
+            continue;
+        }
+#endif
+        for (size_t end = i + 8; i < end; i++) {
+            const char base = sequence[i];
+            if (base == 'A' || base == 'C' || base == 'G' || base == 'T') {
+                _words[i / 32] |= uint64_t((base >> 1) & 3) << (2 * (i % 32));
+            } else {
+                _ambiguous.emplace_back(i, base);
+            }
+        }
+    }
+    for (; i < length; i++) {
+        const char base = sequence[i];
+        if (base == 'A' || base == 'C' || base == 'G' || base == 'T') {
+            _words[i / 32] |= uint64_t((base >> 1) & 3) << (2 * (i % 32));
+        } else {
+            _ambiguous.emplace_back(i, base);
+        }
+    }
+}
+
+void
+PackedSequence::
+unpack(std::string &sequence) const
+{
+    sequence.clear();
+    append_to(sequence);
+}
+
+void
+PackedSequence::
+append_to(std::string &buffer) const
+{
+    const size_t start = buffer.size();
+    size_t i = 0;
+
+    buffer.resize(start + _size);
+    char *out = &buffer[start];
+#if QCPP_PACK_WORDS
+    for (; i + 8 <= _size; i += 8) {
+        uint64_t bytes = unpack8((_words[i / 32] >> (2 * (i % 32))) & 0xFFFF);
+        memcpy(out + i, &bytes, 8);
+    }
+#endif
+    for (; i < _size; i++) {
+        out[i] = code_bases[code(i)];
+    }
+    for (const auto &base: _ambiguous) {
+        out[base.first] = base.second;
+    }
+}
+
+std::string
+PackedSequence::
+str() const
+{
+    std::string sequence;
+    append_to(sequence);
+    return sequence;
+}
+
+void
+PackedSequence::
+clear()
+{
+    _words.clear();
+    _ambiguous.clear();
+    _size = 0;
+}
+
+char
+PackedSequence::
+at(size_t i) const
+{
+    auto it = std::lower_bound(_ambiguous.begin(), _ambiguous.end(),
+                               std::make_pair(uint32_t(i), '\0'));
+    if (it != _ambiguous.end() && it->first == i) {
+        return it->second;
+    }
+    return code_bases[code(i)];
+}
+
+bool
+PackedSequence::
+is_ambiguous(size_t i) const
+{
+    return has_ambiguous(i, 1);
+}
+
+bool
+PackedSequence::
+has_ambiguous(size_t pos, size_t length) const
+{
+    auto it = std::lower_bound(_ambiguous.begin(), _ambiguous.end(),
+                               std::make_pair(uint32_t(pos), '\0'));
+    return it != _ambiguous.end() && it->first < pos + length;
+}
+
+uint64_t
+PackedSequence::
+kmer(size_t pos, size_t k) const
+{
+    const size_t word = pos / 32;
+    const size_t shift = 2 * (pos % 32);
+    uint64_t bits = _words[word] >> shift;
+
+    if (shift + 2 * k > 64) {
+        bits |= _words[word + 1] << (64 - shift);
+    }
+    if (k < 32) {
+        bits &= (uint64_t(1) << (2 * k)) - 1;
+    }
+    return bits;
+}
+
+PackedSequence
+PackedSequence::
+reverse_complement() const
+{
+    PackedSequence rc;
+
+    rc._size = _size;
+    rc._words.assign(_words.size(), 0);
+    for (size_t i = 0; i < _words.size(); i++) {
+        // Word i of the result holds the reverse complement of the bases
+        // ending at _size - 32 * i
+        const size_t k = std::min<size_t>(32, _size - 32 * i);
+        rc._words[i] = kmer_reverse_complement(kmer(_size - 32 * i - k, k), k);
+    }
+    for (auto it = _ambiguous.rbegin(); it != _ambiguous.rend(); ++it) {
+        const size_t pos = _size - 1 - it->first;
+        // Ambiguous bases are packed as A
+        rc._words[pos / 32] &= ~(uint64_t(3) << (2 * (pos % 32)));
+        rc._ambiguous.emplace_back(pos, complement(it->second));
+    }
+    return rc;
+}
+
+size_t
+PackedSequence::
+memory_size() const
+{
+    return _words.size() * sizeof(uint64_t) +
+           _ambiguous.size() * sizeof(_ambiguous[0]);
+}
+
+bool
+operator==(const PackedSequence &a, const PackedSequence &b)
+{
+    return a._size == b._size && a._words == b._words &&
+           a._ambiguous == b._ambiguous;
+}
+
+/*****************************************************************************
+ *                                PackedRead
+ *****************************************************************************/
+
+PackedRead::
+PackedRead()
+{
+}
+
+PackedRead::
+PackedRead(const Read &read)
+{
+    pack(read);
+}
+
+void
+PackedRead::
+pack(const Read &read)
+{
+    name = read.name;
+    sequence.pack(read.sequence);
+    quality = read.quality;
+}
+
+void
+PackedRead::
+unpack(Read &read) const
+{
+    read.name = name;
+    sequence.unpack(read.sequence);
+    read.quality = quality;
+}
+
+void
+PackedRead::
+append_to(std::string &buffer) const
+{
+    if (name.size() == 0 || sequence.size() == 0) {
+        return;
+    }
+    buffer += quality.size() > 0 ? '@' : '>';
+    buffer += name;
+    buffer += '\n';
+    sequence.append_to(buffer);
+    buffer += '\n';
+    if (quality.size() > 0) {
+        buffer += "+\n";
+        buffer += quality;
+        buffer += '\n';
+    }
+}
+
+bool
+parse_chunk(ReadInputStream &stream, std::vector<PackedRead> &chunk,
+            size_t max_reads)
+{
+    Read read;
+
+    for (size_t i = 0; i < max_reads; i++) {
+        if (!stream.parse_read(read)) {
+            chunk.resize(i);
+            return false;
+        }
+        if (i == chunk.size()) {
+            chunk.emplace_back();
+        }
+        chunk[i].pack(read);
+    }
+    chunk.resize(max_reads);
+    return true;
+}
+
+} // namespace qcpp
@@ -0,0 +1,182 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_PACKED_HH
+#define QC_PACKED_HH
+
+#include "qc-config.hh"
+#include "qc-io.hh"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace qcpp
+{
+
+// A DNA sequence packed two bits per base, 32 bases per 64-bit word. Base i
+// is held in bits 2*(i%32) and up of word i/32, so the first base of a word
+// is its lowest. Bases are coded from bits 1-2 of their ASCII value:
+//
+//   A = 0, C = 1, T = 2, G = 3
+//
+// so a base's complement is its code XOR 2. Anything other than upper case
+// A, C, G or T (N, IUPAC ambiguity codes, lower case) is packed as A, and
+// kept with its position in a sparse list, so unpacking gives back exactly
+// the original sequence.
+//
+// Packing and unpacking work on eight bases at a time within a 64-bit word,
+// falling back to single bases only around ambiguous ones.
+class PackedSequence
+{
+public:
+    PackedSequence                  ();
+
+    explicit
+    PackedSequence                  (const std::string &sequence);
+
+    void
+    pack                            (const std::string &sequence);
+
+    void
+    pack                            (const char        *sequence,
+                                     size_t             length);
+
+    // Replaces sequence with the unpacked bases
+    void
+    unpack                          (std::string       &sequence) const;
+
+    // Appends the unpacked bases to buffer
+    void
+    append_to                       (std::string       &buffer) const;
+
+    std::string
+    str                             () const;
+
+    void
+    clear                           ();
+
+    size_t
+    size                            () const
+    {
+        return _size;
+    }
+
+    // The 2-bit code of base i (A for ambiguous bases)
+    uint8_t
+    code                            (size_t             i) const
+    {
+        return (_words[i / 32] >> (2 * (i % 32))) & 3;
+    }
+
+    // The original base at i
+    char
+    at                              (size_t             i) const;
+
+    bool
+    is_ambiguous                    (size_t             i) const;
+
+    // Whether any base in [pos, pos + length) is ambiguous
+    bool
+    has_ambiguous                   (size_t             pos,
+                                     size_t             length) const;
+
+    size_t
+    num_ambiguous                   () const
+    {
+        return _ambiguous.size();
+    }
+
+    // The position and original base of each ambiguous base, in order of
+    // position
+    const std::vector<std::pair<uint32_t, char>> &
+    ambiguous                       () const
+    {
+        return _ambiguous;
+    }
+
+    // The k bases from pos (k <= 32) as one word, with base pos in the
+    // lowest bits. Ambiguous bases are included as A; check them with
+    // has_ambiguous().
+    uint64_t
+    kmer                            (size_t             pos,
+                                     size_t             k) const;
+
+    PackedSequence
+    reverse_complement              () const;
+
+    // The packed bases, with any bits past size() zeroed
+    const std::vector<uint64_t> &
+    words                           () const
+    {
+        return _words;
+    }
+
+    // Bytes used by the packed bases and the ambiguous base list
+    size_t
+    memory_size                     () const;
+
+    friend bool operator==(const PackedSequence &a, const PackedSequence &b);
+
+protected:
+    std::vector<uint64_t>   _words;
+    size_t                  _size;
+    // Position and original base of each base that isn't A, C, G or T, in
+    // order of position
+    std::vector<std::pair<uint32_t, char>> _ambiguous;
+};
+
+bool operator==(const PackedSequence &a, const PackedSequence &b);
+
+// The reverse complement of a k-mer from PackedSequence::kmer()
+uint64_t kmer_reverse_complement(uint64_t kmer, size_t k);
+
+// A Read whose sequence is packed. Names and qualities are kept as they are.
+class PackedRead
+{
+public:
+    std::string             name;
+    PackedSequence          sequence;
+    std::string             quality;
+
+    PackedRead                      ();
+
+    explicit
+    PackedRead                      (const Read        &read);
+
+    void
+    pack                            (const Read        &read);
+
+    void
+    unpack                          (Read              &read) const;
+
+    size_t
+    size                            () const
+    {
+        return sequence.size();
+    }
+
+    // Appends this read as Read::append_to() would, unpacking the sequence
+    // straight into buffer.
+    void
+    append_to                       (std::string       &buffer) const;
+};
+
+// Replaces the contents of chunk with up to max_reads reads of stream, packed.
+// As with ReadInputStream::parse_chunk(), reads already in chunk are packed
+// over in place. Returns false once the end of the input has been reached,
+// though chunk may still hold the final reads.
+bool parse_chunk(ReadInputStream &stream, std::vector<PackedRead> &chunk,
+                 size_t max_reads);
+
+} // namespace qcpp
+
+#endif /* QC_PACKED_HH */
@@ -0,0 +1,202 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include <yaml-cpp/yaml.h>
+#include "qc-polyx.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+
+namespace qcpp
+{
+
+// Tails may have one mismatch in every 8 bases, and at most 5
+static const size_t bases_per_mismatch = 8;
+static const size_t max_mismatches = 5;
+static const size_t block_size = 16;
+
+static inline size_t
+allowed_mismatches(size_t tail_length)
+{
+    return std::min(tail_length / bases_per_mismatch, max_mismatches);
+}
+
+// The number of bases of the block at p that aren't base. A fixed-length
+// compare-and-add loop, which the compiler vectorises into a byte-wise
+// equality mask and a horizontal sum; a byte-sized count keeps it from
+// widening each comparison instead.
+static inline size_t
+block_mismatches(const char *p, char base)
+{
+    uint8_t n = 0;
+    for (size_t i = 0; i < block_size; i++) {
+        n += p[i] != base;
+    }
+    return n;
+}
+
+PolyXTrim::
+PolyXTrim(const std::string &name, const std::string &bases, size_t min_length,
+          const QualityEncoding &encoding)
+    : ReadProcessor(name, encoding)
+    , _min_length(std::max<size_t>(min_length, 1))
+    , _num_trimmed(0)
+    , _bases_trimmed(0)
+{
+    std::fill(_is_tail_base, _is_tail_base + 256, false);
+    for (char base: bases) {
+        base = toupper(base);
+        if (!_is_tail_base[(unsigned char)base]) {
+            _is_tail_base[(unsigned char)base] = true;
+            _bases += base;
+            _base_counts[base] = 0;
+        }
+    }
+}
+
+size_t
+PolyXTrim::
+tail_start(const std::string &sequence) const
+{
+    const char *seq = sequence.data();
+    const size_t len = sequence.size();
+    size_t start = len, mismatches = 0;
+
+    // The last base may not be a mismatch, so is the only possible tail base
+    if (len == 0 || !_is_tail_base[(unsigned char)seq[len - 1]]) {
+        return len;
+    }
+    const char base = seq[len - 1];
+    while (start > 0) {
+        // A block is taken whole if its mismatches are within the allowance
+        // at its 3'-most base, the least within it. Otherwise the tail is
+        // extended by one base, to find exactly where the allowance is
+        // exceeded.
+        if (start >= block_size) {
+            const size_t n = block_mismatches(seq + start - block_size, base);
+            if (mismatches + n <= allowed_mismatches(len - start + 1)) {
+                mismatches += n;
+                start -= block_size;
+                continue;
+            }
+        }
+        mismatches += seq[start - 1] != base;
+        if (mismatches > allowed_mismatches(len - start + 1)) {
+            break;
+        }
+        start--;
+    }
+    // Mismatches at the 5' end of the tail are kept
+    while (seq[start] != base) {
+        start++;
+    }
+    return start;
+}
+
+void
+PolyXTrim::
+_trim_read(Read &the_read)
+{
+    const size_t start = tail_start(the_read.sequence);
+    const size_t length = the_read.size() - start;
+
+    if (length < _min_length) {
+        return;
+    }
+    _num_trimmed++;
+    _bases_trimmed += length;
+    _base_counts[the_read.sequence[start]]++;
+    _length_counts[length]++;
+    the_read.erase(start);
+}
+
+void
+PolyXTrim::
+process_read(Read &the_read)
+{
+    _num_reads++;
+    _trim_read(the_read);
+}
+
+void
+PolyXTrim::
+process_read_pair(ReadPair &the_read_pair)
+{
+    _num_reads += 2;
+    _trim_read(the_read_pair.first);
+    _trim_read(the_read_pair.second);
+}
+
+void
+PolyXTrim::
+add_stats_from(ReadProcessor *other_ptr)
+{
+    PolyXTrim &other = *reinterpret_cast<PolyXTrim *>(other_ptr);
+
+    _num_reads += other._num_reads;
+    _num_trimmed += other._num_trimmed;
+    _bases_trimmed += other._bases_trimmed;
+    for (const auto &count: other._base_counts) {
+        _base_counts[count.first] += count.second;
+    }
+    for (const auto &count: other._length_counts) {
+        _length_counts[count.first] += count.second;
+    }
+}
+
+std::string
+PolyXTrim::
+yaml_report()
+{
+    std::ostringstream ss;
+    YAML::Emitter yml;
+    std::map<std::string, size_t> base_counts;
+
+    for (const auto &count: _base_counts) {
+        base_counts[std::string(1, count.first)] = count.second;
+    }
+
+    yml << YAML::BeginSeq;
+    yml << YAML::BeginMap;
+    yml << YAML::Key   << "PolyXTrim"
+        << YAML::Value
+        << YAML::BeginMap
+        << YAML::Key   << "name"
+        << YAML::Value << _name
+        << YAML::Key   << "parameters"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "quality_encoding"
+                       << YAML::Value << _encoding.name
+                       << YAML::Key << "bases"
+                       << YAML::Value << _bases
+                       << YAML::Key << "min_length"
+                       << YAML::Value << _min_length
+                       << YAML::EndMap
+        << YAML::Key   << "output"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "num_reads"
+                       << YAML::Value << _num_reads
+                       << YAML::Key << "num_trimmed"
+                       << YAML::Value << _num_trimmed
+                       << YAML::Key << "bases_trimmed"
+                       << YAML::Value << _bases_trimmed
+                       << YAML::Key << "trimmed_by_base"
+                       << YAML::Value << YAML::Flow << base_counts
+                       << YAML::Key << "tail_lengths"
+                       << YAML::Value << YAML::Flow << _length_counts
+                       << YAML::EndMap
+        << YAML::EndMap;
+    yml << YAML::EndMap;
+    yml << YAML::EndSeq;
+    ss << yml.c_str() << "\n";
+    return ss.str();
+}
+
+} // namespace qcpp
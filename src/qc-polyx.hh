@@ -0,0 +1,82 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_POLYX_HH
+#define QC_POLYX_HH
+
+#include "qc-config.hh"
+#include "qc-processor.hh"
+#include "qc-quality.hh"
+
+#include <map>
+#include <string>
+
+namespace qcpp
+{
+
+// Trims homopolymer tails from the 3' end of reads, such as the poly-G tails
+// of two-colour chemistry, whose bases are of high quality and so pass
+// WindowedQualTrim. A tail of one of bases is scanned from the last base of
+// the read towards the 5' end, allowing one mismatch in every 8 bases (at most
+// 5), and must start with the tail base. Tails of at least min_length bases
+// are trimmed; both reads of a pair are trimmed separately.
+class PolyXTrim: public ReadProcessor
+{
+public:
+    PolyXTrim                       (const std::string &name,
+                                     const std::string &bases="ACGT",
+                                     size_t             min_length=10,
+                                     const QualityEncoding &encoding=SangerEncoding);
+
+    void
+    process_read                    (Read              &the_read);
+
+    void
+    process_read_pair               (ReadPair          &the_read_pair);
+
+    void
+    add_stats_from                  (ReadProcessor     *other_ptr);
+
+    std::string
+    yaml_report                     ();
+
+    // The start of sequence's 3' tail of one of our bases (or its length, if
+    // there is none), whatever the tail's length
+    size_t
+    tail_start                      (const std::string &sequence) const;
+
+    size_t
+    num_trimmed                     () const
+    {
+        return _num_trimmed;
+    }
+
+    size_t
+    bases_trimmed                   () const
+    {
+        return _bases_trimmed;
+    }
+
+private:
+    void
+    _trim_read                      (Read              &the_read);
+
+    std::string             _bases;
+    bool                    _is_tail_base[256];
+    size_t                  _min_length;
+    size_t                  _num_trimmed;
+    size_t                  _bases_trimmed;
+    // Reads trimmed by tail base, and by tail length
+    std::map<char, size_t>  _base_counts;
+    std::map<size_t, size_t> _length_counts;
+};
+
+} // namespace qcpp
+
+#endif /* QC_POLYX_HH */
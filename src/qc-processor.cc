@@ -9,6 +9,11 @@
 
 #include "qc-processor.hh"
 
+#include <algorithm>
+#include <chrono>
+
+#include <yaml-cpp/yaml.h>
+
 namespace qcpp
 {
 
@@ -99,6 +104,13 @@ open(const std::string &filename)
     _parser.open(filename);
 }
 
+void
+ProcessedReadStream::
+open(const std::string &filename, const AsyncIOOptions &aio)
+{
+    _parser.open(filename, aio);
+}
+
 bool
 ProcessedReadStream::
 parse_read(Read &the_read)
@@ -148,28 +160,248 @@ report()
     return _pipeline.report();
 }
 
+/////////////////////////////  Output Policies //////////////////////////////
+
+void
+PairedOutput::
+format(ReadPair &the_read_pair, std::string &output, std::string &orphans)
+{
+    std::ignore = orphans;
+    the_read_pair.append_to(output);
+}
+
+void
+PairedOutput::
+select(std::vector<ReadPair> &chunk, std::vector<ReadPair> &output,
+       std::vector<Read> &orphans)
+{
+    std::ignore = orphans;
+    for (ReadPair &the_read_pair: chunk) {
+        if (the_read_pair.fill_placeholders()) {
+            output.emplace_back(std::move(the_read_pair));
+        }
+    }
+}
+
+BrokenPairedOutput::
+BrokenPairedOutput(size_t min_length)
+    : _min_length(min_length)
+{
+}
+
+void
+BrokenPairedOutput::
+format(ReadPair &the_read_pair, std::string &output, std::string &orphans)
+{
+    bool keep_r1 = the_read_pair.first.size() > 0 &&
+                   the_read_pair.first.size() >= _min_length;
+    bool keep_r2 = the_read_pair.second.size() > 0 &&
+                   the_read_pair.second.size() >= _min_length;
+
+    if (keep_r1 && keep_r2) {
+        the_read_pair.first.append_to(output);
+        the_read_pair.second.append_to(output);
+    } else if (keep_r1) {
+        the_read_pair.first.append_to(orphans);
+    } else if (keep_r2) {
+        the_read_pair.second.append_to(orphans);
+    }
+}
+
+void
+BrokenPairedOutput::
+select(std::vector<ReadPair> &chunk, std::vector<ReadPair> &output,
+       std::vector<Read> &orphans)
+{
+    for (ReadPair &the_read_pair: chunk) {
+        bool keep_r1 = the_read_pair.first.size() > 0 &&
+                       the_read_pair.first.size() >= _min_length;
+        bool keep_r2 = the_read_pair.second.size() > 0 &&
+                       the_read_pair.second.size() >= _min_length;
+
+        if (keep_r1 && keep_r2) {
+            output.emplace_back(std::move(the_read_pair));
+        } else if (keep_r1) {
+            orphans.emplace_back(std::move(the_read_pair.first));
+        } else if (keep_r2) {
+            orphans.emplace_back(std::move(the_read_pair.second));
+        }
+    }
+}
+
+void
+SingleOutput::
+format(Read &the_read, std::string &output, std::string &orphans)
+{
+    std::ignore = orphans;
+    the_read.append_to(output);
+}
+
+void
+SingleOutput::
+select(std::vector<Read> &chunk, std::vector<Read> &output,
+       std::vector<Read> &orphans)
+{
+    std::ignore = orphans;
+    for (Read &the_read: chunk) {
+        if (the_read.size() > 0) {
+            output.emplace_back(std::move(the_read));
+        }
+    }
+}
+
+////////////////////////////////  ChunkSizer /////////////////////////////////
+
+ChunkSizer::
+ChunkSizer(size_t min_size, size_t max_size, double target_seconds)
+    : _read_cost(0)
+    , _min_size(min_size)
+    , _max_size(max_size)
+    , _target_seconds(target_seconds)
+{
+}
+
+void
+ChunkSizer::
+record(double seconds, size_t n_reads)
+{
+    if (n_reads == 0) {
+        return;
+    }
+    // Racing updates from several workers may lose a sample, which doesn't
+    // matter for an estimate.
+    const double cost = seconds / n_reads;
+    const double average = _read_cost;
+    _read_cost = average > 0 ? 0.75 * average + 0.25 * cost : cost;
+}
+
+size_t
+ChunkSizer::
+next(bool may_idle) const
+{
+    const double cost = _read_cost;
+    double size = _min_size;
+
+    if (cost > 0) {
+        size = _target_seconds / cost;
+    }
+    if (may_idle) {
+        size /= 2;
+    }
+    size = std::max(size, static_cast<double>(_min_size));
+    size = std::min(size, static_cast<double>(_max_size));
+    return static_cast<size_t>(size);
+}
+
 /////////////////////////////  ThreadedQCProcessor ////////////////////////////
 
-ThreadedQCProcessor::
-ThreadedQCProcessor(std::string &input, std::ostream *output,
-                    size_t worker_threads)
+// Overloads used to process either reads or read pairs in
+// BasicThreadedQCProcessor
+static inline void
+process_one(ReadProcessorPipeline &pipeline, Read &the_read)
+{
+    pipeline.process_read(the_read);
+}
+
+static inline void
+process_one(ReadProcessorPipeline &pipeline, ReadPair &the_read_pair)
+{
+    pipeline.process_read_pair(the_read_pair);
+}
+
+// Pooled reads are given room for reads of this length, which longer reads
+// grow beyond
+static const size_t pooled_read_length = 256;
+
+static inline void
+reserve_one(Read &the_read)
+{
+    the_read.name.reserve(pooled_read_length / 4);
+    the_read.sequence.reserve(pooled_read_length);
+    the_read.quality.reserve(pooled_read_length);
+}
+
+static inline void
+reserve_one(ReadPair &the_read_pair)
+{
+    reserve_one(the_read_pair.first);
+    reserve_one(the_read_pair.second);
+}
+
+template<typename ReadType>
+BasicThreadedQCProcessor<ReadType>::
+BasicThreadedQCProcessor(std::string &input, std::ostream *output,
+                         size_t worker_threads)
     : _num_reads(0)
-    , _output(output)
+    , _policy(new typename DefaultOutputPolicy<ReadType>::type)
+    , _input_file(input)
+    , _parser(new ReadParser)
+    , _next_range(0)
+    , _stream_output(new StreamReadWriter(output))
     , _num_threads(worker_threads)
     , _input_complete(false)
     , _output_complete(0)
-    , _chunksize(8192)
+    , _failed(false)
+    , _numa_placement(false)
+    , _num_queued(0)
+    , _run_seconds(0)
 {
-    _input.open(input);
+    _parser->open(input);
+    _input = _parser.get();
+    _output = _orphan_output = _stream_output.get();
     for (size_t i = 0; i < _num_threads; i++) {
         _pipelines.emplace_back();
+        _queues.emplace_back(new WorkQueue);
     }
+    _stats.resize(_num_threads);
 }
 
+template<typename ReadType>
+BasicThreadedQCProcessor<ReadType>::
+BasicThreadedQCProcessor(ReadInputStream &input, ReadOutputStream &output,
+                         size_t worker_threads)
+    : _num_reads(0)
+    , _policy(new typename DefaultOutputPolicy<ReadType>::type)
+    , _input(&input)
+    , _next_range(0)
+    , _output(&output)
+    , _orphan_output(&output)
+    , _num_threads(worker_threads)
+    , _input_complete(false)
+    , _output_complete(0)
+    , _failed(false)
+    , _numa_placement(false)
+    , _num_queued(0)
+    , _run_seconds(0)
+{
+    for (size_t i = 0; i < _num_threads; i++) {
+        _pipelines.emplace_back();
+        _queues.emplace_back(new WorkQueue);
+    }
+    _stats.resize(_num_threads);
+}
+
+template<typename ReadType>
 void
-ThreadedQCProcessor::
-writer(ThreadedQCProcessor *self)
+BasicThreadedQCProcessor<ReadType>::
+_set_error(std::exception_ptr error)
 {
+    std_mutex_lock lg(_error_mutex);
+    if (!_error) {
+        _error = error;
+    }
+    _failed = true;
+}
+
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+writer(BasicThreadedQCProcessor *self)
+{
+    ReadChunk output;
+    std::vector<Read> orphans;
+
+    _pin(self->_layout.writer);
     while (true) {
         std::unique_lock<std::mutex> lock(self->_out_mutex);
         while (self->_out_queue.empty()) {
@@ -178,116 +410,550 @@ writer(ThreadedQCProcessor *self)
             }
             self->_out_cv.wait_for(lock, std::chrono::microseconds(1));
         }
-        ReadChunk chunk = self->_out_queue.front();
+        ReadChunk chunk(std::move(self->_out_queue.front().first));
+        const size_t node = self->_out_queue.front().second;
         self->_out_queue.pop();
 
         lock.unlock();
-
-        for (ReadPair &rp: chunk) {
-            (*self->_output) <<  rp.str();
+        self->_out_cv.notify_all();
+
+        size_t n_reads = chunk.size();
+        // After an error, here or in a worker, keep taking chunks so that no
+        // thread waits on the writer, but don't write them.
+        if (!self->_failed) {
+            try {
+                output.clear();
+                orphans.clear();
+                self->_policy->select(chunk, output, orphans);
+                if (output.size() > 0) {
+                    self->_output->write_chunk(output);
+                }
+                if (orphans.size() > 0) {
+                    self->_orphan_output->write_chunk(orphans);
+                }
+            } catch (...) {
+                self->_set_error(std::current_exception());
+            }
         }
-        self->_num_reads += chunk.size();
+
+        self->_put_chunk(node, chunk);
+
+        self->_num_reads += n_reads;
         if (self->_progress_cb) {
             self->_progress_cb(self->_num_reads);
         }
     }
 }
 
+template<typename ReadType>
+bool
+BasicThreadedQCProcessor<ReadType>::
+_take_chunk(size_t thread_id, ReadChunk &chunk, bool &stolen)
+{
+    const std::vector<size_t> &order = _steal_order[thread_id];
+
+    // Our own chunks are taken oldest first, and others' newest first, so
+    // that owner and thief rarely contend for the same end of a queue.
+    for (size_t i = 0; i < order.size(); i++) {
+        WorkQueue &queue = *_queues[order[i]];
+        std_mutex_lock lg(queue.mutex);
+        if (queue.chunks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            chunk = std::move(queue.chunks.front());
+            queue.chunks.pop_front();
+        } else {
+            chunk = std::move(queue.chunks.back());
+            queue.chunks.pop_back();
+        }
+        _num_queued--;
+        stolen = i > 0;
+        return true;
+    }
+    return false;
+}
+
+template<typename ReadType>
 void
-ThreadedQCProcessor::
-worker(ThreadedQCProcessor *self, size_t thread_id)
+BasicThreadedQCProcessor<ReadType>::
+_record_chunk(size_t thread_id, double seconds, size_t n_reads)
 {
+    WorkerStats &stats = _stats[thread_id];
+
+    stats.busy_seconds += seconds;
+    stats.chunks++;
+    stats.reads += n_reads;
+    _chunk_sizer.record(seconds, n_reads);
+}
+
+template<typename ReadType>
+size_t
+BasicThreadedQCProcessor<ReadType>::
+_next_chunksize()
+{
+    return _chunk_sizer.next(_num_queued < _num_threads);
+}
+
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+_setup_layout()
+{
+    if (_numa_placement) {
+        _layout = ThreadLayout::plan(CpuTopology::detect(), _num_threads);
+    } else {
+        _layout = ThreadLayout::unpinned(_num_threads);
+    }
+
+    _pools.clear();
+    for (size_t i = 0; i < _layout.num_nodes(); i++) {
+        _pools.emplace_back(new ChunkPool);
+    }
+
+    _steal_order.clear();
+    for (size_t i = 0; i < _num_threads; i++) {
+        const size_t node = _layout.workers[i].node;
+        std::vector<size_t> order(1, i);
+
+        for (size_t j = 1; j < _num_threads; j++) {
+            size_t other = (i + j) % _num_threads;
+            if (_layout.workers[other].node == node) {
+                order.push_back(other);
+            }
+        }
+        for (size_t j = 1; j < _num_threads; j++) {
+            size_t other = (i + j) % _num_threads;
+            if (_layout.workers[other].node != node) {
+                order.push_back(other);
+            }
+        }
+        _steal_order.push_back(order);
+    }
+}
+
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+_get_chunk(size_t node, ReadChunk &chunk, size_t size)
+{
+    ChunkPool &pool = *_pools[node];
+    std_mutex_lock lg(pool.mutex);
+
+    if (pool.chunks.empty()) {
+        return;
+    }
+    chunk = std::move(pool.chunks.back());
+    pool.chunks.pop_back();
+    if (chunk.size() > size) {
+        // Parsing would destroy the reads it doesn't fill, so move them, with
+        // their memory, back to the pool
+        ReadChunk spare(std::make_move_iterator(chunk.begin() + size),
+                        std::make_move_iterator(chunk.end()));
+        chunk.resize(size);
+        pool.chunks.emplace_back(std::move(spare));
+    }
+}
+
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+_put_chunk(size_t node, ReadChunk &chunk)
+{
+    ChunkPool &pool = *_pools[node];
+
+    // Reads are kept, to be parsed over in place
+    std_mutex_lock lg(pool.mutex);
+    // No more than could be in flight at once
+    if (pool.chunks.size() < 2 * _num_threads) {
+        pool.chunks.emplace_back(std::move(chunk));
+    }
+}
+
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+_stock_pool(size_t node)
+{
+    if (!_numa_placement) {
+        return;
+    }
+    {
+        ChunkPool &pool = *_pools[node];
+        std_mutex_lock lg(pool.mutex);
+        if (pool.chunks.size() >= 2 * _num_threads / _pools.size()) {
+            return;
+        }
+    }
+    // Pages are placed on the node of the thread that first writes them, so
+    // allocate the reads' strings here rather than leaving it to the reader.
+    // Parsers overwrite them in place, so they stay on this node.
+    ReadChunk chunk(std::min(2 * _next_chunksize(), _chunk_sizer.max_size()));
+    for (ReadType &read: chunk) {
+        reserve_one(read);
+    }
+    _put_chunk(node, chunk);
+}
+
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+_pin(ThreadPlacement &placement)
+{
+    if (!placement.cpus.empty()) {
+        placement.pinned = pin_current_thread(placement.cpus);
+    }
+}
+
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+worker(BasicThreadedQCProcessor *self, size_t thread_id)
+{
+    typedef std::chrono::steady_clock clock;
     ReadProcessorPipeline &pipeline = self->_pipelines[thread_id];
+    const size_t node = self->_layout.workers[thread_id].node;
+
+    _pin(self->_layout.workers[thread_id]);
     while (true) {
-        std::unique_lock<std::mutex> lock(self->_in_mutex);
-        while (self->_in_queue.empty()) {
-            if (self->_input_complete) {
+        ReadChunk chunk;
+        bool stolen = false;
+
+        if (!self->_take_chunk(thread_id, chunk, stolen)) {
+            // The reader queues the last chunk before marking the input
+            // complete, so check in that order.
+            if (self->_input_complete && self->_num_queued == 0) {
+                std_mutex_lock lg(self->_out_mutex);
                 self->_output_complete++;
                 return;
             }
-            self->_out_cv.wait_for(lock, std::chrono::microseconds(1));
+            std::unique_lock<std::mutex> lock(self->_in_mutex);
+            self->_in_cv.wait_for(lock, std::chrono::microseconds(100));
+            continue;
         }
-        ReadChunk chunk(self->_in_queue.front());
-        self->_in_queue.pop();
-
-        lock.unlock();
 
-        for (ReadPair &rp: chunk) {
-            pipeline.process_read_pair(rp);
+        // After an error, chunks are passed on to the writer, which drops
+        // them, without being processed. Errors from processing are kept for
+        // run(), and this worker carries on until the input is complete so
+        // that the writer can finish.
+        if (!self->_failed) {
+            try {
+                clock::time_point start = clock::now();
+                for (ReadType &read: chunk) {
+                    process_one(pipeline, read);
+                }
+                std::chrono::duration<double> elapsed = clock::now() - start;
+                self->_record_chunk(thread_id, elapsed.count(), chunk.size());
+            } catch (...) {
+                self->_set_error(std::current_exception());
+            }
         }
+        self->_stats[thread_id].stolen += stolen;
 
         {
             std_mutex_lock lg(self->_out_mutex);
-            self->_out_queue.emplace(chunk);
+            self->_out_queue.emplace(std::move(chunk), node);
         }
         self->_out_cv.notify_one();
+        self->_stock_pool(node);
     }
 }
 
+template<typename ReadType>
 void
-ThreadedQCProcessor::
-reader(ThreadedQCProcessor *self)
+BasicThreadedQCProcessor<ReadType>::
+mapped_worker(BasicThreadedQCProcessor *self, size_t thread_id)
 {
-    while (true) {
+    typedef std::chrono::steady_clock clock;
+    ReadProcessorPipeline &pipeline = self->_pipelines[thread_id];
+    const size_t n_ranges = self->_mapped_ranges.size() - 1;
+    const size_t node = self->_layout.workers[thread_id].node;
+    size_t range;
+
+    _pin(self->_layout.workers[thread_id]);
+
+    try {
+        while (!self->_failed && (range = self->_next_range++) < n_ranges) {
+            MappedReadParser parser(*self->_mapped_input,
+                                    self->_mapped_ranges[range],
+                                    self->_mapped_ranges[range + 1]);
+            bool range_complete = false;
+            while (!range_complete && !self->_failed) {
+                // Workers parse their own input here, so time both parsing
+                // and processing
+                clock::time_point start = clock::now();
+                const size_t chunksize = self->_next_chunksize();
+                ReadChunk chunk;
+                self->_get_chunk(node, chunk, chunksize);
+                chunk.reserve(chunksize);
+                range_complete = !parser.parse_chunk(chunk, chunksize);
+                for (ReadType &read: chunk) {
+                    process_one(pipeline, read);
+                }
+                std::chrono::duration<double> elapsed = clock::now() - start;
+                self->_record_chunk(thread_id, elapsed.count(), chunk.size());
+
+                std::unique_lock<std::mutex> lock(self->_out_mutex);
+                // Avoid workers racing ahead of the writer.
+                while (self->_out_queue.size() > 2 * self->_num_threads) {
+                    self->_out_cv.wait_for(lock, std::chrono::microseconds(100));
+                }
+                self->_out_queue.emplace(std::move(chunk), node);
+                lock.unlock();
+                self->_out_cv.notify_all();
+            }
+        }
+    } catch (...) {
+        self->_set_error(std::current_exception());
+    }
+    std_mutex_lock lg(self->_out_mutex);
+    self->_output_complete++;
+}
+
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+reader(BasicThreadedQCProcessor *self)
+{
+    bool input_complete = false;
+    size_t next_queue = 0;
+
+    _pin(self->_layout.reader);
+    while (!input_complete) {
+        const size_t chunksize = self->_next_chunksize();
         ReadChunk   chunk;
-        while (chunk.size() < self->_chunksize) {
-            ReadPair    rp;
-            if (!self->_input.parse_read_pair(rp))  {
-                self->_input_complete = true;
-                break;
+        // Fill a chunk from the pool of the node it will be processed on
+        self->_get_chunk(self->_layout.workers[next_queue].node, chunk, chunksize);
+        chunk.reserve(chunksize);
+        if (self->_failed) {
+            // Another thread has failed, so the rest of the input would
+            // only be thrown away
+            chunk.clear();
+            input_complete = true;
+        } else {
+            try {
+                input_complete = !self->_input->parse_chunk(chunk, chunksize);
+            } catch (...) {
+                self->_set_error(std::current_exception());
+                input_complete = true;
             }
-            chunk.emplace_back(rp);
         }
         {
-            std_mutex_lock lg(self->_in_mutex);
-            self->_in_queue.emplace(chunk);
+            // Count the chunk before it can be taken, so _num_queued never
+            // undercounts
+            WorkQueue &queue = *self->_queues[next_queue];
+            std_mutex_lock lg(queue.mutex);
+            self->_num_queued++;
+            queue.chunks.emplace_back(std::move(chunk));
         }
-        self->_in_cv.notify_one();
-        while (self->_in_queue.size() > 2 * self->_num_threads) {
-            // Avoid reader racing ahead of workers.
+        next_queue = (next_queue + 1) % self->_queues.size();
+        // Only mark input as complete once the last chunk is queued, so
+        // workers can't finish before processing it.
+        self->_input_complete = input_complete;
+        self->_in_cv.notify_all();
+        // Avoid reader racing ahead of workers.
+        while (self->_num_queued > 2 * self->_num_threads) {
             std::this_thread::sleep_for(std::chrono::microseconds(1));
         }
-        if (self->_input_complete) break;
     }
 }
 
+template<typename ReadType>
 size_t
-ThreadedQCProcessor::
+BasicThreadedQCProcessor<ReadType>::
 run()
 {
-    std::thread rdr(ThreadedQCProcessor::reader, this);
-    std::thread wtr(ThreadedQCProcessor::writer, this);
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    _setup_layout();
+    std::thread rdr;
+    std::thread wtr(BasicThreadedQCProcessor::writer, this);
     std::vector<std::thread> workers;
 
-    for (size_t i = 0; i < _num_threads; i++) {
-        workers.emplace_back(ThreadedQCProcessor::worker, this, i);
+    if (_mapped_input) {
+        // Several ranges per worker, so that workers finishing early can
+        // take more work
+        const bool paired = std::is_same<ReadType, ReadPair>::value;
+        _mapped_ranges = _mapped_input->partition(4 * _num_threads, paired);
+        _next_range = 0;
+        for (size_t i = 0; i < _num_threads; i++) {
+            workers.emplace_back(BasicThreadedQCProcessor::mapped_worker, this, i);
+        }
+    } else {
+        rdr = std::thread(BasicThreadedQCProcessor::reader, this);
+        for (size_t i = 0; i < _num_threads; i++) {
+            workers.emplace_back(BasicThreadedQCProcessor::worker, this, i);
+        }
+        rdr.join();
     }
-
-    rdr.join();
     for (auto &thr: workers) {
         thr.join();
     }
     wtr.join();
+    std::chrono::duration<double> elapsed = clock::now() - start;
+    _run_seconds = elapsed.count();
 
     for (size_t i = 1; i < _num_threads; i++) {
         _pipelines[0].add_stats_from(_pipelines[i]);
     }
+    if (_error) {
+        std::rethrow_exception(_error);
+    }
     return _num_reads;
 }
 
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+set_orphan_output(std::ostream *orphans)
+{
+    _stream_orphan_output.reset(new StreamReadWriter(orphans));
+    _orphan_output = _stream_orphan_output.get();
+}
+
+template<typename ReadType>
 void
-ThreadedQCProcessor::
+BasicThreadedQCProcessor<ReadType>::
+set_orphan_output(ReadOutputStream &orphans)
+{
+    _orphan_output = &orphans;
+}
+
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
 set_progress_callback(std::function<void(size_t)> func)
 {
     _progress_cb = func;
 }
 
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+set_mapped_input(int flags)
+{
+    if (!_parser) {
+        throw IOError("Mapped input requires an input file");
+    }
+    _mapped_input.reset(new MappedReadParser);
+    _mapped_input->open(_input_file, flags);
+}
+
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+set_async_input(const AsyncIOOptions &aio)
+{
+    if (!_parser) {
+        throw IOError("Asynchronous input requires an input file");
+    }
+    _parser->open(_input_file, aio);
+}
+
+template<typename ReadType>
+void
+BasicThreadedQCProcessor<ReadType>::
+set_numa_placement(bool enable)
+{
+    _numa_placement = enable;
+}
+
+template<typename ReadType>
 std::string
-ThreadedQCProcessor::
+BasicThreadedQCProcessor<ReadType>::
 report()
 {
     return _pipelines[0].report();
 }
 
+// Emits the node and CPUs of a thread, as keys of the current map
+static void
+emit_placement(YAML::Emitter &yml, const ThreadLayout &layout,
+               const ThreadPlacement &placement)
+{
+    yml << YAML::Key   << "node"
+        << YAML::Value << layout.node_ids[placement.node]
+        << YAML::Key   << "cpus"
+        << YAML::Value << YAML::Flow << placement.cpus
+        << YAML::Key   << "pinned"
+        << YAML::Value << placement.pinned;
+}
+
+template<typename ReadType>
+std::string
+BasicThreadedQCProcessor<ReadType>::
+scheduler_report()
+{
+    std::ostringstream ss;
+    YAML::Emitter yml;
+    size_t chunks = 0, reads = 0;
+    double busy_seconds = 0;
+
+    for (const WorkerStats &stats: _stats) {
+        chunks += stats.chunks;
+        reads += stats.reads;
+        busy_seconds += stats.busy_seconds;
+    }
+
+    yml << YAML::BeginSeq;
+    yml << YAML::BeginMap;
+    yml << YAML::Key << "ThreadedQCProcessor"
+        << YAML::Value
+        << YAML::BeginMap
+        << YAML::Key   << "threads"
+        << YAML::Value << _num_threads
+        << YAML::Key   << "mapped_input"
+        << YAML::Value << static_cast<bool>(_mapped_input)
+        << YAML::Key   << "run_seconds"
+        << YAML::Value << _run_seconds
+        << YAML::Key   << "chunks"
+        << YAML::Value << chunks
+        << YAML::Key   << "mean_chunk_size"
+        << YAML::Value << (chunks > 0 ? reads / chunks : 0)
+        << YAML::Key   << "utilization"
+        << YAML::Value << (_run_seconds > 0 ?
+                           busy_seconds / (_run_seconds * _num_threads) : 0)
+        << YAML::Key   << "numa_placement"
+        << YAML::Value << _numa_placement
+        << YAML::Key   << "nodes"
+        << YAML::Value << YAML::Flow << _layout.node_ids;
+    if (!_mapped_input) {
+        yml << YAML::Key << "reader" << YAML::Value << YAML::Flow
+            << YAML::BeginMap;
+        emit_placement(yml, _layout, _layout.reader);
+        yml << YAML::EndMap;
+    }
+    yml << YAML::Key << "writer" << YAML::Value << YAML::Flow
+        << YAML::BeginMap;
+    emit_placement(yml, _layout, _layout.writer);
+    yml << YAML::EndMap;
+    yml << YAML::Key   << "workers"
+        << YAML::Value << YAML::BeginSeq;
+    for (size_t i = 0; i < _stats.size(); i++) {
+        const WorkerStats &stats = _stats[i];
+        yml << YAML::Flow
+            << YAML::BeginMap;
+        emit_placement(yml, _layout, _layout.workers[i]);
+        yml << YAML::Key   << "chunks"
+            << YAML::Value << stats.chunks
+            << YAML::Key   << "reads"
+            << YAML::Value << stats.reads
+            << YAML::Key   << "stolen"
+            << YAML::Value << stats.stolen
+            << YAML::Key   << "utilization"
+            << YAML::Value << (_run_seconds > 0 ?
+                               stats.busy_seconds / _run_seconds : 0)
+            << YAML::EndMap;
+    }
+    yml << YAML::EndSeq
+        << YAML::EndMap;
+    yml << YAML::EndMap;
+    yml << YAML::EndSeq;
+    ss << yml.c_str() << "\n";
+    return ss.str();
+}
+
+template class BasicThreadedQCProcessor<Read>;
+template class BasicThreadedQCProcessor<ReadPair>;
 
 } // namespace qcpp
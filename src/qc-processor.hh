@@ -12,14 +12,20 @@
 
 #include "qc-config.hh"
 #include "qc-util.hh"
+#include "qc-affinity.hh"
 #include "qc-io.hh"
+#include "qc-mmap.hh"
 #include "qc-quality.hh"
 
 
+#include <atomic>
+#include <deque>
 #include <queue>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <functional>
+#include <utility>
 
 
 namespace qcpp
@@ -30,6 +36,8 @@ class ReadProcessor
 public:
     ReadProcessor                   (const std::string &name,
                                      const QualityEncoding &encoding);
+    virtual
+    ~ReadProcessor                  () {}
 
     virtual void
     process_read                    (Read              &the_read) = 0;
@@ -93,6 +101,11 @@ public:
     void
     open                            (const std::string &filename);
 
+    // Read input ahead asynchronously (see AsyncInputBuf)
+    void
+    open                            (const std::string &filename,
+                                     const AsyncIOOptions &aio);
+
     bool
     parse_read                      (Read              &the_read);
 
@@ -114,16 +127,177 @@ protected:
     ReadProcessorPipeline   _pipeline;
 };
 
+/////////////////////////////  Output Policies //////////////////////////////
+
+// Output policies decide how the reads in each processed chunk are written by
+// BasicThreadedQCProcessor. Reads go to either the main output, or the orphan
+// output for reads which are no longer paired. format() writes one read as
+// text; select() routes a whole chunk for writing to ReadOutputStreams.
+template<typename ReadType>
+class OutputPolicy
+{
+public:
+    virtual
+    ~OutputPolicy                   () {}
+
+    virtual void
+    format                          (ReadType          &the_read,
+                                     std::string       &output,
+                                     std::string       &orphans) = 0;
+
+    // Moves the reads of chunk which should be written into output or
+    // orphans, leaving chunk in an unspecified state.
+    virtual void
+    select                          (std::vector<ReadType> &chunk,
+                                     std::vector<ReadType> &output,
+                                     std::vector<Read> &orphans) = 0;
+};
+
+// Keeps reads paired, writing a placeholder 'N' read in place of any removed
+// read (see ReadPair::append_to())
+class PairedOutput: public OutputPolicy<ReadPair>
+{
+public:
+    void
+    format                          (ReadPair          &the_read_pair,
+                                     std::string       &output,
+                                     std::string       &orphans);
+
+    void
+    select                          (std::vector<ReadPair> &chunk,
+                                     std::vector<ReadPair> &output,
+                                     std::vector<Read> &orphans);
+};
+
+// Writes each read of a pair separately, dropping reads shorter than
+// min_length. Pairs where both reads are kept go to the main output, reads
+// whose mate was dropped (or merged into them) go to the orphan output.
+class BrokenPairedOutput: public OutputPolicy<ReadPair>
+{
+public:
+    BrokenPairedOutput              (size_t             min_length=64);
+
+    void
+    format                          (ReadPair          &the_read_pair,
+                                     std::string       &output,
+                                     std::string       &orphans);
+
+    void
+    select                          (std::vector<ReadPair> &chunk,
+                                     std::vector<ReadPair> &output,
+                                     std::vector<Read> &orphans);
+
+protected:
+    size_t                  _min_length;
+};
+
+// Writes single-end reads, skipping removed reads
+class SingleOutput: public OutputPolicy<Read>
+{
+public:
+    void
+    format                          (Read              &the_read,
+                                     std::string       &output,
+                                     std::string       &orphans);
+
+    void
+    select                          (std::vector<Read> &chunk,
+                                     std::vector<Read> &output,
+                                     std::vector<Read> &orphans);
+};
+
+// The output policy used by default for reads or read pairs
+template<typename ReadType>
+struct DefaultOutputPolicy;
+
+template<>
+struct DefaultOutputPolicy<Read>
+{
+    typedef SingleOutput type;
+};
+
+template<>
+struct DefaultOutputPolicy<ReadPair>
+{
+    typedef PairedOutput type;
+};
+
 /////////////////////////////  ThreadedQCProcessor ////////////////////////////
 
-class ThreadedQCProcessor
+// Sizes chunks of reads to take about target_seconds each to process, from a
+// moving average of the time per read that workers record. Until a chunk has
+// been timed, chunks are small so that all workers get going. Shared by the
+// threads of a processor.
+class ChunkSizer
+{
+public:
+    ChunkSizer                      (size_t             min_size=64,
+                                     size_t             max_size=65536,
+                                     double             target_seconds=0.005);
+
+    // Records the time taken to process a chunk of n_reads reads
+    void
+    record                          (double             seconds,
+                                     size_t             n_reads);
+
+    // The size of the next chunk. If workers may soon be idle, work is handed
+    // out in smaller pieces, so that they are fed sooner.
+    size_t
+    next                            (bool               may_idle=false) const;
+
+    size_t
+    max_size                        () const
+    {
+        return _max_size;
+    }
+
+private:
+    // Moving average of the time to process one read (or pair)
+    std::atomic<double>     _read_cost;
+    const size_t            _min_size;
+    const size_t            _max_size;
+    const double            _target_seconds;
+};
+
+// Parses reads (or read pairs) in chunks on one thread, processes chunks in
+// parallel with one ReadProcessorPipeline per worker thread, and writes
+// chunks from a single writer thread according to an OutputPolicy.
+//
+// Each worker has its own queue of parsed chunks, filled in turn by the
+// reader. Workers take chunks from the front of their own queue, and when it
+// is empty steal from the back of the others', so an expensive chunk (e.g.
+// one full of pairs to merge) doesn't leave other workers idle. Chunk sizes
+// adapt to the measured time to process each read: chunks are sized to take
+// a few milliseconds, and shrink when the queues run low so that idle workers
+// are fed sooner and the tail of a run is short.
+//
+// With set_numa_placement(), threads are pinned to CPUs with workers grouped
+// by NUMA node (see ThreadLayout). Workers then steal from workers on their
+// own node first, and chunk buffers are pooled per node, so a chunk's memory
+// stays on the node of the workers that process it.
+//
+// Input and output may be files and std::ostreams, or any ReadInputStream and
+// ReadOutputStream, e.g. a ReadInterleaver or ReadWriter. Streams are read
+// and written a chunk at a time, with parse_chunk() and write_chunk(). Errors
+// from either are rethrown by run().
+//
+// With set_mapped_input(), the input file is instead memory-mapped and split
+// into record-aligned byte ranges, which workers parse themselves, so there
+// is no reader thread.
+template<typename ReadType>
+class BasicThreadedQCProcessor
 {
-    typedef std::vector<ReadPair> ReadChunk;
+    typedef std::vector<ReadType> ReadChunk;
 public:
-    ThreadedQCProcessor             (std::string        &input,
+    BasicThreadedQCProcessor        (std::string        &input,
                                      std::ostream       *output,
                                      size_t              worker_threads=1);
 
+    // Streams are not owned, and must outlive the processor.
+    BasicThreadedQCProcessor        (ReadInputStream    &input,
+                                     ReadOutputStream   &output,
+                                     size_t              worker_threads=1);
+
     template<typename ReadProcType, class ...  Args>
     void
     append_processor                (Args&&...          args)
@@ -133,40 +307,181 @@ public:
         }
     }
 
+    // Replace the default output policy (PairedOutput or SingleOutput)
+    template<typename PolicyType, class ...  Args>
+    void
+    set_output_policy               (Args&&...          args)
+    {
+        _policy.reset(new PolicyType(args...));
+    }
+
+    // Write orphaned reads to a separate stream. By default, they are
+    // written to the main output.
+    void
+    set_orphan_output               (std::ostream       *orphans);
+
+    void
+    set_orphan_output               (ReadOutputStream   &orphans);
+
     void
     set_progress_callback           (std::function<void(size_t)> func);
 
+    // Parse input from a memory mapping (see MappedReadParser) in worker
+    // threads. Only uncompressed input files can be mapped; throws IOError
+    // otherwise, or if the input is a ReadInputStream. flags are
+    // MappedFile::MapFlags.
+    void
+    set_mapped_input                (int                flags=MappedFile::MapDefault);
+
+    // Read input ahead asynchronously in the reader thread (see
+    // AsyncInputBuf), so that parsing doesn't wait on IO. Throws IOError if
+    // the input is a ReadInputStream.
+    void
+    set_async_input                 (const AsyncIOOptions &aio=AsyncIOOptions());
+
+    // Pin the reader, writer and workers to CPUs, grouping workers by NUMA
+    // node, as planned by ThreadLayout::plan(). Threads that can't be pinned
+    // run unpinned.
+    void
+    set_numa_placement              (bool               enable=true);
+
     size_t
     run                             ();
 
     std::string
     report                          ();
 
-    static void reader(ThreadedQCProcessor *self);
-    static void worker(ThreadedQCProcessor *self, size_t thread_id);
-    static void writer(ThreadedQCProcessor *self);
+    // A YAML report of how work was scheduled: for each worker, the chunks
+    // and reads processed, chunks stolen from other workers, and utilization
+    // (the fraction of the run spent processing reads), and the node and
+    // CPUs each thread ran on. Valid once run() has finished.
+    std::string
+    scheduler_report                ();
+
+    static void reader(BasicThreadedQCProcessor *self);
+    static void worker(BasicThreadedQCProcessor *self, size_t thread_id);
+    static void mapped_worker(BasicThreadedQCProcessor *self, size_t thread_id);
+    static void writer(BasicThreadedQCProcessor *self);
 
 protected:
     size_t                  _num_reads;
     // One pipeline per thread
     std::vector<ReadProcessorPipeline> _pipelines;
-    ReadParser              _input;
-    std::ostream           *_output;
+    std::unique_ptr<OutputPolicy<ReadType>> _policy;
+    std::string             _input_file;
+    // Set when constructed with a filename
+    std::unique_ptr<ReadParser> _parser;
+    ReadInputStream        *_input;
+    std::unique_ptr<MappedReadParser> _mapped_input;
+    std::vector<size_t>     _mapped_ranges;
+    std::atomic_size_t      _next_range;
+    // Wrappers of std::ostream outputs
+    std::unique_ptr<ReadOutputStream> _stream_output;
+    std::unique_ptr<ReadOutputStream> _stream_orphan_output;
+    ReadOutputStream       *_output;
+    ReadOutputStream       *_orphan_output;
     std::condition_variable _in_cv;
     std::condition_variable _out_cv;
     std::mutex              _in_mutex;
     std::mutex              _out_mutex;
-    std::queue<ReadChunk>   _in_queue;
-    std::queue<ReadChunk>   _out_queue;
+    // Processed chunks, with the node they were processed on
+    std::queue<std::pair<ReadChunk, size_t>> _out_queue;
     size_t                  _num_threads;
-    bool                    _input_complete;
+    std::atomic<bool>       _input_complete;
     size_t                  _output_complete;
     std::function<void(size_t)> _progress_cb;
+    // The first error from any thread, rethrown by run()
+    std::exception_ptr      _error;
+    std::mutex              _error_mutex;
+    // Set with _error, so that the reader and workers stop early
+    std::atomic<bool>       _failed;
+
+    // Per-worker queues of parsed chunks
+    struct WorkQueue
+    {
+        std::mutex              mutex;
+        std::deque<ReadChunk>   chunks;
+    };
 
-private:
-    const size_t            _chunksize;
+    struct WorkerStats
+    {
+        double                  busy_seconds;
+        size_t                  chunks;
+        size_t                  stolen;
+        size_t                  reads;
+
+        WorkerStats() : busy_seconds(0), chunks(0), stolen(0), reads(0) {}
+    };
+
+    // Emptied chunks, kept for reuse by threads on one node
+    struct ChunkPool
+    {
+        std::mutex              mutex;
+        std::vector<ReadChunk>  chunks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> _queues;
+    bool                    _numa_placement;
+    ThreadLayout            _layout;
+    // For each worker, the queues to take chunks from: its own, then those
+    // of workers on its node, then the rest
+    std::vector<std::vector<size_t>> _steal_order;
+    std::vector<std::unique_ptr<ChunkPool>> _pools;
+    // Chunks in all of _queues
+    std::atomic_size_t      _num_queued;
+    // Each worker's stats are only written by that worker
+    std::vector<WorkerStats> _stats;
+    double                  _run_seconds;
+    ChunkSizer              _chunk_sizer;
+
+    void
+    _set_error                      (std::exception_ptr error);
+
+    // Takes a chunk from the worker's own queue, or else steals one from
+    // another worker's. Returns false if all queues are empty.
+    bool
+    _take_chunk                     (size_t             thread_id,
+                                     ReadChunk         &chunk,
+                                     bool              &stolen);
+
+    // Records the time taken to process a chunk of n_reads reads
+    void
+    _record_chunk                   (size_t             thread_id,
+                                     double             seconds,
+                                     size_t             n_reads);
+
+    // The size of the next chunk to parse
+    size_t
+    _next_chunksize                 ();
+
+    // Plans the thread layout, steal orders and chunk pools for run()
+    void
+    _setup_layout                   ();
+
+    // Takes a chunk of at most size reads from node's pool, if it has one,
+    // for parsing over
+    void
+    _get_chunk                      (size_t             node,
+                                     ReadChunk         &chunk,
+                                     size_t             size);
+
+    // Returns a chunk to node's pool
+    void
+    _put_chunk                      (size_t             node,
+                                     ReadChunk         &chunk);
+
+    // With NUMA placement, keeps node's pool stocked with chunks allocated
+    // and first touched by the calling thread, so their pages are on node
+    void
+    _stock_pool                     (size_t             node);
+
+    static void
+    _pin                            (ThreadPlacement   &placement);
 };
 
+typedef BasicThreadedQCProcessor<ReadPair> ThreadedQCProcessor;
+typedef BasicThreadedQCProcessor<Read> ThreadedQCProcessorSE;
+
 } // namespace qcpp
 
 #endif /* QC_PROCESSOR_HH */
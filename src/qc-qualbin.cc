@@ -0,0 +1,234 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include <yaml-cpp/yaml.h>
+#include "qc-qualbin.hh"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace qcpp
+{
+
+// Upper bound of bins that include all higher scores
+static const int open_upper = 255;
+// The lowest score of any encoding (Solexa's)
+static const int lowest_score = -5;
+
+std::vector<QualityBin>
+illumina8_bins()
+{
+    return {
+        {0, 0, 0},
+        {1, 1, 1},
+        {2, 9, 6},
+        {10, 19, 15},
+        {20, 24, 22},
+        {25, 29, 27},
+        {30, 34, 33},
+        {35, 39, 37},
+        {40, open_upper, 40},
+    };
+}
+
+std::vector<QualityBin>
+illumina4_bins()
+{
+    return {
+        {0, 2, 2},
+        {3, 14, 12},
+        {15, 30, 23},
+        {31, open_upper, 37},
+    };
+}
+
+std::vector<QualityBin>
+binary_bins(int threshold, int low, int high)
+{
+    return {
+        {lowest_score, threshold - 1, low},
+        {threshold, open_upper, high},
+    };
+}
+
+// Parses an integer from the start of str, advancing it
+static bool
+parse_int(const char *&str, int &value)
+{
+    char *end;
+    long parsed = strtol(str, &end, 10);
+    if (end == str) {
+        return false;
+    }
+    str = end;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+std::vector<QualityBin>
+parse_quality_bins(const std::string &scheme)
+{
+    const std::string binary = "binary:";
+    std::vector<QualityBin> bins;
+
+    if (scheme == "illumina8") {
+        return illumina8_bins();
+    }
+    if (scheme == "illumina4") {
+        return illumina4_bins();
+    }
+    if (scheme.compare(0, binary.size(), binary) == 0) {
+        const char *pos = scheme.c_str() + binary.size();
+        int threshold;
+        if (!parse_int(pos, threshold) || *pos != '\0') {
+            throw IOError("Malformed quality binning scheme '" + scheme + "'");
+        }
+        return binary_bins(threshold);
+    }
+
+    const char *pos = scheme.c_str();
+    while (*pos != '\0') {
+        QualityBin bin;
+
+        if (!parse_int(pos, bin.lower) || *pos++ != '-') {
+            throw IOError("Malformed quality bin in '" + scheme + "'");
+        }
+        bin.upper = open_upper;
+        if (*pos != ':' && !parse_int(pos, bin.upper)) {
+            throw IOError("Malformed quality bin in '" + scheme + "'");
+        }
+        if (*pos++ != ':' || !parse_int(pos, bin.value) || bin.upper < bin.lower) {
+            throw IOError("Malformed quality bin in '" + scheme + "'");
+        }
+        bins.push_back(bin);
+        if (*pos == ',') {
+            pos++;
+        } else if (*pos != '\0') {
+            throw IOError("Malformed quality bin in '" + scheme + "'");
+        }
+    }
+    if (bins.empty()) {
+        throw IOError("Quality binning scheme '" + scheme + "' has no bins");
+    }
+    return bins;
+}
+
+/*****************************************************************************
+ *                               QualityBinner
+ *****************************************************************************/
+
+QualityBinner::
+QualityBinner(const std::string &name, const std::vector<QualityBin> &bins,
+              const QualityEncoding &encoding)
+    : ReadProcessor(name, encoding)
+    , _bins(bins)
+    , _num_bases(0)
+{
+    for (int c = 0; c < 256; c++) {
+        _table[c] = c;
+        // Only printable characters are qualities
+        if (c < '!' || c > '~') {
+            continue;
+        }
+        const int score = c - _encoding.offset;
+        for (const QualityBin &bin: _bins) {
+            if (score >= bin.lower && score <= bin.upper) {
+                _table[c] = std::min(std::max(bin.value + _encoding.offset,
+                                              int('!')), int('~'));
+                break;
+            }
+        }
+    }
+}
+
+void
+QualityBinner::
+bin_qualities(std::string &quality) const
+{
+    char *qual = &quality[0];
+    const size_t len = quality.size();
+
+    for (size_t i = 0; i < len; i++) {
+        qual[i] = _table[static_cast<unsigned char>(qual[i])];
+    }
+}
+
+void
+QualityBinner::
+process_read(Read &the_read)
+{
+    _num_reads++;
+    _num_bases += the_read.quality.size();
+    bin_qualities(the_read.quality);
+}
+
+void
+QualityBinner::
+process_read_pair(ReadPair &the_read_pair)
+{
+    process_read(the_read_pair.first);
+    process_read(the_read_pair.second);
+}
+
+void
+QualityBinner::
+add_stats_from(ReadProcessor *other_ptr)
+{
+    QualityBinner &other = *reinterpret_cast<QualityBinner *>(other_ptr);
+
+    _num_reads += other._num_reads;
+    _num_bases += other._num_bases;
+}
+
+std::string
+QualityBinner::
+yaml_report()
+{
+    std::ostringstream ss;
+    YAML::Emitter yml;
+    std::vector<std::string> bins;
+
+    for (const QualityBin &bin: _bins) {
+        std::string spec = std::to_string(bin.lower) + "-";
+        if (bin.upper != open_upper) {
+            spec += std::to_string(bin.upper);
+        }
+        bins.push_back(spec + ":" + std::to_string(bin.value));
+    }
+
+    yml << YAML::BeginSeq;
+    yml << YAML::BeginMap;
+    yml << YAML::Key   << "QualityBinner"
+        << YAML::Value
+        << YAML::BeginMap
+        << YAML::Key   << "name"
+        << YAML::Value << _name
+        << YAML::Key   << "parameters"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "quality_encoding"
+                       << YAML::Value << _encoding.name
+                       << YAML::Key << "bins"
+                       << YAML::Flow
+                       << YAML::Value << bins
+                       << YAML::EndMap
+        << YAML::Key   << "output"
+        << YAML::Value << YAML::BeginMap
+                       << YAML::Key << "num_reads"
+                       << YAML::Value << _num_reads
+                       << YAML::Key << "num_bases"
+                       << YAML::Value << _num_bases
+                       << YAML::EndMap
+        << YAML::EndMap;
+    yml << YAML::EndMap;
+    yml << YAML::EndSeq;
+    ss << yml.c_str() << "\n";
+    return ss.str();
+}
+
+} // namespace qcpp
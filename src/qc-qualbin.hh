@@ -0,0 +1,84 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_QUALBIN_HH
+#define QC_QUALBIN_HH
+
+#include "qc-config.hh"
+#include "qc-processor.hh"
+#include "qc-quality.hh"
+
+#include <string>
+#include <vector>
+
+namespace qcpp
+{
+
+// Scores from lower to upper (inclusive) are written as value
+struct QualityBin
+{
+    int                     lower;
+    int                     upper;
+    int                     value;
+};
+
+// Illumina's 8-level binning: no-call scores (below 2) are kept, then
+// 2-9, 10-19, 20-24, 25-29, 30-34, 35-39 and 40+ become 6, 15, 22, 27, 33,
+// 37 and 40.
+std::vector<QualityBin> illumina8_bins();
+
+// The 4-level binning of recent Illumina instruments: 0-2, 3-14, 15-30 and
+// 31+ become 2, 12, 23 and 37.
+std::vector<QualityBin> illumina4_bins();
+
+// Scores below threshold become low, the rest high
+std::vector<QualityBin> binary_bins(int threshold, int low=2, int high=40);
+
+// Parses a binning scheme: "illumina8", "illumina4", "binary:THRESHOLD", or
+// a comma-separated list of custom bins "LOWER-UPPER:VALUE", where UPPER may
+// be left out to include all higher scores, e.g. "0-19:10,20-29:25,30-:35".
+// Throws IOError if the scheme is malformed.
+std::vector<QualityBin> parse_quality_bins(const std::string &scheme);
+
+// Reduces the number of distinct quality scores, so that qualities compress
+// better. Each quality character is mapped through a 256-entry table built
+// from the bins for the processor's encoding. Scores outside all bins are
+// left as they are; where bins overlap, the first applies.
+class QualityBinner: public ReadProcessor
+{
+public:
+    QualityBinner                   (const std::string &name,
+                                     const std::vector<QualityBin> &bins=illumina8_bins(),
+                                     const QualityEncoding &encoding=SangerEncoding);
+
+    void
+    process_read                    (Read              &the_read);
+
+    void
+    process_read_pair               (ReadPair          &the_read_pair);
+
+    void
+    add_stats_from                  (ReadProcessor     *other_ptr);
+
+    std::string
+    yaml_report                     ();
+
+    // Bins a quality string in place
+    void
+    bin_qualities                   (std::string       &quality) const;
+
+private:
+    std::vector<QualityBin> _bins;
+    unsigned char           _table[256];
+    size_t                  _num_bases;
+};
+
+} // namespace qcpp
+
+#endif /* QC_QUALBIN_HH */
@@ -7,7 +7,94 @@
  */
 
 
+#include "qc-io.hh"
+#include "qc-quality.hh"
+
+#include <algorithm>
+
+#include <sys/stat.h>
+
 namespace qcpp
 {
 
+void
+QualityRange::
+add(const std::string &quality)
+{
+    const unsigned char *qual =
+        reinterpret_cast<const unsigned char *>(quality.data());
+    const size_t len = quality.size();
+    unsigned char lo = min, hi = max;
+
+    // Kept branch-free so that the compiler vectorises it
+    for (size_t i = 0; i < len; i++) {
+        lo = std::min(lo, qual[i]);
+        hi = std::max(hi, qual[i]);
+    }
+    min = lo;
+    max = hi;
+}
+
+const QualityEncoding &
+encoding_for_range(const QualityRange &range)
+{
+    if (range.empty()) {
+        return SangerEncoding;
+    }
+    if (range.min < '!' || range.max > '~') {
+        throw IOError("Quality characters outside of '!' to '~' found");
+    }
+    // Phred+64 reads with nothing above Q10 are implausible, so anything
+    // below Phred+33 Q41 is taken to be Phred+33.
+    if (range.min < ';' || range.max <= 'J') {
+        return range.max > 'I' ? Illumina18Encoding : SangerEncoding;
+    }
+    if (range.min < '@') {
+        return SolexaEncoding;
+    }
+    // Illumina 1.5 pipelines don't use scores below 2 ('B')
+    if (range.min >= 'B') {
+        return Illumina15Encoding;
+    }
+    return Illumina13Encoding;
+}
+
+const QualityEncoding &
+detect_quality_encoding(const std::string &filename, size_t max_reads)
+{
+    ReadParser parser;
+    QualityRange range;
+    Read read;
+    struct stat st;
+
+    // Reads taken from a pipe can't be given back, so only regular files are
+    // sampled
+    if (stat(filename.c_str(), &st) == 0 && !S_ISREG(st.st_mode)) {
+        throw IOError("Can't detect the quality encoding of " + filename +
+                      ", as it is not a regular file");
+    }
+    parser.open(filename);
+    for (size_t i = 0; i < max_reads && parser.parse_read(read); i++) {
+        range.add(read.quality);
+    }
+    return encoding_for_range(range);
+}
+
+const QualityEncoding &
+quality_encoding_by_name(const std::string &name)
+{
+    if (name == "sanger") {
+        return SangerEncoding;
+    } else if (name == "solexa") {
+        return SolexaEncoding;
+    } else if (name == "illumina13") {
+        return Illumina13Encoding;
+    } else if (name == "illumina15") {
+        return Illumina15Encoding;
+    } else if (name == "illumina18") {
+        return Illumina18Encoding;
+    }
+    throw IOError("Unknown quality encoding '" + name + "'");
+}
+
 } // end namespace qcpp
@@ -12,6 +12,9 @@
 
 #include "qc-config.hh"
 
+#include <cassert>
+#include <string>
+
 namespace qcpp
 {
 
@@ -34,6 +37,113 @@ static const QualityEncoding Illumina13Encoding{"Illumina 1.3+", 64, 0, 40};
 static const QualityEncoding Illumina15Encoding{"Illumina 1.5+", 64, 2, 40};
 static const QualityEncoding Illumina18Encoding{"Illumina 1.8+", 33, 0, 41};
 
+// Quality offsets as types, so that inner loops can be instantiated with the
+// offset as an immediate constant rather than loading it for every base.
+// Both kinds can be constructed from the encoding in use, which must have the
+// type's offset; with_quality_offset() picks between them.
+template <int8_t Offset>
+struct PhredOffset {
+    static_assert(Offset >= '!' && Offset <= '@',
+                  "Every quality character must give a score within int8_t");
+
+    static constexpr int8_t offset = Offset;
+
+    constexpr
+    PhredOffset()
+    {
+    }
+
+    constexpr explicit
+    PhredOffset(const QualityEncoding &encoding)
+    {
+        assert(encoding.offset == Offset);
+        (void)encoding;
+    }
+
+    static constexpr int8_t
+    p2q(char phred)
+    {
+        return phred - Offset;
+    }
+};
+
+typedef PhredOffset<33> Phred33Offset;  // Sanger and Illumina 1.8+
+typedef PhredOffset<59> SolexaOffset;
+typedef PhredOffset<64> Phred64Offset;  // Illumina 1.3+ and 1.5+
+
+// The offset of any other encoding, held in a local rather than re-read
+// from the encoding
+struct RuntimeOffset {
+    const int8_t offset;
+
+    explicit
+    RuntimeOffset(const QualityEncoding &encoding)
+        : offset(encoding.offset)
+    {
+    }
+
+    int8_t
+    p2q(char phred) const
+    {
+        return phred - offset;
+    }
+};
+
+// Calls fn with the offset type for encoding, returning its result. Each
+// branch instantiates fn separately, so this is done once, e.g. in a
+// constructor, to choose between instances of a function template.
+template <typename Fn>
+inline auto
+with_quality_offset(const QualityEncoding &encoding, Fn fn)
+    -> decltype(fn(RuntimeOffset(encoding)))
+{
+    switch (encoding.offset) {
+        case Phred33Offset::offset:
+            return fn(Phred33Offset(encoding));
+        case SolexaOffset::offset:
+            return fn(SolexaOffset(encoding));
+        case Phred64Offset::offset:
+            return fn(Phred64Offset(encoding));
+        default:
+            return fn(RuntimeOffset(encoding));
+    }
+}
+
+
+// The lowest and highest quality characters seen
+struct QualityRange {
+    unsigned char min = 0xFF;
+    unsigned char max = 0;
+
+    void
+    add(const std::string &quality);
+
+    bool
+    empty() const
+    {
+        return min > max;
+    }
+};
+
+// The encoding that best explains a range of quality characters. Phred+33
+// is preferred where a range fits both offsets, as it does for reads with
+// only high qualities. An empty range (e.g. FASTA input) gives Sanger.
+// Throws IOError if the range contains characters that can't be qualities.
+const QualityEncoding &
+encoding_for_range              (const QualityRange &range);
+
+// Detects the encoding of a read file from the qualities of its first
+// max_reads reads. Throws IOError if the file can't be read, is not a regular
+// file (e.g. a pipe, whose reads would be lost), or its qualities fit no
+// encoding.
+const QualityEncoding &
+detect_quality_encoding         (const std::string &filename,
+                                 size_t             max_reads=10000);
+
+// Looks up an encoding by name: sanger, solexa, illumina13, illumina15 or
+// illumina18. Throws IOError for any other name.
+const QualityEncoding &
+quality_encoding_by_name        (const std::string &name);
 
 static inline int8_t
 qual_of_base                    (const Read &the_read,
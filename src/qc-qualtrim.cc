@@ -24,6 +24,9 @@ WindowedQualTrim(const std::string &name, int8_t min_quality, size_t min_length,
     , _num_reads_trimmed(0)
     , _num_reads_dropped(0)
 {
+    _trim = with_quality_offset(_encoding, [](auto offset) {
+        return &WindowedQualTrim::_trim_read<decltype(offset)>;
+    });
 }
 
 
@@ -31,6 +34,15 @@ void
 WindowedQualTrim::
 process_read(Read &the_read)
 {
+    (this->*_trim)(the_read);
+}
+
+template<typename Offset>
+void
+WindowedQualTrim::
+_trim_read(Read &the_read)
+{
+    const Offset    encoding(_encoding);
     int64_t         win_sum         = 0;
     size_t          win_start       = 0;
     size_t          win_size        = 0;
@@ -63,7 +75,7 @@ process_read(Read &the_read)
 
     // Trim until the first base which is of acceptable quality
     for (; win_start < read_len;) {
-        if (_encoding.p2q(qual[win_start]) >= _min_quality) {
+        if (encoding.p2q(qual[win_start]) >= _min_quality) {
             break;
         }
         win_start++;
@@ -73,7 +85,7 @@ process_read(Read &the_read)
 
     // pre-sum the first window
     for (size_t i = win_start; i < win_size; i++) {
-        win_sum += _encoding.p2q(qual[i]);
+        win_sum += encoding.p2q(qual[i]);
     }
     // Trim with windows
     for (; win_start < read_len - win_size + 1; win_start += 1) {
@@ -83,15 +95,15 @@ process_read(Read &the_read)
             // If the window is below threshold, stop and trim below
             break;
         }
-        win_sum -= _encoding.p2q(qual[win_start]);
+        win_sum -= encoding.p2q(qual[win_start]);
         if (win_start + win_size < read_len) {
-            win_sum += _encoding.p2q(qual[win_start + win_size]);
+            win_sum += encoding.p2q(qual[win_start + win_size]);
         }
     }
 
     // Find the last position above the threshold, trim there
     while (keep_until < read_len) {
-        if (_encoding.p2q(qual[keep_until]) < _min_quality) {
+        if (encoding.p2q(qual[keep_until]) < _min_quality) {
             // Don't increment keep_until, as we should cut at this position
             break;
         }
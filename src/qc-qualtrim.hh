@@ -41,6 +41,13 @@ public:
     yaml_report                          ();
 
 private:
+    template<typename Offset>
+    void
+    _trim_read                      (Read              &the_read);
+
+    // The _trim_read instance for our encoding's offset
+    void (WindowedQualTrim::*_trim)(Read &);
+
     int8_t                  _min_quality;
     size_t                  _min_length;
     size_t                  _window_size;
@@ -0,0 +1,193 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "qc-simulate.hh"
+
+namespace qcpp
+{
+
+static const char *bases = "ACGT";
+// M_PI isn't standard C++
+static const double two_pi = 6.283185307179586;
+
+static inline char
+complement(char base)
+{
+    switch (base) {
+        case 'A': return 'T';
+        case 'C': return 'G';
+        case 'G': return 'C';
+        case 'T': return 'A';
+        default:  return 'N';
+    }
+}
+
+ReadSimulator::
+ReadSimulator(const SimulatorParams &params)
+    : _params(params)
+    , _rng_state(params.seed)
+    , _num_pairs(0)
+    , _num_reads(0)
+    , _have_pending(false)
+{
+    if (_params.read_len == 0) {
+        throw IOError("ReadSimulator: read_len must be > 0");
+    }
+}
+
+// splitmix64. We use our own generator and distributions rather than those
+// in <random>, whose output differs between standard libraries. The normal
+// deviates and quality curve still use <cmath>, which may round differently
+// on other platforms, so a seed gives the same reads with a given libm, but
+// not necessarily everywhere.
+uint64_t
+ReadSimulator::
+_rand()
+{
+    uint64_t z = (_rng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+double
+ReadSimulator::
+_uniform()
+{
+    // 53 random bits in [0, 1)
+    return (_rand() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double
+ReadSimulator::
+_normal()
+{
+    // Box-Muller
+    double u1 = _uniform(), u2 = _uniform();
+    if (u1 < 1e-300) u1 = 1e-300;
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(two_pi * u2);
+}
+
+void
+ReadSimulator::
+_make_read(const std::string &template_seq, const std::string &adaptor,
+           Read &the_read)
+{
+    const size_t read_len = _params.read_len;
+    const double qual_range = _params.qual_start - _params.qual_end;
+    std::string &seq = the_read.sequence;
+    std::string &qual = the_read.quality;
+
+    seq.assign(template_seq, 0, read_len);
+    if (seq.size() < read_len) {
+        // Read-through into the adaptor, then into random sequence
+        seq.append(adaptor, 0, read_len - seq.size());
+        while (seq.size() < read_len) {
+            seq += bases[_rand() & 3];
+        }
+    }
+
+    qual.resize(read_len);
+    for (size_t i = 0; i < read_len; i++) {
+        double pos = read_len > 1 ? i / (double)(read_len - 1) : 0.0;
+        double q = _params.qual_start - qual_range * std::pow(pos, _params.qual_shape);
+        q += _params.qual_sd * _normal();
+
+        if (_uniform() < _params.n_rate) {
+            seq[i] = 'N';
+            q = 2;
+        } else if (_uniform() < _params.error_rate) {
+            // Substitute a different base, and give it a low quality
+            char sub = bases[_rand() & 3];
+            while (sub == seq[i]) {
+                sub = bases[_rand() & 3];
+            }
+            seq[i] = sub;
+            q = 2 + (_rand() % 9);
+        }
+
+        int iq = (int)std::lround(q);
+        iq = iq < 2 ? 2 : (iq > 41 ? 41 : iq);
+        qual[i] = 33 + iq;
+    }
+}
+
+bool
+ReadSimulator::
+parse_read_pair(ReadPair &the_read_pair)
+{
+    if (_params.num_pairs > 0 && _num_pairs >= _params.num_pairs) {
+        the_read_pair.first.clear();
+        the_read_pair.second.clear();
+        _at_end = true;
+        return false;
+    }
+
+    double insert = _params.insert_mean + _params.insert_sd * _normal();
+    size_t insert_len = insert < _params.min_insert ? _params.min_insert
+                                                     : (size_t)insert;
+    _fragment.resize(insert_len);
+    for (char &base: _fragment) {
+        base = bases[_rand() & 3];
+    }
+
+    std::ostringstream name;
+    name << _params.name_prefix << _num_pairs;
+    the_read_pair.first.name = name.str() + "/1";
+    the_read_pair.second.name = name.str() + "/2";
+
+    _make_read(_fragment, _params.adaptor_r1, the_read_pair.first);
+    // R2 is read from the other end of the fragment
+    std::reverse(_fragment.begin(), _fragment.end());
+    for (char &base: _fragment) {
+        base = complement(base);
+    }
+    _make_read(_fragment, _params.adaptor_r2, the_read_pair.second);
+
+    _num_pairs++;
+    _num_reads += 2;
+    return true;
+}
+
+bool
+ReadSimulator::
+parse_read(Read &the_read)
+{
+    if (_have_pending) {
+        the_read = _pending.second;
+        _have_pending = false;
+        return true;
+    }
+    if (!parse_read_pair(_pending)) {
+        the_read.clear();
+        return false;
+    }
+    the_read = _pending.first;
+    _have_pending = true;
+    return true;
+}
+
+size_t
+ReadSimulator::
+get_num_reads()
+{
+    return _num_reads;
+}
+
+size_t
+ReadSimulator::
+get_num_pairs()
+{
+    return _num_pairs;
+}
+
+} // namespace qcpp
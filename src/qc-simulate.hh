@@ -0,0 +1,91 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#ifndef QC_SIMULATE_HH
+#define QC_SIMULATE_HH
+
+#include "qc-config.hh"
+#include "qc-io.hh"
+
+namespace qcpp
+{
+
+struct SimulatorParams
+{
+    uint64_t        seed            = 1;
+    // Number of pairs to generate. 0 generates pairs forever.
+    size_t          num_pairs       = 0;
+    size_t          read_len        = 150;
+    // Fragment (insert) size is normally distributed, and never less than
+    // min_insert. Fragments shorter than read_len read through into adaptor.
+    double          insert_mean     = 350;
+    double          insert_sd       = 50;
+    size_t          min_insert      = 20;
+    std::string     adaptor_r1      = "AGATCGGAAGAGCACACGTCTGAACTCCAGTCA";
+    std::string     adaptor_r2      = "AGATCGGAAGAGCGTCGTGTAGGGAAAGAGTGT";
+    // Quality decays from qual_start at the 5' end to qual_end at the 3' end.
+    // qual_shape is the exponent of the decay curve: 1 is linear, larger
+    // values keep quality high for longer before dropping off.
+    int             qual_start      = 38;
+    int             qual_end        = 30;
+    double          qual_shape      = 2.0;
+    double          qual_sd         = 2.0;
+    // Per-base rate of substitution errors, which are given low quality.
+    double          error_rate      = 0.001;
+    // Per-base rate of N calls.
+    double          n_rate          = 0.0;
+    std::string     name_prefix     = "sim_";
+};
+
+class ReadSimulator: public ReadInputStream
+{
+public:
+    // Throws IOError if params.read_len is 0
+    ReadSimulator                   (const SimulatorParams &params=SimulatorParams());
+
+    // Yields R1 and R2 of each pair alternately, as an interleaved file would
+    bool
+    parse_read                      (Read              &the_read);
+
+    bool
+    parse_read_pair                 (ReadPair          &the_read_pair);
+
+    size_t
+    get_num_reads                   ();
+
+    size_t
+    get_num_pairs                   ();
+
+protected:
+    SimulatorParams         _params;
+    uint64_t                _rng_state;
+    size_t                  _num_pairs;
+    size_t                  _num_reads;
+    ReadPair                _pending;
+    bool                    _have_pending;
+    std::string             _fragment;
+
+    uint64_t
+    _rand                           ();
+
+    double
+    _uniform                        ();
+
+    double
+    _normal                         ();
+
+    void
+    _make_read                      (const std::string &template_seq,
+                                     const std::string &adaptor,
+                                     Read              &the_read);
+};
+
+} // namespace qcpp
+
+#endif /* QC_SIMULATE_HH */
@@ -11,6 +11,8 @@
 
 #include "qc-util.hh"
 
+#include <cstring>
+
 namespace qcpp
 {
 
@@ -33,5 +35,35 @@ global_report_yaml_header()
     return ss.str();
 }
 
+uint64_t
+hash_bytes(const char *data, size_t len, uint64_t seed)
+{
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    const unsigned char *tail;
+    uint64_t h = seed ^ (len * m);
+
+    for (; len >= 8; data += 8, len -= 8) {
+        uint64_t k;
+        memcpy(&k, data, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    tail = reinterpret_cast<const unsigned char *>(data);
+    if (len > 0) {
+        for (size_t i = 0; i < len; i++) {
+            h ^= uint64_t(tail[i]) << (8 * i);
+        }
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
 
 } // end namespace qcpp
@@ -13,6 +13,7 @@
 #include <string>
 #include <sstream>
 #include <mutex>
+#include <cstdint>
 #include "qc-config.hh"
 
 namespace qcpp
@@ -21,6 +22,29 @@ namespace qcpp
 std::string global_report_yaml_header();
 typedef std::lock_guard<std::mutex> std_mutex_lock;
 
+// A fast, non-cryptographic 64-bit hash (MurmurHash64A) of len bytes. Hashes
+// are only meant for use within one run, as they depend on byte order.
+uint64_t hash_bytes(const char *data, size_t len, uint64_t seed=0);
+
+inline uint64_t
+hash_bytes(const std::string &str, uint64_t seed=0)
+{
+    return hash_bytes(str.data(), str.size(), seed);
+}
+
+// Mixes the bits of an integer (the MurmurHash3 finaliser), so that similar
+// keys, like overlapping k-mers, give unrelated hashes
+inline uint64_t
+hash_int(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
 } // end namespace qcpp
 
 #endif /* QC_UTIL_HH */
@@ -17,6 +17,11 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "qc-io.hh"
 
 
 class TestConfig
@@ -158,4 +163,43 @@ filestrcmp(const std::string &filename,
     return false;
 }
 
+// Splits FASTQ text into records of lines_per_record lines, and sorts them,
+// for comparing output whose order is not deterministic
+static inline std::vector<std::string>
+sorted_records(const std::string &fastq, size_t lines_per_record)
+{
+    std::vector<std::string> records;
+    std::istringstream iss(fastq);
+    std::string line, record;
+    size_t n_lines = 0;
+
+    while (std::getline(iss, line)) {
+        record += line + "\n";
+        if (++n_lines % lines_per_record == 0) {
+            records.push_back(record);
+            record.clear();
+        }
+    }
+    std::sort(records.begin(), records.end());
+    return records;
+}
+
+// A uniformly random sequence of len bases
+static inline std::string
+random_seq(std::mt19937_64 &rng, size_t len)
+{
+    std::string seq;
+    for (size_t i = 0; i < len; i++) {
+        seq += "ACGT"[rng() % 4];
+    }
+    return seq;
+}
+
+// A read of seq, with every base of the highest quality
+static inline qcpp::Read
+make_read(const std::string &seq)
+{
+    return qcpp::Read("read", seq, std::string(seq.size(), 'I'));
+}
+
 #endif /* HELPERS_HH */
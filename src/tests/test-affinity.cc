@@ -0,0 +1,114 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-affinity.hh"
+
+#include <cstdio>
+#include <sys/stat.h>
+
+
+TEST_CASE("CPU lists are parsed", "[ThreadLayout]") {
+    SECTION("Ranges and single CPUs") {
+        std::vector<int> expect = {0, 1, 2, 3, 8, 10, 11};
+        REQUIRE(qcpp::parse_cpu_list("0-3,8,10-11\n") == expect);
+    }
+
+    SECTION("Empty lists") {
+        REQUIRE(qcpp::parse_cpu_list("").empty());
+        REQUIRE(qcpp::parse_cpu_list("\n").empty());
+    }
+
+    SECTION("Malformed lists are rejected") {
+        REQUIRE_THROWS_AS(qcpp::parse_cpu_list("3-1"), qcpp::IOError);
+        REQUIRE_THROWS_AS(qcpp::parse_cpu_list("0,a"), qcpp::IOError);
+        REQUIRE_THROWS_AS(qcpp::parse_cpu_list("0;1"), qcpp::IOError);
+    }
+}
+
+TEST_CASE("CPU topology is read from sysfs", "[ThreadLayout]") {
+    TestConfig *config = TestConfig::get_config();
+    // Without any NUMA information, all CPUs we may use are on one node
+    qcpp::CpuTopology flat = qcpp::CpuTopology::detect(
+            config->get_writable_file("missing", false));
+
+    REQUIRE(flat.num_nodes() == 1);
+    REQUIRE(flat.node_ids[0] == 0);
+    REQUIRE(flat.node_cpus[0].size() > 0);
+
+    SECTION("Nodes without usable CPUs are left out") {
+        std::string root = config->get_writable_file("sysfs");
+        std::string cpus;
+        for (int cpu: flat.node_cpus[0]) {
+            cpus += (cpus.size() > 0 ? "," : "") + std::to_string(cpu);
+        }
+
+        mkdir(root.c_str(), 0755);
+        mkdir((root + "/node0").c_str(), 0755);
+        mkdir((root + "/node1").c_str(), 0755);
+        mkdir((root + "/nodeX").c_str(), 0755);
+        std::ofstream(root + "/node0/cpulist") << cpus << "\n";
+        std::ofstream(root + "/node1/cpulist") << "100000\n";
+        std::ofstream(root + "/nodeX/cpulist") << "0\n";
+
+        qcpp::CpuTopology topology = qcpp::CpuTopology::detect(root);
+        REQUIRE(topology.node_ids == std::vector<int>{0});
+        REQUIRE(topology.node_cpus[0] == flat.node_cpus[0]);
+
+        for (const char *node: {"/node0", "/node1", "/nodeX"}) {
+            std::remove((root + node + "/cpulist").c_str());
+            std::remove((root + node).c_str());
+        }
+        std::remove(root.c_str());
+    }
+}
+
+TEST_CASE("Thread layouts group workers by node", "[ThreadLayout]") {
+    qcpp::CpuTopology topology;
+    topology.node_ids = {0, 1};
+    topology.node_cpus = {{0, 1}, {2, 3}};
+
+    SECTION("One worker per CPU") {
+        qcpp::ThreadLayout layout = qcpp::ThreadLayout::plan(topology, 4);
+        std::vector<size_t> nodes, expect_nodes = {0, 0, 1, 1};
+        std::vector<int> cpus, expect_cpus = {0, 1, 2, 3};
+
+        for (const qcpp::ThreadPlacement &worker: layout.workers) {
+            REQUIRE(worker.cpus.size() == 1);
+            nodes.push_back(worker.node);
+            cpus.push_back(worker.cpus[0]);
+        }
+        REQUIRE(nodes == expect_nodes);
+        REQUIRE(cpus == expect_cpus);
+        REQUIRE(layout.num_nodes() == 2);
+        REQUIRE(layout.reader.cpus == topology.node_cpus[0]);
+        REQUIRE(layout.writer.cpus == topology.node_cpus[0]);
+    }
+
+    SECTION("More workers than CPUs share CPUs on their node") {
+        qcpp::ThreadLayout layout = qcpp::ThreadLayout::plan(topology, 6);
+        std::vector<int> cpus, expect_cpus = {0, 1, 0, 2, 3, 2};
+
+        for (const qcpp::ThreadPlacement &worker: layout.workers) {
+            cpus.push_back(worker.cpus[0]);
+        }
+        REQUIRE(cpus == expect_cpus);
+    }
+
+    SECTION("Unpinned layouts") {
+        qcpp::ThreadLayout layout = qcpp::ThreadLayout::unpinned(3);
+        REQUIRE(layout.workers.size() == 3);
+        REQUIRE(layout.num_nodes() == 1);
+        for (const qcpp::ThreadPlacement &worker: layout.workers) {
+            REQUIRE(worker.cpus.empty());
+        }
+    }
+}
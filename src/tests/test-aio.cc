@@ -0,0 +1,142 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-aio.hh"
+#include "qc-io.hh"
+#include "qc-simulate.hh"
+
+
+static std::string
+slurp(const std::string &filename)
+{
+    std::ifstream ifs(filename);
+    return std::string((std::istreambuf_iterator<char>(ifs)),
+                       std::istreambuf_iterator<char>());
+}
+
+// A few hundred KiB of FASTQ, so that small buffers are reused many times
+static std::string
+simulated_fastq()
+{
+    qcpp::SimulatorParams params;
+    params.num_pairs = 1000;
+    qcpp::ReadSimulator sim(params);
+    qcpp::ReadPair rp;
+    std::string fastq;
+
+    while (sim.parse_read_pair(rp)) {
+        rp.append_to(fastq);
+    }
+    return fastq;
+}
+
+TEST_CASE("Asynchronous reading and writing", "[AsyncIO]") {
+    TestConfig         *config = TestConfig::get_config();
+    std::string         infile = config->get_writable_file("fastq", false);
+    std::string         outfile = config->get_writable_file("fastq", false);
+    std::string         expect = simulated_fastq();
+    qcpp::AsyncIOOptions opts;
+
+    {
+        std::ofstream ofs(infile);
+        ofs << expect;
+    }
+    opts.buffer_size = 4096;
+
+    SECTION("AsyncInputBuf reads whole file") {
+        for (size_t num_buffers: {1, 2, 5}) {
+            CAPTURE(num_buffers);
+            opts.num_buffers = num_buffers;
+            qcpp::AsyncInputBuf buf(infile, opts);
+            std::istream is(&buf);
+            std::string got((std::istreambuf_iterator<char>(is)),
+                            std::istreambuf_iterator<char>());
+            REQUIRE(got == expect);
+            REQUIRE(std::string(buf.backend()) == "pread");
+        }
+    }
+
+    SECTION("AsyncOutputBuf writes whole file") {
+        for (size_t num_buffers: {1, 2, 5}) {
+            CAPTURE(num_buffers);
+            opts.num_buffers = num_buffers;
+            qcpp::AsyncOutputBuf buf(outfile, opts);
+            std::ostream os(&buf);
+            // Odd-sized writes, which straddle buffers
+            for (size_t i = 0; i < expect.size(); i += 1001) {
+                os << expect.substr(i, 1001);
+            }
+            REQUIRE(os.good());
+            REQUIRE_NOTHROW(buf.close());
+            REQUIRE(slurp(outfile) == expect);
+        }
+    }
+
+    SECTION("BufferedReadWriter writing behind") {
+        for (size_t num_buffers: {1, 2, 5}) {
+            CAPTURE(num_buffers);
+            opts.num_buffers = num_buffers;
+            qcpp::ReadParser parser;
+            qcpp::BufferedReadWriter writer(1000);
+            qcpp::ReadPair rp;
+
+            REQUIRE_NOTHROW(parser.open(infile));
+            REQUIRE_NOTHROW(writer.open(outfile, opts));
+            while (parser.parse_read_pair(rp)) {
+                writer.write_read_pair(rp);
+            }
+            REQUIRE_NOTHROW(writer.close());
+            REQUIRE(slurp(outfile) == expect);
+        }
+    }
+}
+
+TEST_CASE("Asynchronous ReadParser matches ReadParser", "[AsyncIO]") {
+    TestConfig         *config = TestConfig::get_config();
+    qcpp::ReadParser    parser;
+    qcpp::ReadParser    async_parser;
+    qcpp::Read          read, async_read;
+    qcpp::AsyncIOOptions opts;
+    std::string         infile;
+
+    SECTION("valid_il.fastq") {
+        infile = config->get_data_file("valid_il.fastq");
+    }
+    SECTION("valid.fasta") {
+        infile = config->get_data_file("valid.fasta");
+    }
+    SECTION("gzip compressed") {
+        infile = config->get_data_file("tricky-gbs.fq.gz");
+    }
+
+    CAPTURE(infile);
+    opts.buffer_size = 4096;
+    REQUIRE_NOTHROW(parser.open(infile));
+    REQUIRE_NOTHROW(async_parser.open(infile, opts));
+    while (parser.parse_read(read)) {
+        REQUIRE(async_parser.parse_read(async_read));
+        REQUIRE(read == async_read);
+    }
+    REQUIRE_FALSE(async_parser.parse_read(async_read));
+    REQUIRE(async_parser.get_num_reads() == parser.get_num_reads());
+}
+
+TEST_CASE("Asynchronous IO errors", "[AsyncIO]") {
+    qcpp::ReadParser    parser;
+    TestConfig         *config = TestConfig::get_config();
+
+    REQUIRE_THROWS_AS(qcpp::AsyncInputBuf("/nonexistent/file"), qcpp::IOError);
+    REQUIRE_THROWS_AS(qcpp::AsyncOutputBuf("/nonexistent/dir/file"), qcpp::IOError);
+    REQUIRE_THROWS_AS(parser.open(config->get_data_file("empty.fastq"),
+                                  qcpp::AsyncIOOptions()),
+                      qcpp::IOError);
+}
@@ -0,0 +1,251 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-batch.hh"
+#include "qc-adaptor.hh"
+#include "qc-measure.hh"
+#include "qc-qualtrim.hh"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+
+// Counts the copies that exist at once, and is slow to merge, so that
+// pipelines still being merged overlap with newly opened ones
+class LiveCounter: public qcpp::ReadProcessor
+{
+public:
+    static std::atomic<size_t> live;
+    static std::atomic<size_t> max_live;
+
+    LiveCounter(const std::string &name)
+        : qcpp::ReadProcessor(name, qcpp::SangerEncoding)
+    {
+        size_t now = ++live;
+        size_t prev = max_live;
+        while (now > prev && !max_live.compare_exchange_weak(prev, now)) {
+        }
+    }
+
+    ~LiveCounter()
+    {
+        live--;
+    }
+
+    void
+    process_read(qcpp::Read &)
+    {
+    }
+
+    void
+    process_read_pair(qcpp::ReadPair &)
+    {
+    }
+
+    void
+    add_stats_from(qcpp::ReadProcessor *)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    std::string
+    yaml_report()
+    {
+        return "";
+    }
+};
+
+std::atomic<size_t> LiveCounter::live(0);
+std::atomic<size_t> LiveCounter::max_live(0);
+
+static std::string
+read_file(const std::string &filename)
+{
+    std::ifstream fp(filename);
+    std::ostringstream ss;
+    ss << fp.rdbuf();
+    return ss.str();
+}
+
+TEST_CASE("Batch manifests are parsed", "[BatchQCProcessor]") {
+    TestConfig *config = TestConfig::get_config();
+    std::string manifest = config->get_writable_file("yml", false);
+
+    SECTION("Valid manifest") {
+        std::ofstream(manifest) << "- input: a.fq\n"
+                                << "  output: a.out.fq\n"
+                                << "  report: a.yml\n"
+                                << "- input: b.fq\n"
+                                << "  input_r2: b_R2.fq\n"
+                                << "  output: b.out.fq\n"
+                                << "  orphans: b.orphans.fq\n";
+        std::vector<qcpp::BatchJob> jobs = qcpp::read_batch_manifest(manifest);
+
+        REQUIRE(jobs.size() == 2);
+        REQUIRE(jobs[0].input == "a.fq");
+        REQUIRE(jobs[0].output == "a.out.fq");
+        REQUIRE(jobs[0].input_r2 == "");
+        REQUIRE(jobs[1].input_r2 == "b_R2.fq");
+        REQUIRE(jobs[0].orphans == "");
+        REQUIRE(jobs[0].report == "a.yml");
+        REQUIRE(jobs[1].orphans == "b.orphans.fq");
+        REQUIRE(jobs[1].report == "");
+    }
+
+    SECTION("Jobs without an output are rejected") {
+        std::ofstream(manifest) << "- input: a.fq\n";
+        REQUIRE_THROWS_AS(qcpp::read_batch_manifest(manifest), qcpp::IOError);
+    }
+
+    SECTION("Missing manifests are rejected") {
+        REQUIRE_THROWS_AS(qcpp::read_batch_manifest(manifest + ".missing"),
+                          qcpp::IOError);
+    }
+}
+
+TEST_CASE("BatchQCProcessor matches ProcessedReadStream", "[BatchQCProcessor]") {
+    TestConfig         *config = TestConfig::get_config();
+    std::string         infiles[] = {
+        config->get_data_file("tm-merge.fastq"),
+        config->get_data_file("valid_il.fastq"),
+        config->get_data_file("tm-trim.fastq"),
+    };
+    std::vector<qcpp::BatchJob> jobs;
+
+    for (const std::string &infile: infiles) {
+        qcpp::BatchJob job;
+        job.input = infile;
+        job.output = config->get_writable_file("fastq", false);
+        job.report = config->get_writable_file("yml", false);
+        jobs.push_back(job);
+    }
+
+    SECTION("Paired, with more jobs than threads") {
+        qcpp::BatchQCProcessor batch(2);
+        size_t n_pairs = 0;
+
+        batch.add_jobs(jobs);
+        batch.append_processor<qcpp::AdaptorTrimPE>("tm", 4);
+        batch.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        batch.append_processor<qcpp::PerBaseQuality>("after qc");
+        size_t n_processed = batch.run();
+
+        REQUIRE(batch.get_num_jobs() == 3);
+        // All three jobs may be active at once, each with two pipelines
+        REQUIRE(batch.max_pipelines() == 6);
+        for (size_t i = 0; i < jobs.size(); i++) {
+            qcpp::ProcessedReadStream stream(jobs[i].input);
+            qcpp::PairedOutput policy;
+            qcpp::ReadPair rp;
+            std::string serial_out, serial_orphans;
+
+            stream.append_processor<qcpp::AdaptorTrimPE>("tm", 4);
+            stream.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+            stream.append_processor<qcpp::PerBaseQuality>("after qc");
+            while (stream.parse_read_pair(rp)) {
+                policy.format(rp, serial_out, serial_orphans);
+                n_pairs++;
+            }
+            REQUIRE(sorted_records(read_file(jobs[i].output), 8) ==
+                    sorted_records(serial_out, 8));
+            REQUIRE(batch.report(i) == stream.report());
+            REQUIRE(read_file(jobs[i].report) == stream.report());
+        }
+        REQUIRE(n_processed == n_pairs);
+    }
+
+    SECTION("Single-end") {
+        qcpp::BatchQCProcessorSE batch(3);
+        size_t n_reads = 0;
+
+        batch.add_jobs(jobs);
+        batch.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        size_t n_processed = batch.run();
+        // Only three jobs can be active
+        REQUIRE(batch.max_pipelines() == 9);
+
+        for (size_t i = 0; i < jobs.size(); i++) {
+            qcpp::ProcessedReadStream stream(jobs[i].input);
+            qcpp::SingleOutput policy;
+            qcpp::Read read;
+            std::string serial_out, serial_orphans;
+
+            stream.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+            while (stream.parse_read(read)) {
+                policy.format(read, serial_out, serial_orphans);
+                n_reads++;
+            }
+            REQUIRE(sorted_records(read_file(jobs[i].output), 4) ==
+                    sorted_records(serial_out, 4));
+        }
+        REQUIRE(n_processed == n_reads);
+    }
+
+    SECTION("Separate R1 and R2 files") {
+        qcpp::BatchQCProcessor batch(2);
+
+        jobs[1].input = config->get_data_file("valid_R1.fastq");
+        jobs[1].input_r2 = config->get_data_file("valid_R2.fastq");
+        batch.add_jobs(jobs);
+        batch.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        batch.run();
+
+        // The same as the interleaved file
+        qcpp::ProcessedReadStream stream(config->get_data_file("valid_il.fastq"));
+        qcpp::PairedOutput policy;
+        qcpp::ReadPair rp;
+        std::string serial_out, serial_orphans;
+
+        stream.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        while (stream.parse_read_pair(rp)) {
+            policy.format(rp, serial_out, serial_orphans);
+        }
+        REQUIRE(sorted_records(read_file(jobs[1].output), 8) ==
+                sorted_records(serial_out, 8));
+        REQUIRE(batch.report(1) == stream.report());
+
+        qcpp::BatchQCProcessorSE single(2);
+        single.add_jobs(jobs);
+        REQUIRE_THROWS_AS(single.run(), qcpp::IOError);
+    }
+
+    SECTION("Errors in any job are rethrown by run()") {
+        qcpp::BatchQCProcessor batch(2);
+
+        jobs[1].input = config->get_data_file("empty.fastq");
+        batch.add_jobs(jobs);
+        REQUIRE_THROWS_AS(batch.run(), qcpp::IOError);
+    }
+}
+
+TEST_CASE("BatchQCProcessor keeps to max_pipelines", "[BatchQCProcessor]") {
+    TestConfig         *config = TestConfig::get_config();
+    std::vector<qcpp::BatchJob> jobs;
+
+    for (size_t i = 0; i < 8; i++) {
+        qcpp::BatchJob job;
+        job.input = config->get_data_file("valid_il.fastq");
+        job.output = config->get_writable_file("fastq", false);
+        jobs.push_back(job);
+    }
+
+    qcpp::BatchQCProcessor batch(2);
+    batch.add_jobs(jobs);
+    batch.append_processor<LiveCounter>("live");
+    LiveCounter::max_live = 0;
+    REQUIRE(batch.run() == 8u * 5);
+    REQUIRE(LiveCounter::max_live > 0u);
+    REQUIRE(LiveCounter::max_live <= batch.max_pipelines());
+    // Finished jobs keep only their reports
+    REQUIRE(LiveCounter::live == 0u);
+}
@@ -0,0 +1,116 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-complexity.hh"
+
+#include <cmath>
+#include <random>
+
+
+// A read whose sequence is made from n, so reads of equal n are duplicates
+static qcpp::Read
+numbered_read(size_t n)
+{
+    std::string seq;
+    for (; n > 0; n /= 4) {
+        seq += "ACGT"[n % 4];
+    }
+    seq += "TTTTTTTTTT";
+    return qcpp::Read("read", seq, std::string(seq.size(), 'I'));
+}
+
+TEST_CASE("HyperLogLog estimates distinct hashes", "[ComplexityEstimator]") {
+    std::mt19937_64 rng(3);
+
+    for (size_t n: {100, 5000, 200000}) {
+        qcpp::HyperLogLog hll, half;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t hash = rng();
+            hll.add(hash);
+            hll.add(hash);
+            if (i % 2 == 0) {
+                half.add(hash);
+            }
+        }
+        CAPTURE(n);
+        REQUIRE(std::abs(hll.estimate() - n) < n * 0.03);
+        REQUIRE(half.estimate() < hll.estimate());
+
+        // Merging is the same as adding the hashes
+        half.merge(hll);
+        REQUIRE(half.estimate() == hll.estimate());
+    }
+}
+
+TEST_CASE("Library sizes are estimated", "[ComplexityEstimator]") {
+    // A library of 1000 molecules gives 1000 * (1 - e^-1) distinct in 1000
+    double distinct = 1000 * (1 - std::exp(-1.0));
+    REQUIRE(std::abs(qcpp::lander_waterman_library_size(1000, distinct) - 1000) < 1);
+    REQUIRE(qcpp::lander_waterman_library_size(1000, 1000) == 0);
+}
+
+TEST_CASE("ComplexityEstimator measures duplication", "[ComplexityEstimator]") {
+    // 20000 sequences, each seen twice
+    std::vector<qcpp::Read> reads;
+    for (size_t i = 0; i < 40000; i++) {
+        reads.push_back(numbered_read(i % 20000));
+    }
+
+    SECTION("Estimates") {
+        qcpp::ComplexityEstimator est("complexity", 14, 1000);
+        for (auto &read: reads) {
+            est.process_read(read);
+        }
+        REQUIRE(est.num_sequences() == 40000);
+        REQUIRE(std::abs(est.distinct_sequences() - 20000) < 600);
+        REQUIRE(est.library_size() > est.distinct_sequences());
+        // Curves come from a sample of about 1000 sequences
+        REQUIRE(std::abs(est.expected_distinct(1) - 20000) < 2000);
+        REQUIRE(std::abs(est.expected_distinct(0.5) - 15000) < 1500);
+        REQUIRE(est.expected_distinct(2) > est.expected_distinct(1));
+        // Reads are not modified
+        REQUIRE(reads[0].size() == numbered_read(0).size());
+
+        std::string report = est.yaml_report();
+        REQUIRE(report.find("num_sequences: 40000") != std::string::npos);
+        REQUIRE(report.find("duplicate_rate: 0.5") != std::string::npos);
+        REQUIRE(report.find("complexity_curve") != std::string::npos);
+    }
+
+    SECTION("Merged estimates match a single estimator") {
+        qcpp::ComplexityEstimator single("complexity", 12, 500);
+        qcpp::ComplexityEstimator a("complexity", 12, 500), b("complexity", 12, 500);
+
+        for (size_t i = 0; i < reads.size(); i++) {
+            single.process_read(reads[i]);
+            (i % 3 == 0 ? a : b).process_read(reads[i]);
+        }
+        a.add_stats_from(&b);
+        REQUIRE(a.yaml_report() == single.yaml_report());
+    }
+
+    SECTION("Read pairs") {
+        qcpp::ComplexityEstimator est("complexity");
+        qcpp::ReadPair rp1, rp2, rp3;
+
+        rp1.first = rp2.first = rp3.first = numbered_read(1);
+        rp1.second = rp3.second = numbered_read(2);
+        rp2.second = numbered_read(3);
+
+        est.process_read_pair(rp1);
+        est.process_read_pair(rp2);
+        est.process_read_pair(rp3);
+        REQUIRE(est.num_sequences() == 3);
+        REQUIRE(std::llround(est.distinct_sequences()) == 2);
+        REQUIRE(std::llround(est.expected_distinct(1)) == 2);
+    }
+}
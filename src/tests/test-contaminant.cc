@@ -0,0 +1,306 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-contaminant.hh"
+#include "qc-packed.hh"
+
+#include <atomic>
+#include <fstream>
+#include <random>
+#include <thread>
+
+
+TEST_CASE("MinimizerIndex minimizers", "[ContaminantFilter]") {
+    std::mt19937_64 rng(23);
+    qcpp::MinimizerIndex index(21, 11);
+    std::string seq = random_seq(rng, 200);
+    std::string rc = qcpp::PackedSequence(seq).reverse_complement().str();
+    std::vector<uint64_t> fw_mins, rc_mins;
+
+    index.minimizers(seq, fw_mins);
+    index.minimizers(rc, rc_mins);
+    // 180 k-mers in windows of 11 give about 2 * 180 / 12 minimizers
+    REQUIRE(fw_mins.size() > 15);
+    REQUIRE(fw_mins.size() < 60);
+    // k-mers are canonical, so the reverse complement has the same set
+    std::sort(fw_mins.begin(), fw_mins.end());
+    std::sort(rc_mins.begin(), rc_mins.end());
+    REQUIRE(fw_mins == rc_mins);
+
+    // Reads shorter than a window still give a minimizer, and those shorter
+    // than k none
+    index.minimizers(seq.substr(0, 25), fw_mins);
+    REQUIRE(fw_mins.size() == 1);
+    index.minimizers(seq.substr(0, 20), fw_mins);
+    REQUIRE(fw_mins.size() == 0);
+    index.minimizers(seq.substr(0, 22) + "N" + seq.substr(100, 22), fw_mins);
+    REQUIRE(fw_mins.size() == 2);
+
+    // Packed sequences give the same minimizers
+    std::string ambiguous = seq.substr(0, 90) + "N" + seq.substr(90);
+    index.minimizers(ambiguous, fw_mins);
+    index.minimizers(qcpp::PackedSequence(ambiguous), rc_mins);
+    REQUIRE(rc_mins == fw_mins);
+}
+
+TEST_CASE("MinimizerIndex references", "[ContaminantFilter]") {
+    std::mt19937_64 rng(29);
+    qcpp::MinimizerIndex index;
+    std::string phix = random_seq(rng, 1000);
+    std::string vector = random_seq(rng, 1000);
+    std::string shared = random_seq(rng, 100);
+    std::vector<uint64_t> mins;
+
+    index.add_sequence("phix", phix + shared);
+    index.add_sequence("vector", vector);
+    // Soft-masked sequence is indexed as upper case
+    std::string lower = shared;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    index.add_sequence("vector", lower);
+
+    REQUIRE(index.num_references() == 2);
+    REQUIRE(index.reference_name(0) == "phix");
+    REQUIRE(index.reference_name(1) == "vector");
+    REQUIRE(index.size() > 100);
+    REQUIRE(index.memory_size() >= 2 * index.size() * 16);
+
+    index.minimizers(phix.substr(100, 100), mins);
+    for (uint64_t hash: mins) {
+        REQUIRE(index.lookup(hash) == 0);
+    }
+    index.minimizers(vector.substr(500, 100), mins);
+    for (uint64_t hash: mins) {
+        REQUIRE(index.lookup(hash) == 1);
+    }
+    index.minimizers(shared.substr(10, 80), mins);
+    for (uint64_t hash: mins) {
+        REQUIRE(index.lookup(hash) == qcpp::MinimizerIndex::multiple_references);
+    }
+    index.minimizers(random_seq(rng, 100), mins);
+    for (uint64_t hash: mins) {
+        REQUIRE(index.lookup(hash) == qcpp::MinimizerIndex::no_reference);
+    }
+}
+
+TEST_CASE("MinimizerIndex from files", "[ContaminantFilter]") {
+    TestConfig *config = TestConfig::get_config();
+    std::string fasta = config->get_data_file("valid.fasta");
+    qcpp::ReadParser parser;
+    qcpp::Read read;
+
+    auto index = qcpp::MinimizerIndex::from_files({fasta});
+    REQUIRE(index->num_references() == 1);
+    REQUIRE(index->reference_name(0) == "valid");
+    REQUIRE(index->size() > 0);
+
+    // Every read of the file is its own contaminant
+    qcpp::ContaminantFilter filter("contaminants", index);
+    parser.open(fasta);
+    while (parser.parse_read(read)) {
+        filter.process_read(read);
+        REQUIRE(read.size() == 0);
+    }
+    REQUIRE(filter.num_checked() == 10);
+    REQUIRE(filter.num_contaminated() == 10);
+    REQUIRE(filter.num_contaminated_by(0) == 10);
+
+    REQUIRE_THROWS_AS(qcpp::MinimizerIndex::from_files({"/nonexistent.fa"}),
+                      qcpp::IOError);
+}
+
+TEST_CASE("MinimizerIndex files", "[ContaminantFilter]") {
+    TestConfig *config = TestConfig::get_config();
+    std::string filename = config->get_writable_file("idx", false);
+    std::mt19937_64 rng(37);
+    qcpp::MinimizerIndex index(19, 7);
+    std::string phix = random_seq(rng, 5000);
+    std::string vector = random_seq(rng, 5000);
+    std::vector<uint64_t> mins;
+
+    index.add_sequence("phix", phix);
+    index.add_sequence("vector", vector);
+    index.save(filename);
+
+    auto loaded = qcpp::MinimizerIndex::load(filename);
+    REQUIRE(loaded->k() == 19);
+    REQUIRE(loaded->w() == 7);
+    REQUIRE(loaded->num_references() == 2);
+    REQUIRE(loaded->reference_name(0) == "phix");
+    REQUIRE(loaded->reference_name(1) == "vector");
+    REQUIRE(loaded->size() == index.size());
+    REQUIRE(loaded->memory_size() == index.memory_size());
+    for (const std::string &seq: {phix, vector, random_seq(rng, 1000)}) {
+        index.minimizers(seq, mins);
+        for (uint64_t hash: mins) {
+            REQUIRE(loaded->lookup(hash) == index.lookup(hash));
+        }
+    }
+
+    SECTION("Loaded indices screen reads") {
+        qcpp::ContaminantFilter filter("contaminants", loaded);
+        auto read = make_read(vector.substr(1000, 100));
+        filter.process_read(read);
+        REQUIRE(read.size() == 0);
+        REQUIRE(filter.num_contaminated_by(1) == 1);
+    }
+
+    SECTION("Loaded indices may be added to") {
+        std::string more = random_seq(rng, 5000);
+        loaded->add_sequence("more", more);
+        index.add_sequence("more", more);
+        REQUIRE(loaded->size() == index.size());
+        loaded->minimizers(more, mins);
+        for (uint64_t hash: mins) {
+            REQUIRE(loaded->lookup(hash) == 2);
+        }
+    }
+
+    SECTION("Saved indices are reproducible") {
+        std::string again = config->get_writable_file("idx", false);
+        loaded->save(again);
+        std::ifstream a(filename, std::ios::binary), b(again, std::ios::binary);
+        std::string a_bytes((std::istreambuf_iterator<char>(a)), std::istreambuf_iterator<char>());
+        std::string b_bytes((std::istreambuf_iterator<char>(b)), std::istreambuf_iterator<char>());
+        REQUIRE(a_bytes.size() == 64 + 64 + index.memory_size());
+        REQUIRE(a_bytes == b_bytes);
+    }
+
+    SECTION("Indices may be saved concurrently") {
+        std::string shared = config->get_writable_file("idx", false);
+        std::vector<std::thread> savers;
+        std::atomic<size_t> failures(0);
+        for (size_t i = 0; i < 4; i++) {
+            savers.emplace_back([&] {
+                try {
+                    loaded->save(shared);
+                } catch (qcpp::IOError &) {
+                    failures++;
+                }
+            });
+        }
+        for (auto &thr: savers) {
+            thr.join();
+        }
+        REQUIRE(failures == 0u);
+        auto again = qcpp::MinimizerIndex::load(shared);
+        REQUIRE(again->size() == index.size());
+    }
+
+    SECTION("Bad files") {
+        std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+        std::string bad = config->get_writable_file("idx", false);
+        std::ofstream(bad, std::ios::binary) << "QCPPMIDX, but no more";
+
+        // Flip a byte in the table
+        file.seekp(64 + 64 + 100);
+        file.put('\xff');
+        file.close();
+        REQUIRE_THROWS_AS(qcpp::MinimizerIndex::load(filename), qcpp::IOError);
+        REQUIRE_THROWS_AS(qcpp::MinimizerIndex::load(bad), qcpp::IOError);
+        REQUIRE_THROWS_AS(qcpp::MinimizerIndex::load(config->get_data_file("valid.fasta")),
+                          qcpp::IOError);
+        REQUIRE_THROWS_AS(qcpp::MinimizerIndex::load("/nonexistent.idx"), qcpp::IOError);
+        REQUIRE_THROWS_AS(index.save("/nonexistent/dir/out.idx"), qcpp::IOError);
+    }
+}
+
+TEST_CASE("ContaminantFilter screens reads", "[ContaminantFilter]") {
+    std::mt19937_64 rng(31);
+    auto index = std::make_shared<qcpp::MinimizerIndex>();
+    std::string phix = random_seq(rng, 5000);
+    std::string vector = random_seq(rng, 5000);
+
+    index->add_sequence("phix", phix);
+    index->add_sequence("vector", vector);
+
+    SECTION("Remove") {
+        qcpp::ContaminantFilter filter("contaminants", index);
+        auto read = make_read(phix.substr(1000, 100));
+        filter.process_read(read);
+        REQUIRE(read.size() == 0);
+
+        // Reverse complements are found too
+        std::string rc = qcpp::PackedSequence(vector.substr(200, 100))
+                            .reverse_complement().str();
+        read = make_read(rc);
+        filter.process_read(read);
+        REQUIRE(read.size() == 0);
+
+        read = make_read(random_seq(rng, 100));
+        filter.process_read(read);
+        REQUIRE(read.size() == 100);
+
+        // Only a quarter of this read is contaminant
+        read = make_read(phix.substr(0, 25) + random_seq(rng, 75));
+        filter.process_read(read);
+        REQUIRE(read.size() == 100);
+
+        REQUIRE(filter.num_checked() == 4);
+        REQUIRE(filter.num_contaminated() == 2);
+        REQUIRE(filter.num_contaminated_by(0) == 1);
+        REQUIRE(filter.num_contaminated_by(1) == 1);
+    }
+
+    SECTION("Flag") {
+        qcpp::ContaminantFilter filter("contaminants", index, 0.5, false);
+        auto read = make_read(vector.substr(3000, 100));
+        filter.process_read(read);
+        REQUIRE(read.size() == 100);
+        REQUIRE(read.name == "read contaminant=vector");
+
+        read = make_read(random_seq(rng, 100));
+        filter.process_read(read);
+        REQUIRE(read.name == "read");
+    }
+
+    SECTION("Packed reads") {
+        qcpp::ContaminantFilter filter("contaminants", index);
+        qcpp::PackedRead read(make_read(phix.substr(2000, 100)));
+        filter.process_read(read);
+        REQUIRE(read.size() == 0);
+        REQUIRE(read.quality.size() == 0);
+
+        read.pack(make_read(random_seq(rng, 100)));
+        filter.process_read(read);
+        REQUIRE(read.size() == 100);
+        REQUIRE(filter.num_checked() == 2);
+        REQUIRE(filter.num_contaminated_by(0) == 1);
+    }
+
+    SECTION("Pairs") {
+        qcpp::ContaminantFilter filter("contaminants", index), other("contaminants", index);
+        qcpp::ReadPair rp;
+        rp.first = make_read(phix.substr(0, 100));
+        rp.second = make_read(phix.substr(300, 100));
+        filter.process_read_pair(rp);
+        REQUIRE(rp.first.size() == 0);
+        REQUIRE(rp.second.size() == 0);
+
+        // Pairs are screened as one, so a partly contaminant mate isn't
+        // enough at the default fraction
+        rp.first = make_read(phix.substr(0, 50) + random_seq(rng, 50));
+        rp.second = make_read(random_seq(rng, 100));
+        other.process_read_pair(rp);
+        REQUIRE(rp.first.size() == 100);
+        REQUIRE(rp.second.size() == 100);
+
+        filter.add_stats_from(&other);
+        REQUIRE(filter.num_checked() == 2);
+        REQUIRE(filter.num_contaminated() == 1);
+
+        std::string report = filter.yaml_report();
+        REQUIRE(report.find("num_reads: 4") != std::string::npos);
+        REQUIRE(report.find("num_contaminated: 1") != std::string::npos);
+        REQUIRE(report.find("phix: 1") != std::string::npos);
+        REQUIRE(report.find("vector: 0") != std::string::npos);
+    }
+}
@@ -0,0 +1,155 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-duplicate.hh"
+
+#include <random>
+#include <set>
+#include <thread>
+
+
+TEST_CASE("Sequences are hashed", "[DuplicateFilter]") {
+    std::set<uint64_t> hashes;
+    std::string seq = "ACGTACGTACGTACGTAC";
+
+    // Every prefix, so every tail length
+    for (size_t len = 0; len <= seq.size(); len++) {
+        hashes.insert(qcpp::hash_bytes(seq.substr(0, len)));
+    }
+    REQUIRE(hashes.size() == seq.size() + 1);
+    REQUIRE(qcpp::hash_bytes(seq) == qcpp::hash_bytes(seq.data(), seq.size()));
+    REQUIRE(qcpp::hash_bytes(seq, 1) != qcpp::hash_bytes(seq, 2));
+}
+
+TEST_CASE("DuplicateSet finds repeated hashes", "[DuplicateFilter]") {
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> hashes;
+
+    for (size_t i = 0; i < 100000; i++) {
+        hashes.push_back(rng());
+    }
+    hashes.push_back(0);
+
+    SECTION("Exactly within the memory budget") {
+        qcpp::DuplicateSet set(16 << 20);
+
+        for (uint64_t hash: hashes) {
+            REQUIRE_FALSE(set.insert(hash));
+        }
+        for (uint64_t hash: hashes) {
+            REQUIRE(set.insert(hash));
+        }
+        REQUIRE(set.size() == hashes.size());
+        REQUIRE(set.num_approximate_shards() == 0);
+        REQUIRE(set.false_positive_rate() == 0);
+        REQUIRE(set.memory_size() <= set.memory_budget());
+    }
+
+    SECTION("Approximately beyond it") {
+        // Room for about 16K hashes in tables
+        qcpp::DuplicateSet set(256 << 10, 16);
+        size_t false_positives = 0;
+
+        for (uint64_t hash: hashes) {
+            false_positives += set.insert(hash);
+        }
+        // Bloom filters never miss a hash
+        for (uint64_t hash: hashes) {
+            REQUIRE(set.insert(hash));
+        }
+        REQUIRE(set.num_approximate_shards() == 16);
+        REQUIRE(set.memory_size() <= set.memory_budget());
+        REQUIRE(set.size() == hashes.size() - false_positives);
+        REQUIRE(set.false_positive_rate() > 0);
+        REQUIRE(set.false_positive_rate() < 0.01);
+        REQUIRE(false_positives < hashes.size() / 100);
+    }
+
+    SECTION("Shared between threads") {
+        qcpp::DuplicateSet set;
+        std::vector<std::thread> threads;
+        std::atomic_size_t num_present(0);
+
+        // Each hash is inserted twice, by different threads
+        for (size_t t = 0; t < 4; t++) {
+            threads.emplace_back([&, t]() {
+                for (size_t i = t % 2; i < hashes.size(); i += 2) {
+                    num_present += set.insert(hashes[i]);
+                }
+            });
+        }
+        for (auto &thread: threads) {
+            thread.join();
+        }
+        REQUIRE(num_present == hashes.size());
+        REQUIRE(set.size() == hashes.size());
+    }
+}
+
+TEST_CASE("DuplicateFilter removes duplicate reads", "[DuplicateFilter]") {
+    SECTION("Single reads") {
+        qcpp::DuplicateFilter dups("dups");
+        std::vector<qcpp::Read> reads = {
+            {"r1", "ACGTACGT", "IIIIIIII"},
+            {"r2", "ACGTACGA", "IIIIIIII"},
+            {"r3", "ACGTACGT", "########"},
+            {"r4", "", ""},
+        };
+
+        for (auto &read: reads) {
+            dups.process_read(read);
+        }
+        REQUIRE(reads[0].size() == 8);
+        REQUIRE(reads[1].size() == 8);
+        REQUIRE(reads[2].size() == 0);
+
+        std::string report = dups.yaml_report();
+        REQUIRE(report.find("num_reads: 4") != std::string::npos);
+        REQUIRE(report.find("num_checked: 3") != std::string::npos);
+        REQUIRE(report.find("num_duplicates: 1") != std::string::npos);
+    }
+
+    SECTION("Read pairs") {
+        qcpp::DuplicateFilter dups("dups");
+        std::vector<qcpp::ReadPair> pairs = {
+            {"p1", "ACGT", "IIII", "p1", "TTTT", "IIII"},
+            {"p2", "ACGT", "IIII", "p2", "TTTA", "IIII"},
+            {"p3", "ACGTT", "IIIII", "p3", "TTT", "III"},
+            {"p4", "ACGT", "####", "p4", "TTTT", "####"},
+        };
+
+        for (auto &pair: pairs) {
+            dups.process_read_pair(pair);
+        }
+        REQUIRE(pairs[1].first.size() == 4);
+        REQUIRE(pairs[2].first.size() == 5);
+        REQUIRE(pairs[3].first.size() == 0);
+        REQUIRE(pairs[3].second.size() == 0);
+        REQUIRE(dups.yaml_report().find("duplicate_rate: 0.25") != std::string::npos);
+    }
+
+    SECTION("Filters sharing a set") {
+        std::shared_ptr<qcpp::DuplicateSet> set = std::make_shared<qcpp::DuplicateSet>();
+        qcpp::DuplicateFilter a("dups", set), b("dups", set);
+        qcpp::Read r1("r1", "ACGT", "IIII"), r2("r2", "ACGT", "IIII");
+
+        a.process_read(r1);
+        b.process_read(r2);
+        REQUIRE(r1.size() == 4);
+        REQUIRE(r2.size() == 0);
+
+        a.add_stats_from(&b);
+        std::string report = a.yaml_report();
+        REQUIRE(report.find("num_checked: 2") != std::string::npos);
+        REQUIRE(report.find("distinct_sequences: 1") != std::string::npos);
+    }
+}
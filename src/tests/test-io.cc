@@ -52,6 +52,19 @@ TEST_CASE("Read structure behaves correctly", "[Read]") {
         REQUIRE(read.str() == ">Name\nACGT\n");
     }
 
+    SECTION("append_to() appends to existing buffer") {
+        std::string buffer = "prefix\n";
+        read.append_to(buffer);
+        REQUIRE(buffer == "prefix\n@Name\nACGT\n+\nIIII\n");
+    }
+
+    SECTION("append_to() skips empty reads") {
+        std::string buffer;
+        read.sequence.clear();
+        read.append_to(buffer);
+        REQUIRE(buffer == "");
+    }
+
     SECTION("Erase with just start") {
         read.erase(1);
         REQUIRE(read.sequence == "A");
@@ -80,6 +93,33 @@ TEST_CASE("Read structure behaves correctly", "[Read]") {
     }
 }
 
+TEST_CASE("ReadPair serialisation", "[ReadPair]") {
+    qcpp::ReadPair rp("seq1", "ACGT", "IIII",
+                      "seq2", "TTGA", "JJJJ");
+    std::string buffer;
+
+    SECTION("Intact pairs give both records") {
+        rp.append_to(buffer);
+        REQUIRE(buffer == "@seq1\nACGT\n+\nIIII\n@seq2\nTTGA\n+\nJJJJ\n");
+        REQUIRE(rp.str() == buffer);
+    }
+
+    SECTION("Removed reads are replaced with a placeholder") {
+        rp.first.erase(0);
+        rp.append_to(buffer);
+        REQUIRE(buffer == "@seq1\nN\n+\nB\n@seq2\nTTGA\n+\nJJJJ\n");
+        REQUIRE(rp.str() == buffer);
+    }
+
+    SECTION("FASTA placeholders have no quality") {
+        rp.first.quality.clear();
+        rp.second.quality.clear();
+        rp.second.sequence.clear();
+        rp.append_to(buffer);
+        REQUIRE(buffer == ">seq1\nACGT\n>seq2\nN\n");
+    }
+}
+
 TEST_CASE("ReadParser opening works", "[ReadParser]") {
     qcpp::ReadParser parser;
     TestConfig *config = TestConfig::get_config();
@@ -159,6 +199,54 @@ TEST_CASE("Parsing of invalid or weird files", "[ReadParser]") {
     }
 }
 
+TEST_CASE("Chunks are parsed over in place", "[ReadParser]") {
+    qcpp::ReadParser parser;
+    TestConfig *config = TestConfig::get_config();
+    std::vector<qcpp::Read> chunk(6);
+
+    for (qcpp::Read &read: chunk) {
+        read.sequence.reserve(1000);
+    }
+    const char *buffer = chunk[0].sequence.data();
+
+    parser.open(config->get_data_file("valid_il.fastq"));
+    REQUIRE(parser.parse_chunk(chunk, 4));
+    REQUIRE(chunk.size() == 4);
+    REQUIRE(chunk[0].sequence.size() > 0);
+    // The first read's memory is reused
+    REQUIRE(chunk[0].sequence.data() == buffer);
+    REQUIRE(chunk[0].sequence.capacity() >= 1000);
+
+    // Chunks grow as needed, and shrink to what's left at the end
+    REQUIRE_FALSE(parser.parse_chunk(chunk, 8));
+    REQUIRE(chunk.size() == 6);
+    REQUIRE_FALSE(parser.parse_chunk(chunk, 8));
+    REQUIRE(chunk.size() == 0);
+}
+
+TEST_CASE("Interleaved chunks are parsed over in place", "[ReadInterleaver]") {
+    qcpp::ReadInterleaver   interleaver;
+    TestConfig             *config = TestConfig::get_config();
+    std::vector<qcpp::ReadPair> chunk(4);
+    qcpp::ReadParser        parser;
+    qcpp::ReadPair          rp;
+
+    interleaver.open(config->get_data_file("valid_R1.fastq"),
+                     config->get_data_file("valid_R2.fastq"));
+    parser.open(config->get_data_file("valid_il.fastq"));
+    REQUIRE(interleaver.parse_chunk(chunk, 2));
+    REQUIRE(chunk.size() == 2);
+    REQUIRE_FALSE(interleaver.parse_chunk(chunk, 4));
+    REQUIRE(chunk.size() == 3);
+    for (size_t i = 0; i < 2; i++) {
+        parser.parse_read_pair(rp);
+    }
+    for (const qcpp::ReadPair &pair: chunk) {
+        REQUIRE(parser.parse_read_pair(rp));
+        REQUIRE(pair == rp);
+    }
+}
+
 TEST_CASE("Read Interleaving", "[ReadInterleaver]") {
     qcpp::ReadPair          read_parser_pair;
     qcpp::ReadPair          read_interleaver_pair;
@@ -195,6 +283,33 @@ TEST_CASE("Read Interleaving", "[ReadInterleaver]") {
     }
 }
 
+TEST_CASE("Read Interleaving of mismatched files", "[ReadInterleaver]") {
+    qcpp::ReadPair          pair;
+    qcpp::ReadInterleaver   interleaver;
+    TestConfig             *config = TestConfig::get_config();
+    std::string             il_file = config->get_data_file("valid_il.fastq");
+    std::string             r1_file = config->get_data_file("valid_R1.fastq");
+
+    // The first reads of both files are mates, the second are not
+    REQUIRE_NOTHROW(interleaver.open(r1_file, il_file));
+
+    SECTION("Mismatched read names throw if checked") {
+        interleaver.set_check_pair_names(true);
+        REQUIRE(interleaver.parse_read_pair(pair));
+        REQUIRE_THROWS_AS(interleaver.parse_read_pair(pair), qcpp::IOError);
+    }
+
+    SECTION("Different read counts throw") {
+        size_t n_pairs = 0;
+
+        // Names aren't checked by default
+        for (; n_pairs < 5; n_pairs++) {
+            REQUIRE(interleaver.parse_read_pair(pair));
+        }
+        REQUIRE_THROWS_AS(interleaver.parse_read_pair(pair), qcpp::IOError);
+    }
+}
+
 TEST_CASE("Fastq writing", "[ReadParser]") {
     qcpp::ReadWriter writer;
     TestConfig *config = TestConfig::get_config();
@@ -275,3 +390,56 @@ TEST_CASE("Round-trip parse-write", "[ReadParser]") {
         REQUIRE(filecmp(infile, outfile));
     }
 }
+
+TEST_CASE("Buffered writing matches str()", "[BufferedReadWriter]") {
+    qcpp::ReadParser    parser;
+    TestConfig         *config = TestConfig::get_config();
+    std::string         infile = config->get_data_file("valid_il.fastq");
+    std::string         outfile = config->get_writable_file("fastq", false);
+    std::string         expect;
+    std::vector<qcpp::ReadPair> pairs;
+    qcpp::ReadPair      pair;
+
+    REQUIRE_NOTHROW(parser.open(infile));
+    while (parser.parse_read_pair(pair)) {
+        pairs.push_back(pair);
+        expect += pair.str();
+    }
+    REQUIRE(pairs.size() == 5);
+
+    // Buffer sizes smaller than one record, smaller than the file, and larger
+    // than the file exercise each flushing path. Write both whole pairs and
+    // preformatted records.
+    for (size_t bufsize: {16, 256, 1<<20}) {
+        for (bool preformatted: {false, true}) {
+            qcpp::BufferedReadWriter writer(bufsize);
+
+            CAPTURE(bufsize);
+            CAPTURE(preformatted);
+            REQUIRE_NOTHROW(writer.open(outfile));
+            for (auto &rp: pairs) {
+                if (preformatted) {
+                    REQUIRE_NOTHROW(writer.write(rp.str()));
+                } else {
+                    REQUIRE_NOTHROW(writer.write_read_pair(rp));
+                }
+            }
+            REQUIRE_NOTHROW(writer.close());
+            if (!preformatted) {
+                REQUIRE(writer.get_num_reads() == 10);
+            }
+
+            std::ifstream ifs(outfile);
+            std::string got((std::istreambuf_iterator<char>(ifs)),
+                            std::istreambuf_iterator<char>());
+            REQUIRE(got == expect);
+            REQUIRE(filecmp(infile, outfile));
+        }
+    }
+}
+
+TEST_CASE("Buffered writing to a bad path fails", "[BufferedReadWriter]") {
+    qcpp::BufferedReadWriter writer;
+
+    REQUIRE_THROWS_AS(writer.open("/nonexistent/dir/out.fastq"), qcpp::IOError);
+}
@@ -0,0 +1,205 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-kmer.hh"
+#include "qc-packed.hh"
+
+#include <cmath>
+#include <random>
+
+
+TEST_CASE("Canonical k-mers", "[KmerSpectrum]") {
+    std::string seq = "ACGGTTAGCATTAC";
+    std::string rc = qcpp::PackedSequence(seq).reverse_complement().str();
+
+    REQUIRE(qcpp::canonical_kmer(seq, seq.size()) == qcpp::canonical_kmer(rc, rc.size()));
+    // A = 0, C = 1, T = 2, G = 3, first base highest; GT's reverse complement
+    // is AC, which is lesser
+    REQUIRE(qcpp::canonical_kmer("GT", 2) == 1);
+    REQUIRE(qcpp::canonical_kmer("AA", 2) == 0);
+}
+
+TEST_CASE("Packed sequences give the same k-mers", "[KmerSpectrum]") {
+    std::mt19937_64 rng(53);
+
+    for (size_t i = 0; i < 200; i++) {
+        std::string seq = random_seq(rng, rng() % 150);
+        for (char &base: seq) {
+            if (rng() % 30 == 0) {
+                base = "Nn-a"[rng() % 4];
+            }
+        }
+        std::vector<std::pair<uint64_t, size_t>> expect, packed;
+        const size_t k = 1 + rng() % 31;
+        qcpp::for_each_canonical_kmer(seq, k, [&](uint64_t kmer, size_t pos) {
+            expect.emplace_back(kmer, pos);
+        });
+        qcpp::for_each_canonical_kmer(qcpp::PackedSequence(seq), k,
+                                      [&](uint64_t kmer, size_t pos) {
+            packed.emplace_back(kmer, pos);
+        });
+        CAPTURE(seq);
+        CAPTURE(k);
+        REQUIRE(packed == expect);
+    }
+}
+
+TEST_CASE("KmerCounter counts exactly within its budget", "[KmerSpectrum]") {
+    qcpp::KmerCounter counter(1 << 20);
+    std::mt19937_64 rng(13);
+    std::vector<uint64_t> kmers;
+
+    for (size_t i = 0; i < 20000; i++) {
+        kmers.push_back(rng() >> 2);
+    }
+    for (size_t i = 0; i < kmers.size(); i++) {
+        counter.add(kmers[i], i % 3 + 1);
+    }
+    counter.add(kmers[0]);
+
+    REQUIRE(counter.sample_level() == 0);
+    REQUIRE(counter.size() == kmers.size());
+    REQUIRE(counter.memory_size() <= counter.memory_budget());
+    REQUIRE(counter.count(kmers[0]) == 2);
+    REQUIRE(counter.count(kmers[1]) == 2);
+    REQUIRE(counter.count(kmers[2]) == 3);
+    REQUIRE(counter.count(kmers[2] + 1) == 0);
+    auto hist = counter.histogram();
+    REQUIRE(hist.size() == 3);
+    REQUIRE(hist[1] == kmers.size() / 3);
+    REQUIRE(hist[2] == kmers.size() / 3 + 2);
+    REQUIRE(hist[3] == kmers.size() / 3);
+}
+
+TEST_CASE("KmerCounter sub-samples past its budget", "[KmerSpectrum]") {
+    // 64KiB holds about 4000 k-mers
+    qcpp::KmerCounter counter(1 << 16), a(1 << 15), b(1 << 15);
+    std::mt19937_64 rng(17);
+
+    for (size_t i = 0; i < 100000; i++) {
+        uint64_t kmer = rng() >> 2;
+        counter.add(kmer, 2);
+        (i % 2 == 0 ? a : b).add(kmer, 2);
+    }
+    REQUIRE(counter.sample_level() > 0);
+    REQUIRE(counter.memory_size() <= counter.memory_budget());
+    double distinct = std::ldexp(counter.size(), counter.sample_level());
+    REQUIRE(std::abs(distinct - 100000) < 10000);
+    auto hist = counter.histogram();
+    REQUIRE(hist.size() == 1);
+    REQUIRE(hist[2] == counter.size());
+
+    // k-mers kept in the sample can still be found once others are removed
+    rng.seed(17);
+    uint64_t total = 0;
+    for (size_t i = 0; i < 100000; i++) {
+        total += counter.count(rng() >> 2);
+    }
+    REQUIRE(total == 2 * counter.size());
+
+    // Merged counters sample at the same level, so hold the same k-mers
+    const size_t split_size = a.memory_size() + b.memory_size();
+    REQUIRE(split_size <= counter.memory_budget());
+    a.merge(b);
+    REQUIRE(a.sample_level() == counter.sample_level());
+    REQUIRE(a.histogram() == counter.histogram());
+    // b is freed as it is merged, so both stay within their shared budget
+    REQUIRE(b.memory_size() == 0);
+    REQUIRE(b.size() == 0);
+    REQUIRE(a.memory_size() <= a.memory_budget());
+    REQUIRE(a.memory_budget() == counter.memory_budget());
+}
+
+TEST_CASE("KmerCounter merges split budgets", "[KmerSpectrum]") {
+    // Halves of 64KiB each hold their k-mers exactly, as does their merge
+    qcpp::KmerCounter counter(1 << 16), a(1 << 15), b(1 << 15);
+    std::mt19937_64 rng(47);
+
+    for (size_t i = 0; i < 3000; i++) {
+        uint64_t kmer = rng() >> 2;
+        counter.add(kmer);
+        (i % 2 == 0 ? a : b).add(kmer);
+    }
+    REQUIRE(counter.sample_level() == 0);
+    REQUIRE(a.sample_level() == 0);
+    a.merge(b);
+    REQUIRE(a.memory_budget() == counter.memory_budget());
+    REQUIRE(a.sample_level() == 0);
+    REQUIRE(a.size() == 3000);
+    REQUIRE(a.histogram() == counter.histogram());
+}
+
+TEST_CASE("KmerSpectrum reports the k-mer spectrum", "[KmerSpectrum]") {
+    std::mt19937_64 rng(19);
+    // 100 distinct 21-mers from one read; Ns break k-mers
+    std::string seq = random_seq(rng, 120);
+    std::string rc = qcpp::PackedSequence(seq).reverse_complement().str();
+
+    SECTION("Single end") {
+        qcpp::KmerSpectrum spectrum("kmers", 21);
+        for (size_t i = 0; i < 3; i++) {
+            auto read = make_read(seq);
+            spectrum.process_read(read);
+        }
+        // The reverse complement gives the same canonical k-mers
+        auto read = make_read(rc);
+        spectrum.process_read(read);
+        read = make_read("ACGTN" + seq.substr(0, 21));
+        spectrum.process_read(read);
+
+        REQUIRE(spectrum.num_kmers() == 401);
+        REQUIRE(spectrum.distinct_kmers() == 100);
+        auto spec = spectrum.spectrum();
+        REQUIRE(spec.size() == 2);
+        REQUIRE(spec[4] == 99);
+        REQUIRE(spec[5] == 1);
+        REQUIRE(spectrum.counter().count(qcpp::canonical_kmer(seq, 21)) == 5);
+
+        std::string report = spectrum.yaml_report();
+        REQUIRE(report.find("num_kmers: 401") != std::string::npos);
+        REQUIRE(report.find("spectrum: {4: 99, 5: 1}") != std::string::npos);
+    }
+
+    SECTION("Merged reports match a single processor") {
+        // Copies share the budget, as threads do
+        qcpp::KmerSpectrum single("kmers", 15, 1 << 24), a("kmers", 15, 1 << 23),
+                           b("kmers", 15, 1 << 23);
+        for (size_t i = 0; i < 300; i++) {
+            qcpp::ReadPair rp;
+            rp.first = make_read(random_seq(rng, 100));
+            rp.second = make_read(i % 2 ? seq : rc);
+            single.process_read_pair(rp);
+            (i % 3 == 0 ? a : b).process_read_pair(rp);
+        }
+        a.add_stats_from(&b);
+        REQUIRE(a.yaml_report() == single.yaml_report());
+        REQUIRE(a.spectrum()[300] == 106);
+    }
+
+    SECTION("Packed reads") {
+        qcpp::KmerSpectrum spectrum("kmers", 21), packed("kmers", 21);
+        for (const std::string &s: {seq, rc, "ACGTN" + seq.substr(0, 21), seq}) {
+            auto read = make_read(s);
+            spectrum.process_read(read);
+            packed.process_read(qcpp::PackedRead(read));
+        }
+        REQUIRE(packed.yaml_report() == spectrum.yaml_report());
+    }
+
+    SECTION("Short k") {
+        qcpp::KmerSpectrum spectrum("kmers", 1);
+        auto read = make_read("ACGTN");
+        spectrum.process_read(read);
+        // A and T are one canonical 1-mer, as are C and G
+        REQUIRE(spectrum.spectrum() == (std::map<uint32_t, uint64_t>{{2, 2}}));
+    }
+}
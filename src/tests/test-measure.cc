@@ -0,0 +1,94 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-measure.hh"
+
+
+TEST_CASE("BaseCounts counts bases and GC content", "[BaseComposition]") {
+    qcpp::BaseCounts counts;
+
+    // More reads than fit in the 8-bit batch counters
+    for (size_t i = 0; i < 1000; i++) {
+        counts.add("ACGTN");
+        counts.add("ggcc");
+        counts.add("AT");
+    }
+    counts.add("");
+    counts.flush();
+
+    REQUIRE(counts.max_length() == 5);
+    REQUIRE(counts.coverage(0) == 3000);
+    REQUIRE(counts.coverage(2) == 2000);
+    REQUIRE(counts.coverage(4) == 1000);
+    REQUIRE(counts.count(0, 'A') == 2000);
+    REQUIRE(counts.count(0, 'G') == 1000);
+    REQUIRE(counts.count(1, 'T') == 1000);
+    REQUIRE(counts.count(1, 'g') == 1000);
+    REQUIRE(counts.count(2, 'C') == 1000);
+    REQUIRE(counts.count(3, 'C') == 1000);
+    REQUIRE(counts.count(4, 'N') == 1000);
+    REQUIRE(counts.count(4, 'A') == 0);
+    REQUIRE(counts.count(5, 'N') == 0);
+    REQUIRE(counts.num_reads_of_length(2) == 1000);
+
+    // Ns are left out of the GC content, and empty reads aren't counted
+    auto &gc = counts.gc_histogram();
+    REQUIRE(gc[0] == 1000);
+    REQUIRE(gc[50] == 1000);
+    REQUIRE(gc[100] == 1000);
+    size_t total = 0;
+    for (size_t n: gc) {
+        total += n;
+    }
+    REQUIRE(total == 3000);
+}
+
+TEST_CASE("BaseComposition reports per-position bases", "[BaseComposition]") {
+    std::vector<qcpp::Read> reads = {
+        qcpp::Read("r1", "ACGT", "IIII"),
+        qcpp::Read("r2", "AAGGN", "IIIII"),
+        qcpp::Read("r3", "CC", "II"),
+    };
+
+    SECTION("Single end") {
+        qcpp::BaseComposition comp("composition");
+        for (auto &read: reads) {
+            comp.process_read(read);
+        }
+        const qcpp::BaseCounts &r1 = comp.r1_counts();
+        REQUIRE(r1.count(0, 'A') == 2);
+        REQUIRE(r1.count(0, 'C') == 1);
+        REQUIRE(r1.count(4, 'N') == 1);
+        REQUIRE(comp.r2_counts().max_length() == 0);
+
+        std::string report = comp.yaml_report();
+        REQUIRE(report.find("num_reads: 3") != std::string::npos);
+        REQUIRE(report.find("- {A: 2, C: 1, G: 0, T: 0, N: 0}") != std::string::npos);
+        REQUIRE(report.find("- {A: 0, C: 0, G: 0, T: 0, N: 1}") != std::string::npos);
+        REQUIRE(report.find("r2_base_counts: []") != std::string::npos);
+    }
+
+    SECTION("Merged reports match a single processor") {
+        qcpp::BaseComposition single("composition");
+        qcpp::BaseComposition a("composition"), b("composition");
+        for (size_t i = 0; i < 600; i++) {
+            qcpp::ReadPair rp;
+            rp.first = reads[i % 3];
+            rp.second = reads[(i + 1) % 3];
+            single.process_read_pair(rp);
+            (i % 4 == 0 ? a : b).process_read_pair(rp);
+        }
+        a.add_stats_from(&b);
+        REQUIRE(a.yaml_report() == single.yaml_report());
+        REQUIRE(a.r2_counts().count(0, 'C') == 200);
+    }
+}
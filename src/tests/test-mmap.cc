@@ -0,0 +1,162 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-io.hh"
+#include "qc-mmap.hh"
+
+
+TEST_CASE("Pair names", "[read_pair_name]") {
+    REQUIRE(qcpp::read_pair_name("read1/1") == "read1");
+    REQUIRE(qcpp::read_pair_name("read1/2") == "read1");
+    REQUIRE(qcpp::read_pair_name("read1/3") == "read1/3");
+    REQUIRE(qcpp::read_pair_name("read1 1:N:0:") == "read1");
+    REQUIRE(qcpp::read_pair_name("read1/1\tcomment") == "read1");
+    REQUIRE(qcpp::read_pair_name("") == "");
+}
+
+TEST_CASE("Mapped parsing matches ReadParser", "[MappedReadParser]") {
+    TestConfig             *config = TestConfig::get_config();
+    qcpp::ReadParser        parser;
+    qcpp::MappedReadParser  mapped;
+    qcpp::Read              read, mapped_read;
+    std::string             infile;
+    size_t                  n_reads = 0;
+
+    SECTION("valid_il.fastq") {
+        infile = config->get_data_file("valid_il.fastq");
+    }
+    SECTION("valid.fasta") {
+        infile = config->get_data_file("valid.fasta");
+    }
+    SECTION("tm-merge.fastq") {
+        infile = config->get_data_file("tm-merge.fastq");
+    }
+
+    CAPTURE(infile);
+    REQUIRE_NOTHROW(parser.open(infile));
+    REQUIRE_NOTHROW(mapped.open(infile));
+    while (parser.parse_read(read)) {
+        REQUIRE(mapped.parse_read(mapped_read));
+        REQUIRE(read == mapped_read);
+        n_reads++;
+    }
+    REQUIRE_FALSE(mapped.parse_read(mapped_read));
+    REQUIRE(mapped.at_end());
+    REQUIRE(mapped.get_num_reads() == n_reads);
+}
+
+TEST_CASE("Mapped parsing of invalid files", "[MappedReadParser]") {
+    TestConfig             *config = TestConfig::get_config();
+    qcpp::MappedReadParser  mapped;
+    qcpp::Read              read;
+
+    SECTION("Empty file") {
+        REQUIRE_THROWS_AS(mapped.open(config->get_data_file("empty.fastq")),
+                          qcpp::IOError);
+    }
+
+    SECTION("Compressed file") {
+        REQUIRE_THROWS_AS(mapped.open(config->get_data_file("tricky-gbs.fq.gz")),
+                          qcpp::IOError);
+    }
+
+    SECTION("Truncated file") {
+        REQUIRE_NOTHROW(mapped.open(config->get_data_file("truncated.fastq")));
+        REQUIRE_NOTHROW(mapped.parse_read(read)); // First read is OK
+        REQUIRE_THROWS_AS(mapped.parse_read(read), qcpp::IOError);
+    }
+}
+
+TEST_CASE("Mapped file partitioning", "[MappedReadParser]") {
+    TestConfig             *config = TestConfig::get_config();
+    std::string             infile = config->get_data_file("valid_il.fastq");
+    qcpp::MappedReadParser  mapped;
+    std::vector<qcpp::ReadPair> expect;
+    qcpp::ReadPair          rp;
+
+    REQUIRE_NOTHROW(mapped.open(infile));
+    {
+        qcpp::MappedReadParser all(mapped, 0, mapped.partition(1).back());
+        while (all.parse_read_pair(rp)) {
+            expect.push_back(rp);
+        }
+    }
+    REQUIRE(expect.size() == 5);
+
+    for (size_t n = 1; n <= 12; n++) {
+        for (bool paired: {false, true}) {
+            std::vector<size_t> offsets = mapped.partition(n, paired);
+            std::vector<qcpp::Read> reads;
+            qcpp::Read read;
+
+            CAPTURE(n);
+            CAPTURE(paired);
+            REQUIRE(offsets.size() == n + 1);
+            for (size_t i = 0; i < n; i++) {
+                REQUIRE(offsets[i] <= offsets[i + 1]);
+                qcpp::MappedReadParser part(mapped, offsets[i], offsets[i + 1]);
+                size_t part_reads = 0;
+                while (part.parse_read(read)) {
+                    reads.push_back(read);
+                    part_reads++;
+                }
+                if (paired) {
+                    REQUIRE((part_reads % 2) == 0);
+                }
+            }
+            REQUIRE(reads.size() == 10);
+            for (size_t i = 0; i < expect.size(); i++) {
+                REQUIRE(reads[2 * i] == expect[i].first);
+                REQUIRE(reads[2 * i + 1] == expect[i].second);
+            }
+        }
+    }
+}
+
+TEST_CASE("Mapped file partitioning without mate names", "[MappedReadParser]") {
+    TestConfig             *config = TestConfig::get_config();
+    std::string             infile = config->get_writable_file("fastq", false);
+    qcpp::MappedReadParser  mapped;
+
+    // Names that say nothing of which reads are mates
+    std::ofstream out(infile);
+    for (size_t i = 0; i < 200; i++) {
+        for (const char *mate: {"R1", "R2"}) {
+            std::string name = "frag" + std::to_string(i) + "_" + mate;
+            if (i % 3 == 0) {
+                name = "read";
+            } else if (i % 3 == 1) {
+                name = std::to_string(i) + mate;
+            }
+            out << "@" << name << "\nACGTACGTAC\n+\n" << mate << "IIIIIIII\n";
+        }
+    }
+    out.close();
+
+    REQUIRE_NOTHROW(mapped.open(infile));
+    for (size_t n: {2, 3, 7, 16, 33}) {
+        std::vector<size_t> offsets = mapped.partition(n, true);
+        size_t num_reads = 0;
+        qcpp::ReadPair rp;
+
+        CAPTURE(n);
+        for (size_t i = 0; i < n; i++) {
+            qcpp::MappedReadParser part(mapped, offsets[i], offsets[i + 1]);
+            while (part.parse_read_pair(rp)) {
+                REQUIRE(rp.first.quality.substr(0, 2) == "R1");
+                REQUIRE(rp.second.quality.substr(0, 2) == "R2");
+                num_reads += 2;
+            }
+        }
+        REQUIRE(num_reads == 400);
+    }
+}
@@ -0,0 +1,146 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-overrep.hh"
+
+#include <random>
+
+
+TEST_CASE("CountMinSketch never under-counts", "[OverrepresentedSequences]") {
+    qcpp::CountMinSketch sketch(1000, 4), other(1000, 4);
+    std::mt19937_64 rng(5);
+    std::vector<uint64_t> hashes;
+
+    for (size_t i = 0; i < 2000; i++) {
+        hashes.push_back(rng());
+    }
+    for (size_t i = 0; i < hashes.size(); i++) {
+        for (size_t j = 0; j <= i % 5; j++) {
+            sketch.add(hashes[i]);
+            other.add(hashes[i]);
+        }
+    }
+    // The width is rounded up to a power of two
+    REQUIRE(sketch.memory_size() == 1024 * 4 * sizeof(uint32_t));
+    size_t exact = 0;
+    for (size_t i = 0; i < hashes.size(); i++) {
+        REQUIRE(sketch.estimate(hashes[i]) >= i % 5 + 1);
+        exact += sketch.estimate(hashes[i]) == i % 5 + 1;
+    }
+    REQUIRE(exact > hashes.size() / 2);
+
+    sketch.merge(other);
+    for (size_t i = 0; i < hashes.size(); i++) {
+        REQUIRE(sketch.estimate(hashes[i]) >= 2 * (i % 5 + 1));
+    }
+}
+
+TEST_CASE("HeavyHitters finds the most frequent strings", "[OverrepresentedSequences]") {
+    std::mt19937_64 rng(7);
+    std::vector<std::string> stream;
+
+    // Ten frequent strings among 50000 mostly unique ones
+    for (size_t i = 0; i < 50000; i++) {
+        stream.push_back(random_seq(rng, 20));
+    }
+    for (size_t i = 0; i < 10; i++) {
+        std::string frequent = std::string(i + 1, 'A') + std::string(19 - i, 'C');
+        for (size_t j = 0; j < 200 * (i + 1); j++) {
+            stream[rng() % stream.size()] = frequent;
+        }
+    }
+
+    qcpp::HeavyHitters single(50, 4096), a(50, 4096), b(50, 4096);
+    for (size_t i = 0; i < stream.size(); i++) {
+        single.add(stream[i].data(), stream[i].size());
+        (i % 2 == 0 ? a : b).add(stream[i].data(), stream[i].size());
+    }
+    a.merge(b);
+
+    for (qcpp::HeavyHitters *hh: {&single, &a}) {
+        auto top = hh->top(10);
+        REQUIRE(hh->total() == stream.size());
+        REQUIRE(top.size() == 10);
+        for (size_t i = 0; i < 10; i++) {
+            // Most frequent first; the largest has 10 As
+            CAPTURE(i);
+            REQUIRE(top[i].key == std::string(10 - i, 'A') + std::string(10 + i, 'C'));
+            REQUIRE(top[i].count >= top[std::min<size_t>(i + 1, 9)].count);
+        }
+    }
+}
+
+TEST_CASE("OverrepresentedSequences reports common prefixes", "[OverrepresentedSequences]") {
+    const std::string adaptor = "AGATCGGAAGAGCACACGTCTGAACTCCAGTCACATCACGATCTCGTATGCCGTCTTCTGCTTG";
+    std::mt19937_64 rng(11);
+    std::vector<qcpp::Read> reads;
+
+    for (size_t i = 0; i < 1000; i++) {
+        std::string seq = random_seq(rng, 60);
+        if (i % 10 == 0) {
+            // Adaptor dimers, which differ after the prefix
+            seq = adaptor.substr(0, 50) + seq.substr(0, 10);
+        }
+        reads.emplace_back("read", seq, std::string(seq.size(), 'I'));
+    }
+    reads.emplace_back("short", "ACGT", "IIII");
+    reads.emplace_back("empty", "", "");
+
+    SECTION("Single end") {
+        qcpp::OverrepresentedSequences overrep("overrep", 50, 5);
+        for (auto &read: reads) {
+            overrep.process_read(read);
+        }
+        auto top = overrep.top_r1();
+        REQUIRE(top.size() == 5);
+        REQUIRE(top[0].key == adaptor.substr(0, 50));
+        REQUIRE(top[0].count == 100);
+        REQUIRE(overrep.top_r2().size() == 0);
+        // Reads are not modified
+        REQUIRE(reads[0].size() == 60);
+
+        std::string report = overrep.yaml_report();
+        REQUIRE(report.find("num_reads: 1002") != std::string::npos);
+        REQUIRE(report.find("{sequence: " + adaptor.substr(0, 50) + ", count: 100, percentage: 9.99")
+                != std::string::npos);
+        REQUIRE(report.find("r2_sequences: []") != std::string::npos);
+    }
+
+    SECTION("Merged reports match a single processor") {
+        qcpp::OverrepresentedSequences single("overrep", 50, 5);
+        qcpp::OverrepresentedSequences a("overrep", 50, 5), b("overrep", 50, 5);
+        for (size_t i = 0; i < reads.size(); i++) {
+            single.process_read(reads[i]);
+            (i % 3 == 0 ? a : b).process_read(reads[i]);
+        }
+        a.add_stats_from(&b);
+        REQUIRE(a.top_r1()[0].key == single.top_r1()[0].key);
+        REQUIRE(a.top_r1()[0].count == 100);
+    }
+
+    SECTION("Read pairs") {
+        qcpp::OverrepresentedSequences overrep("overrep", 20, 1);
+        for (size_t i = 0; i + 1 < reads.size(); i += 2) {
+            qcpp::ReadPair rp;
+            rp.first = reads[i];
+            rp.second = reads[i + 1];
+            overrep.process_read_pair(rp);
+        }
+        auto r1 = overrep.top_r1();
+        REQUIRE(r1.size() == 1);
+        REQUIRE(r1[0].key == adaptor.substr(0, 20));
+        REQUIRE(r1[0].count == 100);
+        // Only random reads are R2
+        REQUIRE(overrep.top_r2().size() == 1);
+        REQUIRE(overrep.top_r2()[0].count == 1);
+    }
+}
@@ -0,0 +1,203 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-packed.hh"
+
+#include <random>
+
+
+static std::string
+reverse_complement(const std::string &seq)
+{
+    std::string rc(seq.rbegin(), seq.rend());
+    for (char &base: rc) {
+        switch (base) {
+            case 'A': base = 'T'; break;
+            case 'C': base = 'G'; break;
+            case 'G': base = 'C'; break;
+            case 'T': base = 'A'; break;
+            case 'R': base = 'Y'; break;
+            case 'n': base = 'n'; break;
+        }
+    }
+    return rc;
+}
+
+// Random bases, with about one in 20 an N, R or lower-case n
+static std::string
+random_sequence(std::mt19937 &rng, size_t length)
+{
+    const char bases[] = "ACGT";
+    const char ambiguous[] = "NRn";
+    std::string seq;
+
+    for (size_t i = 0; i < length; i++) {
+        if (rng() % 20 == 0) {
+            seq += ambiguous[rng() % 3];
+        } else {
+            seq += bases[rng() % 4];
+        }
+    }
+    return seq;
+}
+
+TEST_CASE("Sequences are packed two bits per base", "[PackedSequence]") {
+    SECTION("Codes") {
+        qcpp::PackedSequence packed("ACTGNacgt");
+
+        REQUIRE(packed.size() == 9);
+        REQUIRE(packed.code(0) == 0);
+        REQUIRE(packed.code(1) == 1);
+        REQUIRE(packed.code(2) == 2);
+        REQUIRE(packed.code(3) == 3);
+        // Packed as A
+        REQUIRE(packed.code(4) == 0);
+        REQUIRE(packed.code(5) == 0);
+        REQUIRE(packed.num_ambiguous() == 5);
+        REQUIRE(packed.at(3) == 'G');
+        REQUIRE(packed.at(4) == 'N');
+        REQUIRE(packed.at(6) == 'c');
+        REQUIRE_FALSE(packed.is_ambiguous(3));
+        REQUIRE(packed.is_ambiguous(4));
+        REQUIRE_FALSE(packed.has_ambiguous(0, 4));
+        REQUIRE(packed.has_ambiguous(2, 3));
+        REQUIRE(packed.words().size() == 1);
+        REQUIRE(packed.words()[0] == (0x1 << 2 | 0x2 << 4 | 0x3 << 6));
+    }
+
+    SECTION("Round trips of random sequences") {
+        std::mt19937 rng(42);
+
+        for (size_t length = 0; length < 200; length++) {
+            std::string seq = random_sequence(rng, length);
+            qcpp::PackedSequence packed(seq);
+            std::string unpacked = "junk";
+
+            CAPTURE(seq);
+            packed.unpack(unpacked);
+            REQUIRE(unpacked == seq);
+            REQUIRE(packed.str() == seq);
+            for (size_t i = 0; i < length; i++) {
+                REQUIRE(packed.at(i) == seq[i]);
+            }
+        }
+    }
+
+    SECTION("Sequences without ambiguous bases use a quarter of the memory") {
+        std::string seq(3200, 'A');
+        for (size_t i = 0; i < seq.size(); i++) {
+            seq[i] = "ACGT"[i * 7 % 4];
+        }
+        qcpp::PackedSequence packed(seq);
+        REQUIRE(packed.num_ambiguous() == 0);
+        REQUIRE(packed.memory_size() == seq.size() / 4);
+    }
+
+    SECTION("Empty sequences") {
+        qcpp::PackedSequence packed("ACGT");
+        packed.clear();
+        REQUIRE(packed.size() == 0);
+        REQUIRE(packed.str() == "");
+        REQUIRE(packed == qcpp::PackedSequence(""));
+    }
+}
+
+TEST_CASE("Packed k-mers and reverse complements", "[PackedSequence]") {
+    std::mt19937 rng(1);
+    std::string seq = random_sequence(rng, 150);
+    qcpp::PackedSequence packed(seq);
+
+    SECTION("k-mers match their bases") {
+        for (size_t k: {1, 5, 21, 31, 32}) {
+            for (size_t pos = 0; pos + k <= seq.size(); pos++) {
+                uint64_t kmer = packed.kmer(pos, k);
+                uint64_t expect = 0;
+                for (size_t i = 0; i < k; i++) {
+                    expect |= uint64_t(packed.code(pos + i)) << (2 * i);
+                }
+                REQUIRE(kmer == expect);
+            }
+        }
+    }
+
+    SECTION("k-mer reverse complements") {
+        std::string acgt = "ACGTTGCAAGGCTTACGATCGATTCAGGCATC";
+        std::string rc = reverse_complement(acgt);
+
+        for (size_t k: {1, 7, 31, 32}) {
+            qcpp::PackedSequence fwd(acgt.substr(0, k));
+            qcpp::PackedSequence rev(rc.substr(rc.size() - k));
+            REQUIRE(qcpp::kmer_reverse_complement(fwd.kmer(0, k), k) ==
+                    rev.kmer(0, k));
+        }
+    }
+
+    SECTION("Whole sequences") {
+        for (size_t length: {0, 1, 31, 32, 33, 64, 150}) {
+            std::string sub = seq.substr(0, length);
+            qcpp::PackedSequence rc = qcpp::PackedSequence(sub).reverse_complement();
+
+            CAPTURE(sub);
+            REQUIRE(rc.str() == reverse_complement(sub));
+            REQUIRE(rc == qcpp::PackedSequence(reverse_complement(sub)));
+        }
+    }
+}
+
+TEST_CASE("Packed reads", "[PackedSequence]") {
+    qcpp::Read read("read1", "ACGTNACGTACGTACGT", "IIIIIIIIIIIIIIIII");
+    qcpp::PackedRead packed(read);
+    qcpp::Read unpacked;
+    std::string expect, buffer;
+
+    packed.unpack(unpacked);
+    REQUIRE(unpacked == read);
+
+    read.append_to(expect);
+    packed.append_to(buffer);
+    REQUIRE(buffer == expect);
+
+    SECTION("FASTA reads") {
+        read.quality.clear();
+        packed.pack(read);
+        expect.clear();
+        buffer.clear();
+        read.append_to(expect);
+        packed.append_to(buffer);
+        REQUIRE(buffer == expect);
+    }
+}
+
+TEST_CASE("Packed chunks", "[PackedSequence]") {
+    TestConfig *config = TestConfig::get_config();
+    std::string infile = config->get_data_file("valid_il.fastq");
+    qcpp::ReadParser parser, packed_parser;
+    std::vector<qcpp::PackedRead> chunk(2);
+    qcpp::Read read, unpacked;
+    size_t n_reads = 0;
+
+    parser.open(infile);
+    packed_parser.open(infile);
+    bool more = true;
+    while (more) {
+        more = qcpp::parse_chunk(packed_parser, chunk, 3);
+        for (const qcpp::PackedRead &packed: chunk) {
+            REQUIRE(parser.parse_read(read));
+            packed.unpack(unpacked);
+            REQUIRE(unpacked == read);
+            n_reads++;
+        }
+    }
+    REQUIRE(n_reads == 10);
+    // The last chunk holds the one read left
+    REQUIRE(chunk.size() == 1);
+}
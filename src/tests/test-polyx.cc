@@ -0,0 +1,140 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-polyx.hh"
+
+#include <random>
+
+
+// The tail start, found one base at a time
+static size_t
+naive_tail_start(const std::string &seq)
+{
+    const size_t len = seq.size();
+    size_t start = len, mismatches = 0;
+
+    if (len == 0) {
+        return 0;
+    }
+    for (size_t i = len; i > 0; i--) {
+        mismatches += seq[i - 1] != seq[len - 1];
+        if (mismatches > std::min<size_t>((len - i + 1) / 8, 5)) {
+            break;
+        }
+        start = i - 1;
+    }
+    while (seq[start] != seq[len - 1]) {
+        start++;
+    }
+    return start;
+}
+
+TEST_CASE("PolyXTrim finds tails", "[PolyXTrim]") {
+    qcpp::PolyXTrim trim("polyx");
+
+    REQUIRE(trim.tail_start("") == 0);
+    REQUIRE(trim.tail_start("ACGTACGTAC" + std::string(20, 'G')) == 10);
+    REQUIRE(trim.tail_start(std::string(40, 'G')) == 0);
+    // One mismatch per 8 bases is allowed, but not at the ends of the tail
+    REQUIRE(trim.tail_start("ACGTAC" "TGGGGGGGAGGGGGGGGG") == 7);
+    REQUIRE(trim.tail_start("ACGTAC" "GGGGAGGG") == 11);
+    REQUIRE(trim.tail_start("ACGTAC" "GGGGGGGGGGA") == 16);
+    // At most 5 mismatches
+    std::string tail = "GGGGGGG";
+    for (size_t i = 0; i < 6; i++) {
+        tail = "GGGGGGGA" + tail;
+    }
+    REQUIRE(trim.tail_start("ACGTGGGGGG" + tail) == 18);
+    // N is not a tail base
+    REQUIRE(trim.tail_start("ACGTNNNNNNNNNNNN") == 16);
+    REQUIRE(qcpp::PolyXTrim("polyx", "gn").tail_start("ACGTNNNNNNNNNNNN") == 4);
+
+    // Blocks of bases are checked at once, with the same result as checking
+    // each base
+    std::mt19937_64 rng(41);
+    for (size_t i = 0; i < 2000; i++) {
+        std::string tail(rng() % 80, "ACGT"[rng() % 4]);
+        for (char &base: tail) {
+            if (rng() % 10 == 0) {
+                base = "ACGT"[rng() % 4];
+            }
+        }
+        std::string seq = random_seq(rng, rng() % 80) + tail;
+        CAPTURE(seq);
+        REQUIRE(trim.tail_start(seq) == naive_tail_start(seq));
+    }
+}
+
+TEST_CASE("PolyXTrim trims reads", "[PolyXTrim]") {
+    std::mt19937_64 rng(43);
+    // Ends in enough mismatches to stop any tail of C or G
+    std::string seq = random_seq(rng, 80) + "ATTATTA";
+
+    SECTION("Single end") {
+        qcpp::PolyXTrim trim("polyx");
+        auto read = make_read(seq + std::string(30, 'G'));
+        trim.process_read(read);
+        REQUIRE(read.sequence == seq);
+        REQUIRE(read.quality.size() == seq.size());
+
+        // Shorter than min_length
+        read = make_read(seq + std::string(9, 'C'));
+        trim.process_read(read);
+        REQUIRE(read.size() == seq.size() + 9);
+
+        read = make_read(std::string(100, 'G'));
+        trim.process_read(read);
+        REQUIRE(read.size() == 0);
+
+        REQUIRE(trim.num_trimmed() == 2);
+        REQUIRE(trim.bases_trimmed() == 130);
+        std::string report = trim.yaml_report();
+        REQUIRE(report.find("num_reads: 3") != std::string::npos);
+        REQUIRE(report.find("trimmed_by_base: {A: 0, C: 0, G: 2, T: 0}") != std::string::npos);
+        REQUIRE(report.find("tail_lengths: {30: 1, 100: 1}") != std::string::npos);
+    }
+
+    SECTION("Only the given bases") {
+        qcpp::PolyXTrim trim("polyg", "G");
+        auto read = make_read(seq + std::string(30, 'T'));
+        trim.process_read(read);
+        REQUIRE(read.size() == seq.size() + 30);
+        read = make_read(seq + std::string(30, 'G'));
+        trim.process_read(read);
+        REQUIRE(read.sequence == seq);
+        REQUIRE(trim.yaml_report().find("trimmed_by_base: {G: 1}") != std::string::npos);
+    }
+
+    SECTION("Pairs") {
+        qcpp::PolyXTrim trim("polyx"), other("polyx");
+        qcpp::ReadPair rp;
+        rp.first = make_read(seq);
+        rp.second = make_read(seq + std::string(20, 'G'));
+        trim.process_read_pair(rp);
+        REQUIRE(rp.first.sequence == seq);
+        REQUIRE(rp.second.sequence == seq);
+
+        rp.first = make_read(seq + std::string(15, 'C'));
+        rp.second = make_read(seq + std::string(12, 'G'));
+        other.process_read_pair(rp);
+        REQUIRE(rp.first.sequence == seq);
+        REQUIRE(rp.second.sequence == seq);
+
+        trim.add_stats_from(&other);
+        REQUIRE(trim.num_trimmed() == 3);
+        REQUIRE(trim.bases_trimmed() == 47);
+        std::string report = trim.yaml_report();
+        REQUIRE(report.find("num_reads: 4") != std::string::npos);
+        REQUIRE(report.find("trimmed_by_base: {A: 0, C: 1, G: 2, T: 0}") != std::string::npos);
+        REQUIRE(report.find("tail_lengths: {12: 1, 15: 1, 20: 1}") != std::string::npos);
+    }
+}
@@ -0,0 +1,121 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-io.hh"
+#include "qc-qualbin.hh"
+
+
+// Sanger quality characters for the given scores
+static std::string
+sanger(const std::vector<int> &scores)
+{
+    std::string qual;
+    for (int score: scores) {
+        qual += static_cast<char>(score + 33);
+    }
+    return qual;
+}
+
+TEST_CASE("Quality binning schemes", "[QualityBinner]") {
+    SECTION("Illumina 8-level binning") {
+        qcpp::QualityBinner binner("bin", qcpp::illumina8_bins());
+        std::string qual = sanger({0, 1, 2, 9, 10, 19, 20, 24, 25, 29, 30, 34,
+                                   35, 39, 40, 41});
+
+        binner.bin_qualities(qual);
+        REQUIRE(qual == sanger({0, 1, 6, 6, 15, 15, 22, 22, 27, 27, 33, 33,
+                                37, 37, 40, 40}));
+    }
+
+    SECTION("Illumina 4-level binning") {
+        qcpp::QualityBinner binner("bin", qcpp::illumina4_bins());
+        std::string qual = sanger({0, 2, 3, 14, 15, 30, 31, 41});
+
+        binner.bin_qualities(qual);
+        REQUIRE(qual == sanger({2, 2, 12, 12, 23, 23, 37, 37}));
+    }
+
+    SECTION("Binary threshold") {
+        qcpp::QualityBinner binner("bin", qcpp::binary_bins(20));
+        std::string qual = sanger({0, 19, 20, 41});
+
+        binner.bin_qualities(qual);
+        REQUIRE(qual == sanger({2, 2, 40, 40}));
+    }
+
+    SECTION("Other encodings") {
+        qcpp::QualityBinner binner("bin", qcpp::illumina4_bins(),
+                                   qcpp::Illumina13Encoding);
+        std::string qual = "@NOh";
+
+        binner.bin_qualities(qual);
+        REQUIRE(qual == "BLWe");
+    }
+
+    SECTION("Scores outside all bins are kept") {
+        qcpp::QualityBinner binner("bin", {{10, 19, 15}});
+        std::string qual = sanger({5, 12, 30});
+
+        binner.bin_qualities(qual);
+        REQUIRE(qual == sanger({5, 15, 30}));
+    }
+}
+
+TEST_CASE("Quality binning schemes are parsed", "[QualityBinner]") {
+    SECTION("Named schemes") {
+        REQUIRE(qcpp::parse_quality_bins("illumina8").size() ==
+                qcpp::illumina8_bins().size());
+        REQUIRE(qcpp::parse_quality_bins("illumina4").size() == 4);
+
+        std::vector<qcpp::QualityBin> bins = qcpp::parse_quality_bins("binary:25");
+        REQUIRE(bins.size() == 2);
+        REQUIRE(bins[0].upper == 24);
+        REQUIRE(bins[1].lower == 25);
+    }
+
+    SECTION("Custom bins") {
+        qcpp::QualityBinner binner("bin",
+                qcpp::parse_quality_bins("0-19:10,20-29:25,30-:35"));
+        std::string qual = sanger({3, 20, 29, 30, 41});
+
+        binner.bin_qualities(qual);
+        REQUIRE(qual == sanger({10, 25, 25, 35, 35}));
+    }
+
+    SECTION("Malformed schemes are rejected") {
+        for (const char *scheme: {"", "illumina", "binary:", "binary:x",
+                                  "10", "10-20", "10-20:", "20-10:5",
+                                  "0-9:5;10-:20"}) {
+            CAPTURE(scheme);
+            REQUIRE_THROWS_AS(qcpp::parse_quality_bins(scheme), qcpp::IOError);
+        }
+    }
+}
+
+TEST_CASE("QualityBinner processes reads", "[QualityBinner]") {
+    qcpp::QualityBinner binner("bin", qcpp::binary_bins(20));
+    qcpp::ReadPair rp("r1", "ACGT", sanger({10, 20, 30, 40}),
+                      "r2", "AC", sanger({19, 21}));
+    qcpp::Read fasta("r3", "ACGT", "");
+
+    binner.process_read_pair(rp);
+    binner.process_read(fasta);
+    REQUIRE(rp.first.sequence == "ACGT");
+    REQUIRE(rp.first.quality == sanger({2, 40, 40, 40}));
+    REQUIRE(rp.second.quality == sanger({2, 40}));
+    REQUIRE(fasta.quality == "");
+
+    std::string report = binner.yaml_report();
+    REQUIRE(report.find("num_reads: 3") != std::string::npos);
+    REQUIRE(report.find("num_bases: 6") != std::string::npos);
+    REQUIRE(report.find("[-5-19:2, 20-:40]") != std::string::npos);
+}
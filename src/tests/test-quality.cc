@@ -0,0 +1,155 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-io.hh"
+#include "qc-quality.hh"
+
+#include <fstream>
+#include <thread>
+#include <type_traits>
+
+#include <sys/stat.h>
+
+
+static std::string
+range_encoding(const std::string &quality)
+{
+    qcpp::QualityRange range;
+    range.add(quality);
+    return qcpp::encoding_for_range(range).name;
+}
+
+TEST_CASE("Quality encodings are chosen from quality ranges", "[QualityEncoding]") {
+    SECTION("Phred+33") {
+        REQUIRE(range_encoding("#########") == "Sanger");
+        REQUIRE(range_encoding("!+5?I") == "Sanger");
+        REQUIRE(range_encoding("#+5?IJ") == "Illumina 1.8+");
+        // Only high qualities fit either offset
+        REQUIRE(range_encoding("@EJ") == "Illumina 1.8+");
+    }
+
+    SECTION("Phred+64") {
+        REQUIRE(range_encoding(";@Th") == "Solexa");
+        REQUIRE(range_encoding("@BTh") == "Illumina 1.3+");
+        REQUIRE(range_encoding("BTh") == "Illumina 1.5+");
+    }
+
+    SECTION("Ranges are accumulated") {
+        qcpp::QualityRange range;
+        REQUIRE(range.empty());
+        range.add("");
+        REQUIRE(range.empty());
+        range.add("CDE");
+        range.add("BCD");
+        range.add(std::string(1000, 'h'));
+        REQUIRE(range.min == 'B');
+        REQUIRE(range.max == 'h');
+        REQUIRE(qcpp::encoding_for_range(range).name == "Illumina 1.5+");
+    }
+
+    SECTION("No qualities") {
+        REQUIRE(range_encoding("") == "Sanger");
+    }
+
+    SECTION("Invalid qualities") {
+        REQUIRE_THROWS_AS(range_encoding("II II"), qcpp::IOError);
+        REQUIRE_THROWS_AS(range_encoding("II\x7fI"), qcpp::IOError);
+    }
+}
+
+TEST_CASE("Quality encodings are detected from files", "[QualityEncoding]") {
+    TestConfig *config = TestConfig::get_config();
+
+    SECTION("Phred+33 FASTQ") {
+        std::string infile = config->get_data_file("valid_il.fastq");
+        REQUIRE(qcpp::detect_quality_encoding(infile).offset == 33);
+    }
+
+    SECTION("FASTA") {
+        std::string infile = config->get_data_file("valid.fasta");
+        REQUIRE(qcpp::detect_quality_encoding(infile).name == "Sanger");
+    }
+
+    SECTION("Phred+64 FASTQ") {
+        std::string infile = config->get_writable_file("fastq", false);
+        std::ofstream out(infile);
+        out << "@read1\nACGTACGT\n+\nhhhhffBB\n"
+            << "@read2\nACGTACGT\n+\nhhhhhhhh\n"
+            << "@read3\nACGTACGT\n+\n@@@@@@@@\n";
+        out.close();
+        // The first two reads look like Illumina 1.5, the third doesn't
+        REQUIRE(qcpp::detect_quality_encoding(infile, 2).name == "Illumina 1.5+");
+        REQUIRE(qcpp::detect_quality_encoding(infile).name == "Illumina 1.3+");
+    }
+
+    SECTION("Missing files") {
+        std::string infile = config->get_data_file("nonexistent.fastq");
+        REQUIRE_THROWS_AS(qcpp::detect_quality_encoding(infile), qcpp::IOError);
+    }
+
+    SECTION("FIFOs aren't sampled") {
+        std::string fifo = config->get_writable_file("fifo", false);
+        REQUIRE(mkfifo(fifo.c_str(), 0600) == 0);
+        std::thread writer([&fifo] {
+            std::ofstream out(fifo);
+            for (size_t i = 0; i < 100; i++) {
+                out << "@read" << i << "\nACGTACGT\n+\nhhhhffBB\n";
+            }
+        });
+        REQUIRE_THROWS_AS(qcpp::detect_quality_encoding(fifo), qcpp::IOError);
+
+        // So none of its reads are lost
+        qcpp::ReadParser parser;
+        qcpp::Read read;
+        size_t n_reads = 0;
+        parser.open(fifo);
+        while (parser.parse_read(read)) {
+            n_reads++;
+        }
+        writer.join();
+        REQUIRE(n_reads == 100);
+    }
+}
+
+TEST_CASE("Quality encodings are looked up by name", "[QualityEncoding]") {
+    REQUIRE(qcpp::quality_encoding_by_name("sanger").name == "Sanger");
+    REQUIRE(qcpp::quality_encoding_by_name("solexa").offset == 59);
+    REQUIRE(qcpp::quality_encoding_by_name("illumina13").offset == 64);
+    REQUIRE(qcpp::quality_encoding_by_name("illumina15").name == "Illumina 1.5+");
+    REQUIRE(qcpp::quality_encoding_by_name("illumina18").name == "Illumina 1.8+");
+    REQUIRE_THROWS_AS(qcpp::quality_encoding_by_name("Sanger"), qcpp::IOError);
+}
+
+TEST_CASE("Quality offsets are chosen from encodings", "[QualityEncoding]") {
+    auto offset_of = [](const qcpp::QualityEncoding &encoding) {
+        return qcpp::with_quality_offset(encoding, [](auto offset) {
+            return int(offset.p2q('I'));
+        });
+    };
+    auto is_static = [](const qcpp::QualityEncoding &encoding) {
+        return qcpp::with_quality_offset(encoding, [](auto offset) {
+            return !std::is_same<decltype(offset), qcpp::RuntimeOffset>::value;
+        });
+    };
+    const qcpp::QualityEncoding other{"Phred+40", 40, 0, 40};
+
+    static_assert(qcpp::Phred64Offset().p2q('h') == 40 &&
+                  qcpp::Phred33Offset::p2q('I') == 40,
+                  "Offsets are usable in constant expressions");
+    REQUIRE(qcpp::Phred64Offset(qcpp::Illumina13Encoding).p2q('h') == 40);
+    REQUIRE(offset_of(qcpp::SangerEncoding) == 40);
+    REQUIRE(offset_of(qcpp::SolexaEncoding) == 14);
+    REQUIRE(offset_of(qcpp::Illumina15Encoding) == 9);
+    REQUIRE(offset_of(other) == 33);
+    REQUIRE(is_static(qcpp::Illumina18Encoding));
+    REQUIRE_FALSE(is_static(other));
+}
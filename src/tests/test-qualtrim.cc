@@ -57,3 +57,33 @@ TEST_CASE("WindowedQualTrimmer low_qual.fastq", "[qualtrim]") {
     }
 }
 
+
+TEST_CASE("WindowedQualTrimmer with other quality offsets", "[qualtrim]") {
+    qcpp::ReadParser        parser;
+    qcpp::Read              r1, r2;
+    TestConfig             *config = TestConfig::get_config();
+    std::string             infile = config->get_data_file("low_qual.fastq");
+    parser.open(infile);
+    REQUIRE_NOTHROW(parser.parse_read(r1));
+    REQUIRE_NOTHROW(parser.parse_read(r2));
+
+    // Shifts both reads' qualities to encoding, then trims them
+    auto trim_shifted = [&](const qcpp::QualityEncoding &encoding) {
+        qcpp::WindowedQualTrim wqt("qt", 20, 1, 0, encoding);
+        std::vector<size_t> sizes;
+        for (qcpp::Read read: {r1, r2}) {
+            for (char &q: read.quality) {
+                q += encoding.offset - 33;
+            }
+            wqt.process_read(read);
+            sizes.push_back(read.size());
+        }
+        return sizes;
+    };
+    const std::vector<size_t> expect = {96, 23};
+
+    REQUIRE(trim_shifted(qcpp::SangerEncoding) == expect);
+    REQUIRE(trim_shifted(qcpp::Illumina13Encoding) == expect);
+    // Not one of the standard offsets
+    REQUIRE(trim_shifted(qcpp::QualityEncoding{"Phred+40", 40, 0, 40}) == expect);
+}
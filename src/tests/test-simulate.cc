@@ -0,0 +1,104 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-io.hh"
+#include "qc-simulate.hh"
+
+
+TEST_CASE("ReadSimulator is deterministic", "[ReadSimulator]") {
+    qcpp::SimulatorParams   params;
+    qcpp::ReadPair          rp1, rp2;
+
+    params.num_pairs = 100;
+    params.seed = 42;
+
+    SECTION("Same seed gives same reads") {
+        qcpp::ReadSimulator sim1(params), sim2(params);
+        size_t n_pairs = 0;
+
+        while (sim1.parse_read_pair(rp1)) {
+            REQUIRE(sim2.parse_read_pair(rp2));
+            REQUIRE(rp1 == rp2);
+            n_pairs++;
+        }
+        REQUIRE_FALSE(sim2.parse_read_pair(rp2));
+        REQUIRE(n_pairs == 100);
+        REQUIRE(sim1.get_num_reads() == 200);
+        REQUIRE(sim1.at_end());
+    }
+
+    SECTION("Different seed gives different reads") {
+        qcpp::ReadSimulator sim1(params);
+        params.seed = 43;
+        qcpp::ReadSimulator sim2(params);
+
+        REQUIRE(sim1.parse_read_pair(rp1));
+        REQUIRE(sim2.parse_read_pair(rp2));
+        REQUIRE(rp1.first.sequence != rp2.first.sequence);
+    }
+
+    SECTION("parse_read interleaves pairs") {
+        qcpp::ReadSimulator sim1(params), sim2(params);
+        qcpp::Read r1, r2;
+
+        REQUIRE(sim1.parse_read_pair(rp1));
+        REQUIRE(sim2.parse_read(r1));
+        REQUIRE(sim2.parse_read(r2));
+        REQUIRE(r1 == rp1.first);
+        REQUIRE(r2 == rp1.second);
+    }
+
+    SECTION("Zero-length reads are rejected") {
+        params.read_len = 0;
+        REQUIRE_THROWS_AS(qcpp::ReadSimulator sim(params), qcpp::IOError);
+    }
+}
+
+TEST_CASE("ReadSimulator parameters", "[ReadSimulator]") {
+    qcpp::SimulatorParams   params;
+    qcpp::ReadPair          rp;
+
+    params.num_pairs = 50;
+    params.read_len = 100;
+
+    SECTION("Reads have the right length and valid qualities") {
+        qcpp::ReadSimulator sim(params);
+        while (sim.parse_read_pair(rp)) {
+            REQUIRE(rp.first.size() == 100);
+            REQUIRE(rp.second.size() == 100);
+            REQUIRE(rp.first.quality.size() == 100);
+            for (char q: rp.first.quality) {
+                REQUIRE(q >= 33 + 2);
+                REQUIRE(q <= 33 + 41);
+            }
+        }
+    }
+
+    SECTION("Short inserts read through into adaptor") {
+        params.insert_mean = 60;
+        params.insert_sd = 0;
+        params.error_rate = 0;
+        qcpp::ReadSimulator sim(params);
+        while (sim.parse_read_pair(rp)) {
+            REQUIRE(rp.first.sequence.substr(60, 13) == params.adaptor_r1.substr(0, 13));
+            REQUIRE(rp.second.sequence.substr(60, 13) == params.adaptor_r2.substr(0, 13));
+        }
+    }
+
+    SECTION("N rate of 1 gives all Ns") {
+        params.n_rate = 1.0;
+        qcpp::ReadSimulator sim(params);
+        REQUIRE(sim.parse_read_pair(rp));
+        REQUIRE(rp.first.sequence == std::string(100, 'N'));
+        REQUIRE(rp.first.quality == std::string(100, '#'));
+    }
+}
@@ -0,0 +1,388 @@
+/* Copyright (c) 2015-2016 Kevin Murray
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+
+#include "catch.hpp"
+#include "helpers.hh"
+
+#include "qc-io.hh"
+#include "qc-processor.hh"
+#include "qc-adaptor.hh"
+#include "qc-qualtrim.hh"
+#include "qc-simulate.hh"
+
+#include <yaml-cpp/yaml.h>
+
+#include <stdexcept>
+
+
+// Throws from the n-th read pair it is given
+class FailingProcessor: public qcpp::ReadProcessor
+{
+public:
+    FailingProcessor(const std::string &name, size_t fail_at)
+        : qcpp::ReadProcessor(name, qcpp::SangerEncoding)
+        , _fail_at(fail_at)
+    {
+    }
+
+    void
+    process_read(qcpp::Read &)
+    {
+    }
+
+    void
+    process_read_pair(qcpp::ReadPair &)
+    {
+        if (_num_reads++ == _fail_at) {
+            throw std::runtime_error("processing failed");
+        }
+    }
+
+    void
+    add_stats_from(qcpp::ReadProcessor *)
+    {
+    }
+
+    std::string
+    yaml_report()
+    {
+        return "";
+    }
+
+private:
+    size_t _fail_at;
+};
+
+TEST_CASE("Output policies", "[OutputPolicy]") {
+    std::string output, orphans;
+    qcpp::ReadPair rp("r1", "ACGT", "IIII", "r2", "ACGT", "IIII");
+
+    SECTION("PairedOutput writes placeholders for removed reads") {
+        qcpp::PairedOutput policy;
+        rp.second.erase();
+        policy.format(rp, output, orphans);
+        REQUIRE(output == "@r1\nACGT\n+\nIIII\n@r2\nN\n+\nB\n");
+        REQUIRE(orphans == "");
+    }
+
+    SECTION("BrokenPairedOutput keeps intact pairs on main output") {
+        qcpp::BrokenPairedOutput policy(2);
+        policy.format(rp, output, orphans);
+        REQUIRE(output == "@r1\nACGT\n+\nIIII\n@r2\nACGT\n+\nIIII\n");
+        REQUIRE(orphans == "");
+    }
+
+    SECTION("BrokenPairedOutput routes orphans") {
+        qcpp::BrokenPairedOutput policy(2);
+        rp.first.erase(1);
+        policy.format(rp, output, orphans);
+        REQUIRE(output == "");
+        REQUIRE(orphans == "@r2\nACGT\n+\nIIII\n");
+    }
+
+    SECTION("SingleOutput skips removed reads") {
+        qcpp::SingleOutput policy;
+        policy.format(rp.first, output, orphans);
+        rp.second.erase();
+        policy.format(rp.second, output, orphans);
+        REQUIRE(output == "@r1\nACGT\n+\nIIII\n");
+    }
+}
+
+TEST_CASE("Output policies select reads from chunks", "[OutputPolicy]") {
+    std::vector<qcpp::ReadPair> chunk, output;
+    std::vector<qcpp::Read> orphans;
+    qcpp::ReadPair rp("r1", "ACGT", "IIII", "r2", "ACGT", "IIII");
+
+    SECTION("PairedOutput fills placeholders for removed reads") {
+        qcpp::PairedOutput policy;
+        rp.second.erase();
+        chunk.push_back(rp);
+        policy.select(chunk, output, orphans);
+        REQUIRE(output.size() == 1);
+        REQUIRE(output[0].second == qcpp::Read("r2", "N", "B"));
+        REQUIRE(orphans.size() == 0);
+    }
+
+    SECTION("BrokenPairedOutput routes orphans") {
+        qcpp::BrokenPairedOutput policy(2);
+        chunk.push_back(rp);
+        rp.first.erase(1);
+        chunk.push_back(rp);
+        policy.select(chunk, output, orphans);
+        REQUIRE(output.size() == 1);
+        REQUIRE(output[0].str() == "@r1\nACGT\n+\nIIII\n@r2\nACGT\n+\nIIII\n");
+        REQUIRE(orphans.size() == 1);
+        REQUIRE(orphans[0] == qcpp::Read("r2", "ACGT", "IIII"));
+    }
+
+    SECTION("SingleOutput skips removed reads") {
+        qcpp::SingleOutput policy;
+        std::vector<qcpp::Read> reads, kept;
+        reads.push_back(rp.first);
+        rp.second.erase();
+        reads.push_back(rp.second);
+        policy.select(reads, kept, orphans);
+        REQUIRE(kept.size() == 1);
+        REQUIRE(kept[0] == qcpp::Read("r1", "ACGT", "IIII"));
+    }
+}
+
+TEST_CASE("ThreadedQCProcessor matches ProcessedReadStream", "[ThreadedQCProcessor]") {
+    TestConfig         *config = TestConfig::get_config();
+    std::string         infile = config->get_data_file("tm-merge.fastq");
+    std::ostringstream  threaded_out, orphan_out;
+    std::string         serial_out, serial_orphans;
+    qcpp::ProcessedReadStream stream(infile);
+
+    stream.append_processor<qcpp::AdaptorTrimPE>("tm", 4);
+    stream.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+
+    SECTION("Paired") {
+        qcpp::ThreadedQCProcessor proc(infile, &threaded_out, 2);
+        qcpp::PairedOutput policy;
+        qcpp::ReadPair rp;
+
+        proc.append_processor<qcpp::AdaptorTrimPE>("tm", 4);
+        proc.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        REQUIRE(proc.run() == 6);
+
+        while (stream.parse_read_pair(rp)) {
+            policy.format(rp, serial_out, serial_orphans);
+        }
+        REQUIRE(threaded_out.str() == serial_out);
+        REQUIRE(proc.report() == stream.report());
+    }
+
+    SECTION("Broken paired, with orphans") {
+        qcpp::ThreadedQCProcessor proc(infile, &threaded_out, 2);
+        qcpp::BrokenPairedOutput policy(10);
+        qcpp::ReadPair rp;
+
+        proc.append_processor<qcpp::AdaptorTrimPE>("tm", 4);
+        proc.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        proc.set_output_policy<qcpp::BrokenPairedOutput>(10);
+        proc.set_orphan_output(&orphan_out);
+        REQUIRE(proc.run() == 6);
+
+        while (stream.parse_read_pair(rp)) {
+            policy.format(rp, serial_out, serial_orphans);
+        }
+        // All pairs in tm-merge.fastq are merged into R1
+        REQUIRE(threaded_out.str() == "");
+        REQUIRE(orphan_out.str() == serial_orphans);
+        REQUIRE(serial_orphans.size() > 0);
+    }
+
+    SECTION("Single-end") {
+        qcpp::ThreadedQCProcessorSE proc(infile, &threaded_out, 2);
+        qcpp::ProcessedReadStream se_stream(infile);
+        qcpp::SingleOutput policy;
+        qcpp::Read read;
+
+        proc.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        se_stream.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        REQUIRE(proc.run() == 12);
+
+        while (se_stream.parse_read(read)) {
+            policy.format(read, serial_out, serial_orphans);
+        }
+        REQUIRE(threaded_out.str() == serial_out);
+        REQUIRE(proc.report() == se_stream.report());
+    }
+
+    SECTION("Paired, memory-mapped input") {
+        qcpp::ThreadedQCProcessor proc(infile, &threaded_out, 2);
+        qcpp::PairedOutput policy;
+        qcpp::ReadPair rp;
+
+        proc.append_processor<qcpp::AdaptorTrimPE>("tm", 4);
+        proc.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        proc.set_mapped_input();
+        REQUIRE(proc.run() == 6);
+
+        while (stream.parse_read_pair(rp)) {
+            policy.format(rp, serial_out, serial_orphans);
+        }
+        REQUIRE(sorted_records(threaded_out.str(), 8) ==
+                sorted_records(serial_out, 8));
+        REQUIRE(proc.report() == stream.report());
+    }
+
+    SECTION("Single-end, memory-mapped input") {
+        qcpp::ThreadedQCProcessorSE proc(infile, &threaded_out, 3);
+        qcpp::ProcessedReadStream se_stream(infile);
+        qcpp::SingleOutput policy;
+        qcpp::Read read;
+
+        proc.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        se_stream.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        proc.set_mapped_input(qcpp::MappedFile::MapPopulate);
+        REQUIRE(proc.run() == 12);
+
+        while (se_stream.parse_read(read)) {
+            policy.format(read, serial_out, serial_orphans);
+        }
+        REQUIRE(sorted_records(threaded_out.str(), 4) ==
+                sorted_records(serial_out, 4));
+        REQUIRE(proc.report() == se_stream.report());
+    }
+
+    SECTION("Compressed input can't be memory-mapped") {
+        std::string gzfile = config->get_data_file("tricky-gbs.fq.gz");
+        qcpp::ThreadedQCProcessor proc(gzfile, &threaded_out, 2);
+
+        REQUIRE_THROWS_AS(proc.set_mapped_input(), qcpp::IOError);
+    }
+}
+
+TEST_CASE("ThreadedQCProcessor with stream endpoints", "[ThreadedQCProcessor]") {
+    TestConfig         *config = TestConfig::get_config();
+    std::string         il_file = config->get_data_file("valid_il.fastq");
+    std::string         r1_file = config->get_data_file("valid_R1.fastq");
+    std::string         r2_file = config->get_data_file("valid_R2.fastq");
+    std::ostringstream  file_out;
+    std::ostringstream  stream_out;
+
+    {
+        qcpp::ThreadedQCProcessor proc(il_file, &file_out, 2);
+        proc.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        REQUIRE(proc.run() == 5);
+    }
+
+    SECTION("ReadInterleaver input matches interleaved file input") {
+        qcpp::ReadInterleaver input;
+        qcpp::StreamReadWriter output(&stream_out);
+
+        input.open(r1_file, r2_file);
+        qcpp::ThreadedQCProcessor proc(input, output, 2);
+        proc.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+        REQUIRE(proc.run() == 5);
+        REQUIRE(stream_out.str() == file_out.str());
+        REQUIRE(output.get_num_reads() == 10);
+        REQUIRE_THROWS_AS(proc.set_mapped_input(), qcpp::IOError);
+    }
+
+    SECTION("ReadDeInterleaver output splits pairs") {
+        std::string out_r1 = config->get_writable_file("fastq");
+        std::string out_r2 = config->get_writable_file("fastq");
+        {
+            qcpp::ReadInterleaver input;
+            qcpp::ReadDeInterleaver output;
+
+            input.open(r1_file, r2_file);
+            output.open(out_r1, out_r2);
+            qcpp::ThreadedQCProcessor proc(input, output, 2);
+            REQUIRE(proc.run() == 5);
+            REQUIRE(output.get_num_pairs() == 5);
+        }
+
+        qcpp::ReadInterleaver expect, got;
+        qcpp::ReadPair expect_rp, got_rp;
+        expect.open(r1_file, r2_file);
+        got.open(out_r1, out_r2);
+        while (expect.parse_read_pair(expect_rp)) {
+            REQUIRE(got.parse_read_pair(got_rp));
+            REQUIRE(got_rp == expect_rp);
+        }
+        REQUIRE_FALSE(got.parse_read_pair(got_rp));
+    }
+
+    SECTION("Errors from the input are rethrown by run()") {
+        qcpp::ReadInterleaver input;
+        qcpp::StreamReadWriter output(&stream_out);
+
+        // Second reads of these files are not mates
+        input.open(r1_file, il_file);
+        input.set_check_pair_names(true);
+        qcpp::ThreadedQCProcessor proc(input, output, 2);
+        REQUIRE_THROWS_AS(proc.run(), qcpp::IOError);
+    }
+}
+
+TEST_CASE("ThreadedQCProcessor stops after output errors", "[ThreadedQCProcessor]") {
+    qcpp::SimulatorParams params;
+    params.num_pairs = 100000;
+    qcpp::ReadSimulator sim(params);
+    // A stream without a buffer fails every write
+    std::ostream failed_out(NULL);
+    qcpp::StreamReadWriter output(&failed_out);
+    qcpp::ThreadedQCProcessor proc(sim, output, 2);
+
+    proc.append_processor<qcpp::WindowedQualTrim>("qc", 20);
+    REQUIRE_THROWS_AS(proc.run(), qcpp::IOError);
+    // The reader stops soon after the first chunk fails to be written
+    REQUIRE(sim.get_num_pairs() < params.num_pairs);
+}
+
+TEST_CASE("ThreadedQCProcessor rethrows processing errors", "[ThreadedQCProcessor]") {
+    qcpp::SimulatorParams params;
+    params.num_pairs = 100000;
+    qcpp::ReadSimulator sim(params);
+    std::ostringstream out;
+    qcpp::StreamReadWriter output(&out);
+    qcpp::ThreadedQCProcessor proc(sim, output, 2);
+
+    proc.append_processor<FailingProcessor>("fail", 1000);
+    REQUIRE_THROWS_AS(proc.run(), std::runtime_error);
+}
+
+TEST_CASE("ThreadedQCProcessor schedules many chunks", "[ThreadedQCProcessor]") {
+    qcpp::SimulatorParams params;
+    params.num_pairs = 2000;
+    std::ostringstream  threaded_out;
+    std::string         serial_out, serial_orphans;
+    qcpp::PairedOutput  policy;
+    qcpp::ReadPair      rp;
+
+    {
+        qcpp::ReadSimulator sim(params);
+        qcpp::AdaptorTrimPE trim("tm", 10);
+        while (sim.parse_read_pair(rp)) {
+            trim.process_read_pair(rp);
+            policy.format(rp, serial_out, serial_orphans);
+        }
+    }
+
+    bool numa_placement = false;
+    SECTION("Unpinned threads") {
+    }
+    SECTION("With NUMA placement") {
+        numa_placement = true;
+    }
+
+    qcpp::ReadSimulator sim(params);
+    qcpp::StreamReadWriter output(&threaded_out);
+    qcpp::ThreadedQCProcessor proc(sim, output, 3);
+    proc.append_processor<qcpp::AdaptorTrimPE>("tm", 10);
+    proc.set_numa_placement(numa_placement);
+    REQUIRE(proc.run() == params.num_pairs);
+    REQUIRE(sorted_records(threaded_out.str(), 8) ==
+            sorted_records(serial_out, 8));
+
+    YAML::Node report = YAML::Load(proc.scheduler_report());
+    YAML::Node sched = report[0]["ThreadedQCProcessor"];
+    REQUIRE(sched["threads"].as<size_t>() == 3);
+    REQUIRE(sched["workers"].size() == 3);
+    REQUIRE(sched["numa_placement"].as<bool>() == numa_placement);
+    // Pinning may be refused, but the layout is always reported
+    REQUIRE((sched["reader"]["cpus"].size() > 0) == numa_placement);
+    // Chunks start small, so even this input is split many times
+    REQUIRE(sched["chunks"].as<size_t>() > 3);
+
+    size_t n_reads = 0;
+    for (const YAML::Node &worker: sched["workers"]) {
+        double util = worker["utilization"].as<double>();
+        REQUIRE(util >= 0);
+        REQUIRE(util <= 1);
+        n_reads += worker["reads"].as<size_t>();
+        REQUIRE(worker["cpus"].size() == (numa_placement ? 1 : 0));
+    }
+    REQUIRE(n_reads == params.num_pairs);
+}
@@ -160,6 +160,73 @@ class PlotPerBaseQuality(PlotResult):
                                r2_dict=r2_dict)
 
 
+class PlotBaseComposition(PlotResult):
+    """Render BaseComposition results"""
+
+    bases = ['A', 'C', 'G', 'T', 'N']
+    colours = ['green', 'blue', 'black', 'red', 'grey']
+
+    def _save(self, fig):
+        # Save and base64 the image
+        sio = StringIO()
+        fig.savefig(sio, format='png', dpi=60)
+        plt.close(fig)
+        return base64.b64encode(sio.getvalue())
+
+    def _plot_bases(self, base_counts, name):
+        # read position is 1-based here, for user friendlyness
+        read_pos = np.arange(len(base_counts)) + 1
+        totals = np.array([max(sum(pos.values()), 1) for pos in base_counts])
+
+        fig, ax = plt.subplots(figsize=(10,6))
+        for base, colour in zip(self.bases, self.colours):
+            pct = np.array([pos[base] for pos in base_counts]) * 100.0 / totals
+            ax.plot(read_pos, pct, color=colour, label=base)
+
+        ax.set_xlim((1, max(len(read_pos), 2)))
+        ax.set_ylim((0, 100))
+        ax.set_title("Per-base Composition: " + name)
+        ax.set_ylabel("% of bases", size='large', labelpad=10)
+        ax.set_xlabel("Read Position", size='large', labelpad=10)
+        ax.legend(loc='upper right', framealpha=1)
+        return self._save(fig)
+
+    def _plot_gc(self, gc_histogram, name):
+        fig, ax = plt.subplots(figsize=(10,6))
+        ax.bar(np.arange(len(gc_histogram)), gc_histogram, width=1,
+               color='lightgreen', edgecolor='black')
+
+        ax.set_xlim((0, 101))
+        ax.set_title("GC Content per Read: " + name)
+        ax.set_ylabel("Reads", size='large', labelpad=10)
+        ax.set_xlabel("% GC", size='large', labelpad=10)
+        return self._save(fig)
+
+    def render(self, report):
+        name = report['name']
+        params = nice_params(report['parameters'])
+
+        output = report['output']
+
+        # Detect paired-end mode
+        paired = bool(output["r2_base_counts"])
+
+        images = []
+        for read in ['r1', 'r2'] if paired else ['r1']:
+            read_name = name
+            if paired:
+                read_name += " ({})".format(read.upper())
+            images.append((
+                self._plot_bases(output[read + '_base_counts'], read_name),
+                self._plot_gc(output[read + '_gc_histogram'], read_name),
+            ))
+
+        template = QCPP_ENV.get_template('basecomposition.html')
+        return template.render(name=name,
+                               parameters=params,
+                               images=images)
+
+
 class PlotWindowedQualTrim(PlotResult):
     """Render WindowedQualTrim results.
     We can use the default render function."""
@@ -178,10 +245,39 @@ def render_metadata(section):
     return template.render(metadata=metadata)
 
 
+class PlotQualityBinner(PlotResult):
+    """Render QualityBinner results.
+    We can use the default render function."""
+    template = QCPP_ENV.get_template('qualitybinner.html')
+
+
+class PlotOther(PlotResult):
+    """Render results of processors without their own plots as a table of
+    their output. Lists and maps (e.g. histograms) are too long to show, so
+    only their number of entries is given."""
+    template = QCPP_ENV.get_template('other.html')
+
+    def render(self, report):
+        name = report['name']
+        params = nice_params(report.get('parameters') or {})
+
+        output = {}
+        for key, val in (report.get('output') or {}).items():
+            if isinstance(val, (list, dict)):
+                val = "{} entries".format(len(val))
+            output[key] = val
+
+        return self.template.render(name=name,
+                                    parameters=params,
+                                    output=nice_params(output))
+
+
 RENDERERS = {
     "PerBaseQuality": PlotPerBaseQuality,
+    "BaseComposition": PlotBaseComposition,
     "AdaptorTrimPE": PlotAdaptorTrimPE,
     "WindowedQualTrim": PlotWindowedQualTrim,
+    "QualityBinner": PlotQualityBinner,
 }
 
 def render_all(yml_file):
@@ -197,7 +293,7 @@ def render_all(yml_file):
 
     for report in reports[1:]:
         processor, proc_report = report.items()[0]
-        renderer = RENDERERS[processor]()
+        renderer = RENDERERS.get(processor, PlotOther)()
         name = proc_report['name']
         div = renderer.render(proc_report)
         report_names.append(name)